@@ -0,0 +1,88 @@
+import argparse
+import os
+import subprocess
+import time
+
+DEFAULT_THREADS = [1, 2, 4, 8, 16, 32]
+
+
+def parse_throughput(output):
+    docs_sec = 0.0
+    mb_sec = 0.0
+    for line in output.splitlines():
+        if "Docs/sec:" in line:
+            docs_sec = float(line.split(":")[1].strip())
+        if "MB/sec:" in line:
+            mb_sec = float(line.split(":")[1].strip())
+    return docs_sec, mb_sec
+
+
+def run_once(binary, input_file, threads, limit=None, extra=None):
+    cmd = [binary, input_file, "--threads", str(threads)]
+    if limit:
+        cmd.extend(["--limit", str(limit)])
+    if extra:
+        cmd.extend(extra)
+
+    start_time = time.time()
+    result = subprocess.run(cmd, capture_output=True, text=True)
+    wall = time.time() - start_time
+    if result.returncode != 0:
+        print(f"Error running {' '.join(cmd)}:")
+        print(result.stderr)
+        return None
+
+    docs_sec, mb_sec = parse_throughput(result.stdout)
+    return {"wall_time": wall, "docs_sec": docs_sec, "mb_sec": mb_sec}
+
+
+def run_scaling(binary, input_file, thread_counts, limit=None, repeat=1, extra=None):
+    results = []
+    for threads in thread_counts:
+        # Best of `repeat` runs, so a cold page cache on the first run does
+        # not count against one thread count.
+        best = None
+        for _ in range(repeat):
+            metrics = run_once(binary, input_file, threads, limit, extra)
+            if metrics is None:
+                return results
+            if best is None or metrics["docs_sec"] > best["docs_sec"]:
+                best = metrics
+        print(f"  threads={threads:<3} {best['docs_sec']:>10.2f} docs/s")
+        results.append((threads, best))
+    return results
+
+
+def print_report(results):
+    if not results: return
+    base = results[0][1]["docs_sec"]
+    print("\n" + "="*65)
+    print(f"{'SCALING REPORT':^65}")
+    print("="*65)
+    print(f"{'Threads':>8} {'Docs/s':>12} {'MB/s':>10} {'Wall (s)':>10} {'Speedup':>9} {'Eff.':>8}")
+    print("-" * 65)
+    for threads, m in results:
+        speedup = m["docs_sec"] / base if base > 0 else 0
+        efficiency = speedup / threads * results[0][0]
+        print(f"{threads:>8} {m['docs_sec']:>12.2f} {m['mb_sec']:>10.2f} {m['wall_time']:>10.2f} "
+              f"{speedup:>8.2f}x {efficiency * 100:>7.1f}%")
+    print("-" * 65)
+    print(f"Hardware threads: {os.cpu_count()}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="websift docs/s across worker thread counts.")
+    parser.add_argument("--binary", default="./build/websift")
+    parser.add_argument("--input", required=True)
+    parser.add_argument("--limit", type=int, default=None)
+    parser.add_argument("--threads", default=",".join(str(t) for t in DEFAULT_THREADS),
+                        help="comma-separated thread counts (default: 1,2,4,8,16,32)")
+    parser.add_argument("--repeat", type=int, default=1, help="runs per thread count; the best is reported")
+    parser.add_argument("--pipeline", default=None)
+    args = parser.parse_args()
+
+    thread_counts = [int(t) for t in args.threads.split(",") if t.strip()]
+    extra = ["--pipeline", args.pipeline] if args.pipeline else None
+    print(f"Benchmarking {args.binary} on {args.input}")
+    results = run_scaling(args.binary, args.input, thread_counts, args.limit, max(1, args.repeat), extra)
+    print_report(results)
@@ -0,0 +1,61 @@
+"""Generate src/unicode_tables.hpp: a two-level lookup of Unicode letters.
+
+A code point is a letter when Python's str.isalpha() is true for it
+(general categories Lu, Ll, Lt, Lm, Lo), so the C++ filters agree with the
+Python reference on the same Unicode version.
+
+Usage: python3 scripts/gen_unicode_tables.py > src/unicode_tables.hpp
+"""
+import sys
+import unicodedata
+
+BLOCK_BITS = 8
+BLOCK_SIZE = 1 << BLOCK_BITS
+MAX_CODE_POINT = 0x10FFFF
+
+
+def block_bitmap(block: int) -> bytes:
+    bits = bytearray(BLOCK_SIZE // 8)
+    for i in range(BLOCK_SIZE):
+        if chr(block * BLOCK_SIZE + i).isalpha():
+            bits[i >> 3] |= 1 << (i & 7)
+    return bytes(bits)
+
+
+def main():
+    n_blocks = (MAX_CODE_POINT + 1) >> BLOCK_BITS
+    blocks = {}
+    index = []
+    for b in range(n_blocks):
+        bitmap = block_bitmap(b)
+        if bitmap not in blocks:
+            blocks[bitmap] = len(blocks)
+        index.append(blocks[bitmap])
+    if len(blocks) > 256:
+        sys.exit("too many distinct blocks for a uint8_t index")
+
+    out = sys.stdout
+    out.write("#pragma once\n\n")
+    out.write("// Generated by scripts/gen_unicode_tables.py from Unicode %s; do not edit.\n\n"
+              % unicodedata.unidata_version)
+    out.write("#include <cstdint>\n\n")
+    out.write("namespace Unicode {\n\n")
+    out.write("constexpr uint32_t kLetterBlockBits = %d;\n" % BLOCK_BITS)
+    out.write("constexpr uint32_t kMaxCodePoint = 0x%X;\n\n" % MAX_CODE_POINT)
+
+    out.write("// Code point >> kLetterBlockBits -> row of kLetterBlocks.\n")
+    out.write("inline constexpr uint8_t kLetterBlockIndex[%d] = {\n" % n_blocks)
+    for i in range(0, n_blocks, 24):
+        out.write("    " + ", ".join(str(v) for v in index[i:i + 24]) + ",\n")
+    out.write("};\n\n")
+
+    out.write("// One bit per code point in the block, least significant bit first.\n")
+    out.write("inline constexpr uint8_t kLetterBlocks[%d][%d] = {\n" % (len(blocks), BLOCK_SIZE // 8))
+    for bitmap in blocks:
+        out.write("    {" + ",".join("0x%02X" % v for v in bitmap) + "},\n")
+    out.write("};\n\n")
+    out.write("} // namespace Unicode\n")
+
+
+if __name__ == "__main__":
+    main()
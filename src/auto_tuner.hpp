@@ -0,0 +1,145 @@
+#pragma once
+
+#include "bounded_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Caps the bytes of input between the reader and the workers. The reader
+// acquire()s a block's bytes before handing it over and the worker that
+// finishes the block release()s them; a block is always admitted when
+// nothing else is in flight, so one oversized block cannot stall the run.
+class InflightLimit {
+public:
+    explicit InflightLimit(size_t limit) : limit_(std::max<size_t>(1, limit)) {}
+
+    InflightLimit(const InflightLimit&) = delete;
+    InflightLimit& operator=(const InflightLimit&) = delete;
+
+    // Waits for room; returns the seconds spent waiting.
+    double acquire(size_t bytes) {
+        if (tryAcquire(bytes)) return 0.0;
+        const auto start = stall_.begin();
+        while (true) {
+            const uint32_t epoch = room_.prepare();
+            if (tryAcquire(bytes)) {
+                room_.cancel();
+                break;
+            }
+            room_.wait(epoch);
+            if (tryAcquire(bytes)) break;
+        }
+        return stall_.end(start);
+    }
+
+    void release(size_t bytes) {
+        used_.fetch_sub(bytes, std::memory_order_acq_rel);
+        room_.notify(true);
+    }
+
+    void setLimit(size_t limit) {
+        limit_.store(std::max<size_t>(1, limit), std::memory_order_relaxed);
+        room_.notify(true);
+    }
+
+    size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+    size_t used() const { return used_.load(std::memory_order_relaxed); }
+    // Seconds acquire() has waited in total, including waits in progress.
+    double stallSeconds() const { return stall_.seconds(); }
+
+private:
+    bool tryAcquire(size_t bytes) {
+        size_t used = used_.load(std::memory_order_relaxed);
+        while (used == 0 || used + bytes <= limit_.load(std::memory_order_relaxed)) {
+            if (used_.compare_exchange_weak(used, used + bytes, std::memory_order_acq_rel)) return true;
+        }
+        return false;
+    }
+
+    std::atomic<size_t> limit_;
+    alignas(64) std::atomic<size_t> used_{0};
+    Parker room_;
+    WaitClock stall_;
+};
+
+// What the pipeline did over one tuning interval.
+struct TunerSample {
+    double seconds = 0;        // length of the interval
+    uint64_t docs = 0;         // documents finished
+    double reader_stall = 0;   // seconds the reader waited for room
+    double worker_idle = 0;    // seconds active workers waited for work, summed
+    double occupancy = 0;      // mean fraction of the in-flight limit in use
+};
+
+// Picks the active worker count and the in-flight byte limit from samples
+// of one interval at a time:
+//  - workers waiting for input while the reader never waits (or the limit
+//    is already the whole budget): the reader is the bottleneck, so drop a
+//    worker (throughput is unchanged and a core is freed);
+//  - the reader waiting for room while workers still go idle: the limit
+//    leaves too little queued to smooth out uneven blocks, so double it
+//    up to the budget;
+//  - the reader waiting and every worker busy: add a worker, and keep it
+//    only if docs/s improves by kGain over the previous interval (beyond
+//    the memory bandwidth or SMT siblings of a box, more workers do not
+//    help); after a step that did not pay, hold for kHold intervals;
+//  - a full queue of busy workers trims the limit back towards the floor,
+//    since more queued input then only costs memory.
+class AutoTuner {
+public:
+    static constexpr double kGain = 1.05;
+    static constexpr int kHold = 8;
+
+    AutoTuner(unsigned max_workers, unsigned workers, size_t min_bytes, size_t max_bytes, size_t bytes)
+        : max_workers_(std::max(1u, max_workers)),
+          min_bytes_(std::max<size_t>(1, std::min(min_bytes, max_bytes))),
+          max_bytes_(std::max(min_bytes_, max_bytes)) {
+        workers_ = std::clamp(workers, 1u, max_workers_);
+        bytes_ = std::clamp(bytes, min_bytes_, max_bytes_);
+    }
+
+    unsigned workers() const { return workers_; }
+    size_t inflightBytes() const { return bytes_; }
+
+    void update(const TunerSample& s) {
+        if (s.seconds <= 0) return;
+        const double rate = s.docs / s.seconds;
+        const double stalled = s.reader_stall / s.seconds;
+        const double idle = s.worker_idle / (s.seconds * workers_);
+
+        if (trial_) {
+            // Last interval added a worker; keep it only if it paid off.
+            trial_ = false;
+            if (rate < trial_base_ * kGain) {
+                workers_--;
+                hold_ = kHold;
+            }
+            return;
+        }
+        if (hold_ > 0) hold_--;
+
+        if (idle > 0.25 && (stalled < 0.05 || bytes_ == max_bytes_)) {
+            if (workers_ > 1) workers_--;
+        } else if (stalled > 0.1 && idle > 0.1) {
+            bytes_ = std::min(max_bytes_, bytes_ * 2);
+        } else if (stalled > 0.2 && hold_ == 0 && workers_ < max_workers_) {
+            trial_ = true;
+            trial_base_ = rate;
+            workers_++;
+        } else if (stalled > 0.2 && idle < 0.02 && s.occupancy > 0.9) {
+            bytes_ = std::max(min_bytes_, bytes_ - bytes_ / 4);
+        }
+    }
+
+private:
+    const unsigned max_workers_;
+    const size_t min_bytes_;
+    const size_t max_bytes_;
+    unsigned workers_ = 1;
+    size_t bytes_ = 0;
+    bool trial_ = false;
+    double trial_base_ = 0;
+    int hold_ = 0;
+};
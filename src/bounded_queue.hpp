@@ -0,0 +1,265 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Pause hint for spin loops.
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Event count: lets a thread sleep until another thread has made progress,
+// without a mutex. A waiter calls prepare(), re-checks its condition, then
+// either cancel()s or wait()s with the returned epoch; notify() after the
+// state change wakes it. Notifying costs one atomic add and, only when
+// someone is parked, a futex wake.
+class Parker {
+public:
+    uint32_t prepare() {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_seq_cst);
+    }
+
+    void cancel() { waiters_.fetch_sub(1, std::memory_order_relaxed); }
+
+    void wait(uint32_t epoch) {
+#if defined(__linux__)
+        // Returns at once if the epoch moved since prepare().
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, epoch, nullptr, nullptr, 0);
+#else
+        while (epoch_.load(std::memory_order_acquire) == epoch) std::this_thread::yield();
+#endif
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void notify(bool all = false) {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) == 0) return;
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+#else
+        (void)all;
+#endif
+    }
+
+private:
+    std::atomic<uint32_t> epoch_{0};
+    std::atomic<uint32_t> waiters_{0};
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain uint32_t");
+
+// Total time threads spent blocked, counting waits still in progress, so a
+// sampler sees a thread that is blocked right now as waiting rather than
+// busy. begin()/end() bracket a wait (the slow path, hence the mutex).
+class WaitClock {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point begin() {
+        const Clock::time_point now = Clock::now();
+        std::lock_guard<std::mutex> lk(mu_);
+        open_++;
+        open_start_ns_ += nanos(now);
+        return now;
+    }
+
+    // Returns the length of the wait begin() started.
+    double end(Clock::time_point start) {
+        const Clock::time_point now = Clock::now();
+        std::lock_guard<std::mutex> lk(mu_);
+        open_--;
+        open_start_ns_ -= nanos(start);
+        done_ns_ += nanos(now) - nanos(start);
+        return (nanos(now) - nanos(start)) * 1e-9;
+    }
+
+    double seconds() const {
+        const Clock::time_point now = Clock::now();
+        std::lock_guard<std::mutex> lk(mu_);
+        return static_cast<double>(done_ns_ + open_ * nanos(now) - open_start_ns_) * 1e-9;
+    }
+
+private:
+    static int64_t nanos(Clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    }
+
+    mutable std::mutex mu_;
+    int64_t done_ns_ = 0;
+    int64_t open_ = 0;          // waits in progress
+    int64_t open_start_ns_ = 0; // sum of their start times
+};
+
+// Bounded multi-producer multi-consumer queue: a ring of sequence-numbered
+// slots (Vyukov), so push and pop are one CAS on their own cache-line-padded
+// index in the common case. A full push or an empty pop spins briefly and
+// then parks on a futex until the other side makes room or data.
+// The capacity is rounded up to a power of two.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+        mask_ = n - 1;
+        slots_.reset(new Slot[n]);
+        for (size_t i = 0; i < n; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Blocks while the queue is full; false once the queue is closed.
+    bool push(T&& item) {
+        for (int spin = 0;; ++spin) {
+            if (closed_.load(std::memory_order_acquire)) return false;
+            if (enqueue(item)) {
+                not_empty_.notify();
+                return true;
+            }
+            if (spin < kSpins) {
+                cpuRelax();
+                continue;
+            }
+            const uint32_t epoch = not_full_.prepare();
+            if (closed_.load(std::memory_order_acquire)) {
+                not_full_.cancel();
+                return false;
+            }
+            if (enqueue(item)) {
+                not_full_.cancel();
+                not_empty_.notify();
+                return true;
+            }
+            not_full_.wait(epoch);
+        }
+    }
+
+    // Blocks while the queue is empty; false once it is closed and drained.
+    bool pop(T& out) {
+        for (int spin = 0;; ++spin) {
+            if (dequeue(out)) {
+                not_full_.notify();
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                // Items pushed before close() are still handed out.
+                if (!dequeue(out)) return false;
+                not_full_.notify();
+                return true;
+            }
+            if (spin < kSpins) {
+                cpuRelax();
+                continue;
+            }
+            const uint32_t epoch = not_empty_.prepare();
+            if (dequeue(out)) {
+                not_empty_.cancel();
+                not_full_.notify();
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                not_empty_.cancel();
+                continue;
+            }
+            not_empty_.wait(epoch);
+        }
+    }
+
+    // Non-blocking forms: false (item untouched) if the queue is full,
+    // closed or empty respectively.
+    bool tryPush(T&& item) {
+        if (closed_.load(std::memory_order_acquire) || !enqueue(item)) return false;
+        not_empty_.notify();
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        if (!dequeue(out)) return false;
+        not_full_.notify();
+        return true;
+    }
+
+    void close() {
+        closed_.store(true, std::memory_order_seq_cst);
+        not_empty_.notify(true);
+        not_full_.notify(true);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    static constexpr int kSpins = 64;
+
+    struct alignas(64) Slot {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    // A slot is free for the push at position pos when seq == pos, and holds
+    // that push's item for the pop at pos when seq == pos + 1.
+    bool enqueue(T& item) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            const size_t seq = slot.seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(item);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool dequeue(T& out) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & mask_];
+            const size_t seq = slot.seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(slot.value);
+                    slot.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{0}; // next push position
+    alignas(64) std::atomic<size_t> tail_{0}; // next pop position
+    alignas(64) std::atomic<bool> closed_{false};
+    Parker not_empty_;
+    Parker not_full_;
+};
@@ -0,0 +1,275 @@
+#include "dedup.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kMagic[8] = {'W', 'S', 'D', 'E', 'D', 'U', 'P', '1'};
+constexpr size_t kInitialSlots = 1024;
+
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+inline uint64_t load64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Lower-case ASCII, whitespace runs to one space, no leading/trailing space.
+void normalizeInto(std::string_view text, std::string& out) {
+    out.clear();
+    out.reserve(text.size());
+    bool pending_space = false;
+    for (char c : text) {
+        const unsigned char u = static_cast<unsigned char>(c);
+        if (std::isspace(u)) {
+            pending_space = !out.empty();
+            continue;
+        }
+        if (pending_space) out.push_back(' ');
+        pending_space = false;
+        out.push_back(static_cast<char>(std::tolower(u)));
+    }
+}
+
+} // namespace
+
+Hash128 hash128(std::string_view data, uint64_t seed) {
+    constexpr uint64_t c1 = 0x87c37b91114253d5ULL;
+    constexpr uint64_t c2 = 0x4cf5ad432745937fULL;
+    const size_t len = data.size();
+    const char* p = data.data();
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    const size_t blocks = len / 16;
+    for (size_t i = 0; i < blocks; ++i, p += 16) {
+        uint64_t k1 = load64(p);
+        uint64_t k2 = load64(p + 8);
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    // Tail: zero-padded to a block, which matches the reference byte-wise mix.
+    const size_t rest = len & 15;
+    if (rest) {
+        char tail[16] = {};
+        std::memcpy(tail, p, rest);
+        uint64_t k1 = load64(tail);
+        uint64_t k2 = load64(tail + 8);
+        if (rest > 8) {
+            k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        }
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= len;
+    h2 ^= len;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    return {h1, h2};
+}
+
+ExactDedupSet::ExactDedupSet(size_t max_bytes) {
+    const size_t budget = max_bytes / sizeof(Hash128) / kStripes;
+    max_slots_ = 16;
+    while (max_slots_ * 2 <= budget) max_slots_ *= 2;
+    for (Stripe& s : stripes_) s.slots.assign(std::min(kInitialSlots, max_slots_), Hash128{});
+}
+
+bool ExactDedupSet::insertSlot(std::vector<Hash128>& slots, Hash128 h) {
+    const size_t mask = slots.size() - 1;
+    for (size_t i = h.lo & mask;; i = (i + 1) & mask) {
+        if (slots[i] == h) return false;
+        if (slots[i] == Hash128{}) {
+            slots[i] = h;
+            return true;
+        }
+    }
+}
+
+bool ExactDedupSet::findSlot(const Stripe& s, Hash128 h) {
+    const size_t mask = s.slots.size() - 1;
+    for (size_t i = h.lo & mask;; i = (i + 1) & mask) {
+        if (s.slots[i] == h) return true;
+        if (s.slots[i] == Hash128{}) return false;
+    }
+}
+
+void ExactDedupSet::insertLocked(Stripe& s, Hash128 h) {
+    // Absent: grow at 3/4 load, or stop recording once the stripe is full.
+    if ((s.used + 1) * 4 > s.slots.size() * 3) {
+        if (s.slots.size() >= max_slots_) {
+            overflow_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::vector<Hash128> grown(s.slots.size() * 2, Hash128{});
+        for (const Hash128& old : s.slots) {
+            if (old != Hash128{}) insertSlot(grown, old);
+        }
+        s.slots.swap(grown);
+    }
+    if (insertSlot(s.slots, h)) s.used++;
+}
+
+bool ExactDedupSet::testAndInsert(Hash128 h) {
+    if (h == Hash128{}) h.lo = 1; // keep the empty marker free
+    Stripe& s = stripes_[stripeOf(h)];
+    std::lock_guard<std::mutex> lock(s.mu);
+    if (findSlot(s, h)) return true;
+    insertLocked(s, h);
+    return false;
+}
+
+bool ExactDedupSet::testAndInsertAll(const Hash128* keys, size_t count) {
+    // Lock the stripes in index order, so two callers cannot deadlock.
+    std::array<bool, kStripes> needed{};
+    for (size_t i = 0; i < count; ++i) {
+        Hash128 h = keys[i];
+        if (h == Hash128{}) h.lo = 1;
+        needed[stripeOf(h)] = true;
+    }
+    std::array<std::unique_lock<std::mutex>, kStripes> locks;
+    for (size_t i = 0; i < kStripes; ++i) {
+        if (needed[i]) locks[i] = std::unique_lock<std::mutex>(stripes_[i].mu);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        Hash128 h = keys[i];
+        if (h == Hash128{}) h.lo = 1;
+        if (findSlot(stripes_[stripeOf(h)], h)) return true;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        Hash128 h = keys[i];
+        if (h == Hash128{}) h.lo = 1;
+        insertLocked(stripes_[stripeOf(h)], h);
+    }
+    return false;
+}
+
+bool ExactDedupSet::contains(Hash128 h) const {
+    if (h == Hash128{}) h.lo = 1;
+    const Stripe& s = stripes_[stripeOf(h)];
+    std::lock_guard<std::mutex> lock(s.mu);
+    return findSlot(s, h);
+}
+
+size_t ExactDedupSet::size() const {
+    size_t n = 0;
+    for (const Stripe& s : stripes_) {
+        std::lock_guard<std::mutex> lock(s.mu);
+        n += s.used;
+    }
+    return n;
+}
+
+void ExactDedupSet::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) throw std::runtime_error("exact_dedup: could not open " + path);
+    char magic[sizeof(kMagic)];
+    uint64_t count = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+        throw std::runtime_error("exact_dedup: " + path + " is not a dedup set file");
+    }
+    std::vector<Hash128> chunk;
+    while (count > 0) {
+        chunk.resize(static_cast<size_t>(std::min<uint64_t>(count, 65536)));
+        if (!in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size() * sizeof(Hash128)))) {
+            throw std::runtime_error("exact_dedup: " + path + " is truncated");
+        }
+        for (const Hash128& h : chunk) testAndInsert(h);
+        count -= chunk.size();
+    }
+}
+
+void ExactDedupSet::save(const std::string& path) const {
+    // A unique temporary name: runs saving to the same path must not write
+    // into each other's file (the last rename still wins; see ExactDedupConfig).
+    std::string tmp = path + ".tmp.XXXXXX";
+    const int fd = mkstemp(&tmp[0]);
+    if (fd < 0) throw std::runtime_error("exact_dedup: could not create " + tmp + ": " + std::strerror(errno));
+    fchmod(fd, 0644); // mkstemp creates it 0600
+    close(fd);
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("exact_dedup: could not write " + tmp);
+    }
+
+    // Lock every stripe so the count matches the hashes written.
+    std::array<std::unique_lock<std::mutex>, kStripes> locks;
+    uint64_t count = 0;
+    for (size_t i = 0; i < kStripes; ++i) {
+        locks[i] = std::unique_lock<std::mutex>(stripes_[i].mu);
+        count += stripes_[i].used;
+    }
+    out.write(kMagic, sizeof(kMagic));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const Stripe& s : stripes_) {
+        for (const Hash128& h : s.slots) {
+            if (h != Hash128{}) out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        }
+    }
+    out.close();
+    if (!out) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("exact_dedup: failed writing " + tmp);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("exact_dedup: could not rename " + tmp + " to " + path);
+    }
+}
+
+ExactDedupFilter::ExactDedupFilter(const ExactDedupConfig& config)
+    : config_(config),
+      seen_(std::make_shared<ExactDedupSet>(static_cast<size_t>(std::max(config.max_mb, 1)) << 20)) {
+    if (!config_.path.empty() && std::ifstream(config_.path).good()) seen_->load(config_.path);
+}
+
+FilterResult ExactDedupFilter::filter(const DocumentAnalysis& doc) const {
+    Hash128 h;
+    if (config_.normalize) {
+        thread_local std::string normalized;
+        normalizeInto(doc.text(), normalized);
+        h = hash128(normalized);
+    } else {
+        h = hash128(doc.text());
+    }
+    if (seen_->testAndInsert(h)) return {false, DropReason::Duplicate};
+    return {true};
+}
+
+void ExactDedupFilter::finish() const {
+    if (seen_->overflow() > 0) {
+        std::cerr << "exact_dedup: memory bound (max_mb=" << config_.max_mb << ") reached; "
+                  << seen_->overflow() << " documents were kept without being recorded\n";
+    }
+    if (!config_.path.empty()) seen_->save(config_.path);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "document.hpp"
+#include "filters.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Exact content deduplication: documents are keyed by a 128-bit hash of
+// their (normalized) text, and a document whose hash was already seen drops
+// as "duplicate".
+
+struct Hash128 {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool operator==(const Hash128& o) const { return lo == o.lo && hi == o.hi; }
+    bool operator!=(const Hash128& o) const { return !(*this == o); }
+};
+
+// MurmurHash3 x64/128 (non-cryptographic; collisions across 2^64 docs are
+// negligible for dedup).
+Hash128 hash128(std::string_view data, uint64_t seed = 0);
+
+// Set of hashes shared by all workers. Open addressing with linear probing,
+// split into lock stripes by the top bits of the hash, so concurrent inserts
+// rarely contend. Each stripe grows by doubling up to its share of
+// max_bytes; once a stripe is full, new hashes are not recorded (the
+// document passes) and counted in overflow().
+class ExactDedupSet {
+public:
+    explicit ExactDedupSet(size_t max_bytes);
+
+    // True if h was already present; otherwise records it (if there is room).
+    bool testAndInsert(Hash128 h);
+    // For keys of one item (e.g. the LSH bands of a document): true if any
+    // was already present, and then none is recorded; otherwise records
+    // them all. The check and the inserts hold every stripe involved, so of
+    // two items sharing a key only one is ever recorded.
+    bool testAndInsertAll(const Hash128* keys, size_t count);
+    bool contains(Hash128 h) const;
+    size_t size() const;
+    size_t overflow() const { return overflow_.load(std::memory_order_relaxed); }
+
+    // File: the magic "WSDEDUP1", a uint64 count, then the hashes as
+    // (lo, hi) uint64 pairs (host byte order). load() adds to the set; I/O
+    // errors throw std::runtime_error. save() writes a uniquely named
+    // temporary file and renames it over path.
+    void load(const std::string& path);
+    void save(const std::string& path) const;
+
+private:
+    static constexpr size_t kStripeBits = 6;
+    static constexpr size_t kStripes = size_t{1} << kStripeBits;
+
+    struct alignas(64) Stripe {
+        mutable std::mutex mu;
+        std::vector<Hash128> slots; // {0, 0} is the empty slot
+        size_t used = 0;
+    };
+
+    std::array<Stripe, kStripes> stripes_;
+    size_t max_slots_; // per stripe, a power of two
+    std::atomic<size_t> overflow_{0};
+
+    static bool insertSlot(std::vector<Hash128>& slots, Hash128 h);
+    static size_t stripeOf(Hash128 h) { return h.hi >> (64 - kStripeBits); }
+    static bool findSlot(const Stripe& s, Hash128 h);
+    // The stripe's mutex is held by the caller.
+    void insertLocked(Stripe& s, Hash128 h);
+};
+
+struct ExactDedupConfig {
+    // Lower-case ASCII, collapse whitespace runs to one space and trim
+    // before hashing, so documents differing only in case or spacing match.
+    bool normalize = true;
+    int max_mb = 1024;   // memory bound of the hash set
+    // Load the set from here (if it exists) and save it back in finish().
+    // Concurrent runs on one path do not merge: the last to finish wins
+    // (websift --manifest refuses it for that reason).
+    std::string path;
+};
+
+// Pipeline stage; copies share one set, so one stage built up front dedups
+// across every worker's copy of the chain. The first copy of a text is
+// kept. Place it after the filters so only kept text is recorded.
+class ExactDedupFilter {
+public:
+    explicit ExactDedupFilter(const ExactDedupConfig& config = {});
+
+    FilterResult filter(const DocumentAnalysis& doc) const;
+    // Save the set to config.path (if set); warns if the memory bound was hit.
+    void finish() const;
+
+private:
+    ExactDedupConfig config_;
+    std::shared_ptr<ExactDedupSet> seen_;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal non-owning view of a contiguous array (std::span is C++20).
+template <typename T>
+class Span {
+public:
+    Span() = default;
+    Span(T* data, size_t size) : data_(data), size_(size) {}
+    template <typename U>
+    Span(std::vector<U>& v) : data_(v.data()), size_(v.size()) {}
+    template <typename U>
+    Span(const std::vector<U>& v) : data_(v.data()), size_(v.size()) {}
+
+    T* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    T& operator[](size_t i) const { return data_[i]; }
+    T* begin() const { return data_; }
+    T* end() const { return data_ + size_; }
+    Span subspan(size_t offset, size_t count) const { return Span(data_ + offset, count); }
+
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Hint the first cache lines of a document into cache ahead of use.
+inline void prefetchText(std::string_view text) {
+#if defined(__GNUC__)
+    const size_t n = text.size() < 256 ? text.size() : 256;
+    for (size_t off = 0; off < n; off += 64) __builtin_prefetch(text.data() + off);
+#else
+    (void)text;
+#endif
+}
+
+// A document inside a DocBlock arena.
+struct DocRef {
+    uint64_t offset = 0;
+    uint32_t length = 0;
+};
+
+// A block of documents stored back to back in one byte buffer, addressed by
+// parallel arrays of references and ids. Blocks are meant to be reused:
+// clear() keeps the buffers' capacity.
+class DocBlock {
+public:
+    void reserve(size_t docs, size_t bytes) {
+        refs_.reserve(docs);
+        ids_.reserve(docs);
+        arena_.reserve(bytes);
+    }
+
+    void add(std::string_view text, std::string id = {}) {
+        refs_.push_back(DocRef{arena_.size(), static_cast<uint32_t>(text.size())});
+        ids_.push_back(std::move(id));
+        arena_.append(text.data(), text.size());
+    }
+
+    void clear() {
+        refs_.clear();
+        ids_.clear();
+        arena_.clear();
+    }
+
+    size_t size() const { return refs_.size(); }
+    bool empty() const { return refs_.empty(); }
+    size_t bytes() const { return arena_.size(); }
+
+    std::string_view arena() const { return arena_; }
+    Span<const DocRef> refs() const { return Span<const DocRef>(refs_.data(), refs_.size()); }
+    std::string_view text(size_t i) const { return textOf(arena_, refs_[i]); }
+    const std::string& id(size_t i) const { return ids_[i]; }
+
+    static std::string_view textOf(std::string_view arena, const DocRef& ref) {
+        return arena.substr(ref.offset, ref.length);
+    }
+
+private:
+    std::string arena_;
+    std::vector<DocRef> refs_;
+    std::vector<std::string> ids_;
+};
@@ -0,0 +1,187 @@
+#include "document.hpp"
+#include <array>
+#include <cstring>
+
+namespace {
+
+enum CharClass : uint8_t {
+    kAlpha = 1 << 0,
+    kUpper = 1 << 1,
+    kDigit = 1 << 2,
+    kSpace = 1 << 3,
+    kPunct = 1 << 4,
+    kNonAscii = 1 << 5,
+};
+
+std::array<uint8_t, 256> buildClassTable() {
+    std::array<uint8_t, 256> table{};
+    for (int c = 'a'; c <= 'z'; ++c) table[c] = kAlpha;
+    for (int c = 'A'; c <= 'Z'; ++c) table[c] = kAlpha | kUpper;
+    for (int c = '0'; c <= '9'; ++c) table[c] = kDigit;
+    for (unsigned char c : std::string(" \t\n\r\f\v")) table[c] = kSpace;
+    for (unsigned char c : std::string(R"(!"#$%&'()*+,-./:;<=>?@[\]^_`{|}~)")) table[c] = kPunct;
+    for (int c = 0x80; c < 256; ++c) table[c] = kNonAscii;
+    return table;
+}
+
+const std::array<uint8_t, 256> kClassTable = buildClassTable();
+
+inline bool isSpace(char c) {
+    return kClassTable[static_cast<unsigned char>(c)] & kSpace;
+}
+
+} // namespace
+
+DocumentAnalysis::DocumentAnalysis(std::string text) : text_(std::move(text)), view_(text_) {}
+
+// Copies and moves re-point view_ at their own text_ unless it is borrowed
+// (moving a short string does not keep its buffer).
+DocumentAnalysis::DocumentAnalysis(const DocumentAnalysis& other) { *this = other; }
+
+DocumentAnalysis& DocumentAnalysis::operator=(const DocumentAnalysis& other) {
+    if (this == &other) return *this;
+    const bool owned = other.view_.data() == other.text_.data();
+    text_ = other.text_;
+    view_ = owned ? std::string_view(text_) : other.view_;
+    computed_ = other.computed_;
+    lines_ = other.lines_;
+    words_ = other.words_;
+    line_word_begin_ = other.line_word_begin_;
+    lower_ = other.lower_;
+    counts_ = other.counts_;
+    return *this;
+}
+
+DocumentAnalysis::DocumentAnalysis(DocumentAnalysis&& other) noexcept { *this = std::move(other); }
+
+DocumentAnalysis& DocumentAnalysis::operator=(DocumentAnalysis&& other) noexcept {
+    if (this == &other) return *this;
+    const bool owned = other.view_.data() == other.text_.data();
+    text_ = std::move(other.text_);
+    view_ = owned ? std::string_view(text_) : other.view_;
+    computed_ = other.computed_;
+    lines_ = std::move(other.lines_);
+    words_ = std::move(other.words_);
+    line_word_begin_ = std::move(other.line_word_begin_);
+    lower_ = std::move(other.lower_);
+    counts_ = other.counts_;
+    other.view_ = {};
+    other.computed_ = 0;
+    return *this;
+}
+
+void DocumentAnalysis::reset(std::string text) {
+    text_ = std::move(text);
+    view_ = text_;
+    computed_ = 0;
+}
+
+void DocumentAnalysis::reset(std::string text, std::string lower) {
+    text_ = std::move(text);
+    view_ = text_;
+    lower_ = std::move(lower);
+    computed_ = lower_.size() == text_.size() ? kLower : 0;
+}
+
+void DocumentAnalysis::assign(std::string_view text) {
+    text_.assign(text.data(), text.size());
+    view_ = text_;
+    computed_ = 0;
+}
+
+void DocumentAnalysis::borrow(std::string_view text) {
+    view_ = text;
+    computed_ = 0;
+}
+
+std::string DocumentAnalysis::takeText() {
+    std::string out = view_.data() == text_.data() ? std::move(text_) : std::string(view_);
+    view_ = {};
+    computed_ = 0;
+    return out;
+}
+
+const std::vector<TextSpan>& DocumentAnalysis::lines() const {
+    if (!(computed_ & kLines)) computeLines();
+    return lines_;
+}
+
+const std::vector<TextSpan>& DocumentAnalysis::words() const {
+    if (!(computed_ & kWords)) computeWords();
+    return words_;
+}
+
+uint32_t DocumentAnalysis::lineWordBegin(size_t line) const {
+    if (!(computed_ & kWords)) computeWords();
+    return line_word_begin_[line];
+}
+
+std::string_view DocumentAnalysis::lower() const {
+    if (!(computed_ & kLower)) {
+        lower_.resize(view_.size());
+        for (size_t i = 0; i < view_.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(view_[i]);
+            lower_[i] = static_cast<char>((kClassTable[c] & kUpper) ? c + ('a' - 'A') : c);
+        }
+        computed_ |= kLower;
+    }
+    return lower_;
+}
+
+const CharClassCounts& DocumentAnalysis::charCounts() const {
+    if (!(computed_ & kCounts)) {
+        CharClassCounts c;
+        for (char ch : view_) {
+            unsigned char uc = static_cast<unsigned char>(ch);
+            uint8_t cls = kClassTable[uc];
+            c.alpha += (cls & kAlpha) != 0;
+            c.upper += (cls & kUpper) != 0;
+            c.digit += (cls & kDigit) != 0;
+            c.space += (cls & kSpace) != 0;
+            c.punct += (cls & kPunct) != 0;
+            c.non_ascii += (cls & kNonAscii) != 0;
+            c.hash += uc == '#';
+            c.newline += uc == '\n';
+        }
+        counts_ = c;
+        computed_ |= kCounts;
+    }
+    return counts_;
+}
+
+void DocumentAnalysis::computeLines() const {
+    lines_.clear();
+    const char* data = view_.data();
+    const size_t n = view_.size();
+    size_t pos = 0;
+    while (pos < n) {
+        const void* nl = std::memchr(data + pos, '\n', n - pos);
+        size_t end = nl ? static_cast<size_t>(static_cast<const char*>(nl) - data) : n;
+        lines_.push_back({static_cast<uint32_t>(pos), static_cast<uint32_t>(end - pos)});
+        pos = end + 1;
+    }
+    computed_ |= kLines;
+}
+
+void DocumentAnalysis::computeWords() const {
+    const auto& ls = lines();
+    words_.clear();
+    line_word_begin_.clear();
+    line_word_begin_.reserve(ls.size() + 1);
+    const char* data = view_.data();
+    for (const TextSpan& line : ls) {
+        line_word_begin_.push_back(static_cast<uint32_t>(words_.size()));
+        size_t i = line.offset;
+        const size_t end = static_cast<size_t>(line.offset) + line.length;
+        while (i < end) {
+            while (i < end && isSpace(data[i])) i++;
+            size_t start = i;
+            while (i < end && !isSpace(data[i])) i++;
+            if (start < i) {
+                words_.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(i - start)});
+            }
+        }
+    }
+    line_word_begin_.push_back(static_cast<uint32_t>(words_.size()));
+    computed_ |= kWords;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Byte range inside a document. 32-bit offsets keep the span arrays compact;
+// documents larger than 4 GiB are not supported.
+struct TextSpan {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+struct CharClassCounts {
+    size_t alpha = 0;     // ASCII letters
+    size_t upper = 0;     // ASCII upper-case letters
+    size_t digit = 0;
+    size_t space = 0;     // " \t\n\r\f\v"
+    size_t punct = 0;     // ASCII punctuation
+    size_t non_ascii = 0; // bytes >= 0x80
+    size_t hash = 0;      // '#'
+    size_t newline = 0;   // '\n'
+};
+
+// Per-document tokenization shared by all filters. Every view is computed on
+// first use and memoized until the text is replaced, so a document is split
+// into lines and words once no matter how many filters look at it.
+//
+// Lines follow std::getline semantics: split on '\n', no trailing empty line
+// after a final newline, '\r' kept in the span. Words are maximal runs of
+// non-whitespace bytes and never cross a line boundary.
+class DocumentAnalysis {
+public:
+    DocumentAnalysis() = default;
+    explicit DocumentAnalysis(std::string text);
+
+    // Replace the text and drop every memoized view. Scratch buffers keep
+    // their capacity, so a DocumentAnalysis reused across documents stops
+    // allocating once it has seen a large one.
+    void reset(std::string text);
+    // Same as reset(), but with the lower-case form already known (filters
+    // that rewrite the text often lower-case it along the way).
+    void reset(std::string text, std::string lower);
+    // Copy the text into the existing buffer (no allocation once the buffer
+    // is large enough); for documents that live in a shared arena.
+    void assign(std::string_view text);
+    // Analyse text in place, without copying it; it must outlive the next
+    // reset/assign/borrow. For read-only filters over arena-backed blocks.
+    void borrow(std::string_view text);
+    // Move the text out (a copy if borrowed); the analysis is left empty.
+    std::string takeText();
+
+    std::string_view text() const { return view_; }
+    size_t size() const { return view_.size(); }
+    bool empty() const { return view_.empty(); }
+    bool endsWithNewline() const { return !view_.empty() && view_.back() == '\n'; }
+    std::string_view view(TextSpan s) const { return view_.substr(s.offset, s.length); }
+
+    DocumentAnalysis(const DocumentAnalysis& other);
+    DocumentAnalysis& operator=(const DocumentAnalysis& other);
+    DocumentAnalysis(DocumentAnalysis&& other) noexcept;
+    DocumentAnalysis& operator=(DocumentAnalysis&& other) noexcept;
+
+    const std::vector<TextSpan>& lines() const;
+    const std::vector<TextSpan>& words() const;
+    // Words of line i are words()[lineWordBegin(i) .. lineWordBegin(i + 1)).
+    uint32_t lineWordBegin(size_t line) const;
+    // ASCII lower-case copy of text(), same offsets.
+    std::string_view lower() const;
+    const CharClassCounts& charCounts() const;
+
+private:
+    enum : uint8_t {
+        kLines = 1 << 0,
+        kWords = 1 << 1,
+        kLower = 1 << 2,
+        kCounts = 1 << 3,
+    };
+
+    std::string text_;     // owned text, unless borrowed
+    std::string_view view_; // text_, or the borrowed text
+    mutable uint8_t computed_ = 0;
+    mutable std::vector<TextSpan> lines_;
+    mutable std::vector<TextSpan> words_;
+    mutable std::vector<uint32_t> line_word_begin_;
+    mutable std::string lower_;
+    mutable CharClassCounts counts_;
+
+    void computeLines() const;
+    void computeWords() const;
+};
@@ -0,0 +1,198 @@
+#include "filter_chain.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Windows older than the current one count half as much per step.
+constexpr double kWindowDecay = 0.5;
+// Below this many (decayed) runs a stage's estimate is not trusted and the
+// stage is moved to the front of its segment so it gets measured again.
+constexpr double kMinSamples = 16.0;
+// Floor for the drop rate so checks that never drop still rank by cost.
+constexpr double kMinDropRate = 1e-3;
+
+} // namespace
+
+FilterResult FilterChain::runStage(size_t idx, DocumentAnalysis& doc) {
+    const bool adaptive = order_mode_ == Order::Adaptive;
+    const bool timed = adaptive || profiling_;
+    Stage& stage = stages_[idx];
+    const size_t bytes = doc.size();
+
+    std::chrono::steady_clock::time_point start;
+    if (timed) start = std::chrono::steady_clock::now();
+    FilterResult result = stage.run(doc);
+    if (timed) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (adaptive) {
+            stage.window_ns += static_cast<double>(ns);
+            stage.window_bytes += static_cast<double>(bytes);
+            stage.window_runs += 1;
+            stage.window_drops += result.keep ? 0 : 1;
+        }
+        stage.ns += static_cast<uint64_t>(ns);
+        stage.bytes += bytes;
+    }
+    stage.runs++;
+    return result;
+}
+
+FilterResult FilterChain::run(DocumentAnalysis& doc) {
+    FilterResult result{true};
+    size_t dropped_at = order_.size();
+
+    for (size_t pos = 0; pos < order_.size(); ++pos) {
+        result = runStage(order_[pos], doc);
+        if (!result.keep) {
+            dropped_at = pos;
+            break;
+        }
+    }
+
+    if (dropped_at < order_.size()) {
+        size_t idx = order_[dropped_at];
+        if (order_mode_ == Order::Adaptive && !stages_[idx].barrier) {
+            // Report the drop the fixed order would have: the checks of this
+            // segment that come earlier in the fixed order and have not run
+            // yet (the ones already run kept the document) get their turn,
+            // in fixed order. Only dropped documents pay for this.
+            pending_.clear();
+            for (size_t pos = dropped_at + 1; pos < order_.size() && !stages_[order_[pos]].barrier; ++pos) {
+                if (order_[pos] < idx) pending_.push_back(order_[pos]);
+            }
+            std::sort(pending_.begin(), pending_.end());
+            for (size_t earlier : pending_) {
+                FilterResult r = runStage(earlier, doc);
+                if (!r.keep) {
+                    result = r;
+                    idx = earlier;
+                    break;
+                }
+            }
+        }
+        stages_[idx].drops++;
+        result.stage = static_cast<uint16_t>(idx);
+    }
+
+    if (order_mode_ == Order::Adaptive && ++docs_in_window_ >= window_) {
+        reorder();
+        docs_in_window_ = 0;
+    }
+    return result;
+}
+
+std::string FilterChain::describe(const FilterResult& result) const {
+    if (result.stage < stages_.size() && stages_[result.stage].describe) {
+        return stages_[result.stage].describe(result);
+    }
+    return formatDropReason(result.reason, result.detail);
+}
+
+void FilterChain::finish() const {
+    for (const Stage& s : stages_) {
+        if (s.finish) s.finish();
+    }
+}
+
+void FilterChain::reorder() {
+    auto rank = [this](size_t idx) {
+        const Stage& s = stages_[idx];
+        if (s.window_runs < kMinSamples || s.window_bytes <= 0) return -1.0;
+        double ns_per_byte = s.window_ns / s.window_bytes;
+        double drop_rate = std::max(s.window_drops / s.window_runs, kMinDropRate);
+        // Expected cost spent per rejected document
+        return ns_per_byte / drop_rate;
+    };
+
+    std::vector<double> ranks(stages_.size());
+    for (size_t i = 0; i < stages_.size(); ++i) ranks[i] = rank(i);
+
+    // Sort each run of independent checks between barrier stages.
+    auto seg_begin = order_.begin();
+    while (seg_begin != order_.end()) {
+        if (stages_[*seg_begin].barrier) {
+            ++seg_begin;
+            continue;
+        }
+        auto seg_end = std::find_if(seg_begin, order_.end(),
+                                    [this](size_t idx) { return stages_[idx].barrier; });
+        std::stable_sort(seg_begin, seg_end,
+                         [&ranks](size_t a, size_t b) { return ranks[a] < ranks[b]; });
+        seg_begin = seg_end;
+    }
+
+    for (Stage& s : stages_) {
+        s.window_ns *= kWindowDecay;
+        s.window_bytes *= kWindowDecay;
+        s.window_runs *= kWindowDecay;
+        s.window_drops *= kWindowDecay;
+    }
+}
+
+std::vector<std::string> FilterChain::currentOrder() const {
+    std::vector<std::string> names;
+    names.reserve(order_.size());
+    for (size_t idx : order_) names.push_back(stages_[idx].name);
+    return names;
+}
+
+std::vector<FilterChain::StageSummary> FilterChain::summary() const {
+    std::vector<StageSummary> out;
+    out.reserve(stages_.size());
+    for (const Stage& s : stages_) {
+        out.push_back({s.name, s.runs, s.drops, s.ns, s.bytes});
+    }
+    return out;
+}
+
+void FilterChain::mergeSummary(std::vector<StageSummary>& into, const std::vector<StageSummary>& from) {
+    for (const StageSummary& f : from) {
+        auto it = std::find_if(into.begin(), into.end(),
+                               [&f](const StageSummary& s) { return s.name == f.name; });
+        if (it == into.end()) {
+            into.push_back(f);
+            continue;
+        }
+        it->runs += f.runs;
+        it->drops += f.drops;
+        it->ns += f.ns;
+        it->bytes += f.bytes;
+    }
+}
+
+void DropCounters::add(const FilterResult& result) {
+    const size_t slot = result.stage == FilterResult::kNoStage ? 0 : static_cast<size_t>(result.stage) + 1;
+    const size_t row = slot * kDropReasonCount + static_cast<size_t>(result.reason);
+    if (row >= counts_.size()) counts_.resize((slot + 1) * kDropReasonCount);
+    std::vector<size_t>& details = counts_[row];
+    if (result.detail >= details.size()) details.resize(result.detail + 1, 0);
+    details[result.detail]++;
+}
+
+void DropCounters::merge(const DropCounters& other) {
+    if (other.counts_.size() > counts_.size()) counts_.resize(other.counts_.size());
+    for (size_t row = 0; row < other.counts_.size(); ++row) {
+        const std::vector<size_t>& from = other.counts_[row];
+        std::vector<size_t>& into = counts_[row];
+        if (from.size() > into.size()) into.resize(from.size(), 0);
+        for (size_t d = 0; d < from.size(); ++d) into[d] += from[d];
+    }
+}
+
+std::map<std::string, size_t> DropCounters::report(const FilterChain& chain) const {
+    std::map<std::string, size_t> out;
+    for (size_t row = 0; row < counts_.size(); ++row) {
+        const size_t slot = row / kDropReasonCount;
+        FilterResult r{false};
+        r.reason = static_cast<DropReason>(row % kDropReasonCount);
+        r.stage = slot == 0 ? FilterResult::kNoStage : static_cast<uint16_t>(slot - 1);
+        for (size_t d = 0; d < counts_[row].size(); ++d) {
+            if (counts_[row][d] == 0) continue;
+            r.detail = static_cast<uint32_t>(d);
+            out[chain.describe(r)] += counts_[row][d];
+        }
+    }
+    return out;
+}
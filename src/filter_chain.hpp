@@ -0,0 +1,136 @@
+#pragma once
+
+#include "document.hpp"
+#include "filters.hpp"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Ordered list of filters applied to a document until the first drop.
+//
+// Order::Fixed runs the filters in the order they were added, so the reported
+// reason is always the first failing filter in that order (parity runs).
+// Order::Adaptive measures each filter's cost (ns/byte) and drop rate over a
+// decaying window and periodically reorders runs of independent checks so that
+// cheap, high-reject checks run first. Barrier stages never move and checks
+// never move across them: filters that rewrite the text (the checks after a
+// rewrite see different text) and stateful ones such as dedup (which must
+// only see documents every earlier check kept). When a moved check drops a
+// document, the not-yet-run checks that precede it in the fixed order run
+// too, so the reported reason (and every per-reason count) is the one the
+// fixed order gives.
+//
+// A chain is copyable; copies share nothing except state a filter shares on
+// purpose (the dedup set), so one chain can be built up front and copied into
+// each worker thread.
+class FilterChain {
+public:
+    enum class Order { Fixed, Adaptive };
+
+    struct StageSummary {
+        std::string name;
+        size_t runs = 0;
+        size_t drops = 0;
+        uint64_t ns = 0;     // only measured in adaptive mode or with profiling
+        uint64_t bytes = 0;
+    };
+
+    template <typename Filter>
+    void add(std::string name, Filter filter, bool barrier = false) {
+        Stage stage;
+        stage.name = std::move(name);
+        stage.barrier = barrier;
+        if constexpr (HasDescribe<Filter>::value) {
+            stage.describe = [f = filter](const FilterResult& r) { return f.describe(r); };
+        }
+        if constexpr (HasFinish<Filter>::value) {
+            stage.finish = [f = filter]() { f.finish(); };
+        }
+        stage.run = [f = std::move(filter)](DocumentAnalysis& doc) mutable { return f.filter(doc); };
+        order_.push_back(stages_.size());
+        stages_.push_back(std::move(stage));
+    }
+
+    void setOrder(Order order) { order_mode_ = order; }
+    // Documents between reordering decisions.
+    void setWindow(size_t docs) { window_ = docs ? docs : 1; }
+    // Time every filter call into the stage's ns total (see summary()), as
+    // adaptive ordering does anyway. Each copy of the chain keeps its own.
+    void setProfiling(bool enabled) { profiling_ = enabled; }
+
+    // Drops carry the index of the stage that dropped (stable across
+    // reordering), so describe() can defer to that filter for details.
+    FilterResult run(DocumentAnalysis& doc);
+    std::string describe(const FilterResult& result) const;
+    // Let filters with end-of-run work (saving the dedup set) do it; call
+    // once, after every copy of the chain has finished running.
+    void finish() const;
+
+    size_t size() const { return stages_.size(); }
+    std::vector<std::string> currentOrder() const;
+    std::vector<StageSummary> summary() const;
+    // Accumulate another chain's summary (e.g. from a worker) by stage name.
+    static void mergeSummary(std::vector<StageSummary>& into, const std::vector<StageSummary>& from);
+
+private:
+    template <typename F, typename = void>
+    struct HasDescribe : std::false_type {};
+    template <typename F>
+    struct HasDescribe<F, std::void_t<decltype(std::declval<const F&>().describe(std::declval<const FilterResult&>()))>>
+        : std::true_type {};
+    template <typename F, typename = void>
+    struct HasFinish : std::false_type {};
+    template <typename F>
+    struct HasFinish<F, std::void_t<decltype(std::declval<const F&>().finish())>> : std::true_type {};
+
+    struct Stage {
+        std::string name;
+        bool barrier = false;
+        std::function<FilterResult(DocumentAnalysis&)> run;
+        std::function<std::string(const FilterResult&)> describe; // optional
+        std::function<void()> finish;                              // optional
+
+        // Decaying window used for ordering decisions
+        double window_ns = 0;
+        double window_bytes = 0;
+        double window_runs = 0;
+        double window_drops = 0;
+
+        // Lifetime totals for reporting
+        size_t runs = 0;
+        size_t drops = 0;
+        uint64_t ns = 0;
+        uint64_t bytes = 0;
+    };
+
+    std::vector<Stage> stages_;
+    std::vector<size_t> order_;
+    Order order_mode_ = Order::Fixed;
+    bool profiling_ = false;
+    size_t window_ = 1024;
+    size_t docs_in_window_ = 0;
+    std::vector<size_t> pending_; // scratch for run()
+
+    FilterResult runStage(size_t idx, DocumentAnalysis& doc);
+    void reorder();
+};
+
+// Drop counts by (stage, reason, detail), kept per thread and merged at the
+// end. Counting is a plain increment; the only allocation is growing a
+// detail row the first time a larger detail value shows up.
+class DropCounters {
+public:
+    void add(const FilterResult& result);
+    void merge(const DropCounters& other);
+    // Formatted reason -> count, as printed in reports.
+    std::map<std::string, size_t> report(const FilterChain& chain) const;
+
+private:
+    // Row (stage + 1) * kDropReasonCount + reason; stage slot 0 is for
+    // drops made outside the chain (FilterResult::kNoStage).
+    std::vector<std::vector<size_t>> counts_;
+};
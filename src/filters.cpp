@@ -1,4 +1,7 @@
 #include "filters.hpp"
+#include "hash_table.hpp"
+#include "hashing.hpp"
+#include "unicode.hpp"
 #include "utils.hpp"
 #include <iostream>
 #include <fstream>
@@ -9,6 +12,73 @@
 #include <algorithm>
 #include <cstring>
 
+// Drop reasons
+std::string formatDropReason(DropReason reason, uint32_t detail) {
+    switch (reason) {
+        case DropReason::None: return "";
+        case DropReason::EmptyText: return "empty_text";
+        case DropReason::LoremIpsum: return "lorem_ipsum";
+        case DropReason::CurlyBracket: return "curly_bracket";
+        case DropReason::TooFewSentences: return "too_few_sentences";
+        case DropReason::FewParagraphs: return "< min_paragraphs";
+        case DropReason::FewParagraphsLogicCheck: return "< 3 paragraphs (logic check)";
+        case DropReason::ShortParagraphs: return "top 3 paragraphs too short";
+        case DropReason::BadWord: return "badword";
+        case DropReason::GopherShortDoc: return "gopher_short_doc";
+        case DropReason::GopherLongDoc: return "gopher_long_doc";
+        case DropReason::GopherBelowAvgThreshold: return "gopher_below_avg_threshold";
+        case DropReason::GopherAboveAvgThreshold: return "gopher_above_avg_threshold";
+        case DropReason::GopherTooManyHashes: return "gopher_too_many_hashes";
+        case DropReason::GopherTooManyEllipsis: return "gopher_too_many_ellipsis";
+        case DropReason::GopherTooManyBullets: return "gopher_too_many_bullets";
+        case DropReason::GopherTooManyEndEllipsis: return "gopher_too_many_end_ellipsis";
+        case DropReason::GopherBelowAlphaThreshold: return "gopher_below_alpha_threshold";
+        case DropReason::GopherEnoughStopWords: return "gopher_enough_stop_words";
+        case DropReason::DupParaFrac: return "dup_para_frac";
+        case DropReason::DupParaCharFrac: return "dup_para_char_frac";
+        case DropReason::DupLineFrac: return "dup_line_frac";
+        case DropReason::DupLineCharFrac: return "dup_line_char_frac";
+        case DropReason::TopNGram: return "top_" + std::to_string(detail) + "_gram";
+        case DropReason::DuplicatedNGrams: return "duplicated_" + std::to_string(detail) + "_n_grams";
+        case DropReason::FineWebEmpty: return "empty";
+        case DropReason::LinePunctRatio: return "line_punct_ratio";
+        case DropReason::ShortLineRatio: return "short_line_ratio";
+        case DropReason::CharDupRatio: return "char_dup_ratio";
+        case DropReason::ListRatio: return "list_ratio";
+        case DropReason::Duplicate: return "duplicate";
+        case DropReason::NearDuplicate: return "near_duplicate";
+        case DropReason::SeenUrl: return "seen_url";
+        case DropReason::Boilerplate: return "boilerplate";
+        case DropReason::Count: break;
+    }
+    return "unknown";
+}
+
+namespace {
+
+// Analysis reused by filterBatch() on this thread.
+DocumentAnalysis& batchAnalysis() {
+    thread_local DocumentAnalysis doc;
+    return doc;
+}
+
+// Body of filterBatch(): one pass over the block, analysing each text in
+// the arena and prefetching the next document while the current one is
+// filtered. Read-only filters only (see GopherQualityFilter::filterBatch).
+template <typename Filter>
+void filterEach(Filter& filter, std::string_view arena, Span<const DocRef> docs, Span<Verdict> out) {
+    DocumentAnalysis& doc = batchAnalysis();
+    for (size_t i = 0; i < docs.size(); ++i) {
+        if (!out[i].keep) continue;
+        if (i + 1 < docs.size()) prefetchText(DocBlock::textOf(arena, docs[i + 1]));
+        doc.borrow(DocBlock::textOf(arena, docs[i]));
+        out[i] = filter.filter(doc);
+    }
+    doc.borrow({}); // the arena may be freed after the call
+}
+
+} // namespace
+
 // In-place citation removal to avoid allocation
 // Returns new length
 size_t removeCitationsInPlace(char* str, size_t len) {
@@ -71,7 +141,16 @@ LineStats analyzeLine(std::string_view line, int max_len) {
 
 // C4QualityFilter
 
-C4QualityFilter::C4QualityFilter() 
+C4QualityFilter::C4QualityFilter(const C4QualityConfig& config)
+    : remove_citations(config.remove_citations),
+      filter_no_terminal_punct(config.filter_no_terminal_punct),
+      min_num_sentences(config.min_num_sentences),
+      min_words_per_line(config.min_words_per_line),
+      max_word_length(config.max_word_length),
+      filter_lorem_ipsum(config.filter_lorem_ipsum),
+      filter_javascript(config.filter_javascript),
+      filter_curly_bracket(config.filter_curly_bracket),
+      filter_policy(config.filter_policy)
 {
     policy_substrings = {
         "terms of use",
@@ -88,35 +167,23 @@ C4QualityFilter::C4QualityFilter()
     }
 }
 
-FilterResult C4QualityFilter::filter(std::string& text) {
-    std::string result;
-    result.reserve(text.size());
-    
-    int num_sentences = 0;
-    
-    // Iterate over lines using string_view
-    std::string_view text_view(text);
-    size_t pos = 0;
-    size_t len = text_view.size();
+C4QualityStats C4QualityFilter::scanLines(const DocumentAnalysis& doc, std::string* result,
+                                          std::string* result_lower) const {
+    const auto& lines = doc.lines();
+    const auto& words = doc.words();
+
+    C4QualityStats stats;
     
-    // Temporary buffer for line processing to avoid repeated allocations
+    // Temporary buffers for line processing to avoid repeated allocations
     std::string line_buf; 
-    line_buf.reserve(8192);
+    std::string line_l;
 
-    while (pos < len) {
-        // Find end of line
-        size_t next_pos = text_view.find('\n', pos);
-        if (next_pos == std::string_view::npos) next_pos = len;
-        
-        // Get line view
-        size_t line_len = next_pos - pos;
+    for (size_t li = 0; li < lines.size(); ++li) {
+        std::string_view line_raw = doc.view(lines[li]);
         // Handle CR if present
-        if (line_len > 0 && text_view[pos + line_len - 1] == '\r') {
-            line_len--;
+        if (!line_raw.empty() && line_raw.back() == '\r') {
+            line_raw.remove_suffix(1);
         }
-        
-        std::string_view line_raw = text_view.substr(pos, line_len);
-        pos = next_pos + 1; // Advance past newline
 
         // 1. Strip whitespace
         size_t first = line_raw.find_first_not_of(" \t");
@@ -124,15 +191,27 @@ FilterResult C4QualityFilter::filter(std::string& text) {
         size_t last = line_raw.find_last_not_of(" \t");
         line_raw = line_raw.substr(first, (last - first + 1));
 
-        // 2. Check max word length on raw line first!
-        LineStats raw_stats = analyzeLine(line_raw, max_word_length);
-        if (raw_stats.has_long_word) {
-            continue;
+        // 2. Check max word length on raw line first! The document's word
+        // spans for this line are exactly the words of the stripped line.
+        const uint32_t word_begin = doc.lineWordBegin(li);
+        const uint32_t word_end = doc.lineWordBegin(li + 1);
+        if (max_word_length != -1) {
+            bool has_long_word = false;
+            for (uint32_t w = word_begin; w < word_end; ++w) {
+                if ((int)words[w].length > max_word_length) {
+                    has_long_word = true;
+                    break;
+                }
+            }
+            if (has_long_word) continue;
         }
         
-        // Now remove citations
-        line_buf.assign(line_raw.data(), line_raw.size());
-        if (remove_citations) {
+        // Now remove citations. Only lines containing '[' can change, the
+        // rest keep the word count already known from the document.
+        std::string_view line = line_raw;
+        int word_count = static_cast<int>(word_end - word_begin);
+        if (remove_citations && line_raw.find('[') != std::string_view::npos) {
+            line_buf.assign(line_raw.data(), line_raw.size());
             size_t new_len = removeCitationsInPlace(line_buf.data(), line_buf.size());
             line_buf.resize(new_len);
             
@@ -142,35 +221,40 @@ FilterResult C4QualityFilter::filter(std::string& text) {
             size_t l = line_buf.find_last_not_of(" \t");
             if (l < line_buf.size() - 1) line_buf.erase(l + 1);
             if (f > 0) line_buf.erase(0, f);
+
+            line = line_buf;
+            word_count = analyzeLine(line, -1).word_count;
         }
         
         // Check min words on modified line
-        LineStats final_stats = analyzeLine(line_buf, -1);
-        if (final_stats.word_count < min_words_per_line) continue;
+        if (word_count < min_words_per_line) continue;
         
         // Check terminal punct
         if (filter_no_terminal_punct) {
-            char last_char = line_buf.back();
+            char last_char = line.back();
             bool has_end_punct = end_punct_table[static_cast<unsigned char>(last_char)];
-            bool ends_ellipsis = (line_buf.length() >= 3 && line_buf.substr(line_buf.length()-3) == "...");
+            bool ends_ellipsis = (line.length() >= 3 && line.substr(line.length()-3) == "...");
             
             if (!has_end_punct || ends_ellipsis) continue;
         }
         
         // Convert to lower for substring checks
-        std::string line_l = Utils::toLower(line_buf);
+        line_l.resize(line.size());
+        std::transform(line.begin(), line.end(), line_l.begin(), ::tolower);
 
         // lorem ipsum
         if (filter_lorem_ipsum && line_l.find("lorem ipsum") != std::string::npos) {
-            return {false, "lorem_ipsum"};
+            stats.early_drop = DropReason::LoremIpsum;
+            return stats;
         }
         // javascript
         if (filter_javascript && line_l.find("javascript") != std::string::npos) {
             continue;
         }
         // curly bracket (check original case)
-        if (filter_curly_bracket && line_buf.find('{') != std::string::npos) {
-            return {false, "curly_bracket"};
+        if (filter_curly_bracket && line.find('{') != std::string_view::npos) {
+            stats.early_drop = DropReason::CurlyBracket;
+            return stats;
         }
         // policy
         if (filter_policy) {
@@ -185,50 +269,95 @@ FilterResult C4QualityFilter::filter(std::string& text) {
         }
 
         // Keep line
-        if (min_num_sentences != -1) {
-            num_sentences++;
+        stats.sentences++;
+
+        if (result) {
+            if (!result->empty()) {
+                *result += '\n';
+                *result_lower += '\n';
+            }
+            *result += line;
+            *result_lower += line_l;
         }
-        
-        if (!result.empty()) result += '\n';
-        result += line_buf;
     }
+    return stats;
+}
+
+FilterResult C4QualityFilter::filter(DocumentAnalysis& doc) {
+    std::string result;
+    result.reserve(doc.size());
+    // Lower-cased copy of the kept lines, handed back with the result
+    std::string result_lower;
+    result_lower.reserve(doc.size());
 
-    if (num_sentences < min_num_sentences) {
-        return {false, "too_few_sentences"};
+    FilterResult verdict = evaluate(scanLines(doc, &result, &result_lower));
+    if (verdict.keep) {
+        doc.reset(std::move(result), std::move(result_lower));
     }
+    return verdict;
+}
 
-    text = std::move(result);
-    return {true, ""};
+C4QualityStats C4QualityFilter::computeStats(const DocumentAnalysis& doc) const {
+    return scanLines(doc, nullptr, nullptr);
 }
 
-// C4ParagraphFilter (Unchanged)
-C4ParagraphFilter::C4ParagraphFilter() {}
-FilterResult C4ParagraphFilter::filter(const std::string& text) {
-    auto lines = Utils::splitLines(text);
+FilterResult C4QualityFilter::evaluate(const C4QualityStats& stats) const {
+    if (stats.early_drop != DropReason::None) {
+        return {false, stats.early_drop};
+    }
+    if (min_num_sentences != -1 && static_cast<int>(stats.sentences) < min_num_sentences) {
+        return {false, DropReason::TooFewSentences};
+    }
+    return {true};
+}
+
+// C4ParagraphFilter
+C4ParagraphFilter::C4ParagraphFilter(int min_paragraphs, int min_paragraph_len)
+    : min_paragraphs(min_paragraphs), min_paragraph_len(min_paragraph_len) {}
+FilterResult C4ParagraphFilter::filter(const DocumentAnalysis& doc) {
+    const auto& lines = doc.lines();
     if ((int)lines.size() < min_paragraphs) {
-        return {false, "< min_paragraphs"};
+        return {false, DropReason::FewParagraphs};
+    }
+    if (lines.size() < 3) {
+        return {false, DropReason::FewParagraphsLogicCheck};
     }
-    std::vector<size_t> lengths;
-    lengths.reserve(lines.size());
-    for (const auto& l : lines) lengths.push_back(l.length());
-    if (lengths.size() >= 3) {
-        std::partial_sort(lengths.begin(), lengths.begin() + 3, lengths.end(), std::greater<size_t>());
-        if (lengths[2] < (size_t)min_paragraph_len) {
-            return {false, "top 3 paragraphs too short"};
+    // Track the three longest lines instead of sorting all lengths
+    size_t top[3] = {0, 0, 0};
+    for (const TextSpan& l : lines) {
+        size_t len = doc.view(l).size();
+        if (len > 0 && doc.text()[l.offset + len - 1] == '\r') len--;
+        if (len <= top[2]) continue;
+        if (len > top[0]) {
+            top[2] = top[1];
+            top[1] = top[0];
+            top[0] = len;
+        } else if (len > top[1]) {
+            top[2] = top[1];
+            top[1] = len;
+        } else {
+            top[2] = len;
         }
-    } else {
-        return {false, "< 3 paragraphs (logic check)"};
     }
-    return {true, ""};
+    if (top[2] < (size_t)min_paragraph_len) {
+        return {false, DropReason::ShortParagraphs};
+    }
+    return {true};
+}
+
+void C4ParagraphFilter::filterBatch(std::string_view arena, Span<const DocRef> docs, Span<Verdict> out) {
+    filterEach(*this, arena, docs, out);
 }
 
-// C4BadWordsFilter (Unchanged)
-C4BadWordsFilter::C4BadWordsFilter() {
-    loadBadWords();
+// C4BadWordsFilter
+C4BadWordsFilter::C4BadWordsFilter(const std::string& path) {
+    loadBadWords(path);
 }
 
-void C4BadWordsFilter::loadBadWords() {
-    std::ifstream f("badwords_en.txt");
+C4BadWordsFilter::C4BadWordsFilter(std::vector<std::string> words) : badwords(std::move(words)) {}
+
+void C4BadWordsFilter::loadBadWords(const std::string& path) {
+    std::ifstream f(path);
     badwords.clear();
 
     if (f.good()) {
@@ -246,23 +375,49 @@ void C4BadWordsFilter::loadBadWords() {
 
 }
 
-FilterResult C4BadWordsFilter::filter(const std::string& text) {
-    std::string text_l = Utils::toLower(text);
-    for (const auto& bw : badwords) {
+FilterResult C4BadWordsFilter::filter(const DocumentAnalysis& doc) {
+    std::string_view text_l = doc.lower();
+    for (uint32_t i = 0; i < badwords.size(); ++i) {
+        const std::string& bw = badwords[i];
         size_t pos = 0;
-        while ((pos = text_l.find(bw, pos)) != std::string::npos) {
+        while ((pos = text_l.find(bw, pos)) != std::string_view::npos) {
             bool left_ok = (pos == 0) || !isalnum(static_cast<unsigned char>(text_l[pos-1]));
             bool right_ok = (pos + bw.length() == text_l.length()) || !isalnum(static_cast<unsigned char>(text_l[pos + bw.length()]));
             if (left_ok && right_ok) {
-                return {false, "badword: " + bw};
+                return {false, DropReason::BadWord, i};
             }
             pos += 1;
         }
     }
-    return {true, ""};
+    return {true};
+}
+
+void C4BadWordsFilter::filterBatch(std::string_view arena, Span<const DocRef> docs, Span<Verdict> out) {
+    filterEach(*this, arena, docs, out);
+}
+
+std::string C4BadWordsFilter::describe(const FilterResult& result) const {
+    if (result.reason == DropReason::BadWord && result.detail < badwords.size()) {
+        return "badword: " + badwords[result.detail];
+    }
+    return formatDropReason(result.reason, result.detail);
 }
 
 // GopherQualityFilter
+GopherQualityFilter::GopherQualityFilter(const GopherQualityConfig& config)
+    : GopherQualityFilter(config.min_doc_words,
+                          config.max_doc_words,
+                          config.min_avg_word_length,
+                          config.max_avg_word_length,
+                          config.max_symbol_word_ratio,
+                          config.max_bullet_lines_ratio,
+                          config.max_ellipsis_lines_ratio,
+                          config.max_non_alpha_words_ratio,
+                          config.min_stop_words,
+                          config.stop_words) {
+    unicode_ = config.unicode;
+}
+
 GopherQualityFilter::GopherQualityFilter(
     int min_doc_words,
     int max_doc_words,
@@ -284,14 +439,12 @@ GopherQualityFilter::GopherQualityFilter(
       max_ellipsis_lines_ratio_(max_ellipsis_lines_ratio),
       max_non_alpha_words_ratio_(max_non_alpha_words_ratio),
       min_stop_words_(min_stop_words) {
-    static const std::vector<std::string> DEFAULT_STOP_WORDS = {
-        "the", "be", "to", "of", "and", "that", "have", "with"
-    };
+    // The default English list is matched by hand-unrolled compares in
+    // isStopWord; custom lists get a minimal perfect hash.
     if (stop_words.empty()) {
-        stop_words_vec_ = DEFAULT_STOP_WORDS;
         using_default_stopwords_ = true;
     } else {
-        stop_words_vec_ = stop_words;
+        stop_words_ = PerfectHashSet(stop_words);
         using_default_stopwords_ = false;
     }
 
@@ -325,121 +478,116 @@ bool GopherQualityFilter::isStopWord(const char* w, size_t len) const {
                        (w[0] == 'h' && w[1] == 'a' && w[2] == 'v' && w[3] == 'e') ||
                        (w[0] == 'w' && w[1] == 'i' && w[2] == 't' && w[3] == 'h');
             default:
-                break;
+                return false;
         }
     }
-    for (const auto& sw : stop_words_vec_) {
-        if (sw.size() != len) continue;
-        if (std::memcmp(sw.data(), w, len) == 0) return true;
-    }
-    return false;
+    return stop_words_.contains(std::string_view(w, len));
 }
 
-FilterResult GopherQualityFilter::filter(const std::string& text) const {
-    const char* data = text.data();
-    const size_t n = text.size();
-
-    // Tokenize on whitespace (like Python word_tokenize default whitespace splitter here)
-    std::vector<std::string_view> words;
-    size_t i = 0;
-    while (i < n) {
-        while (i < n && space_table_[static_cast<unsigned char>(data[i])]) i++;
-        size_t start = i;
-        while (i < n && !space_table_[static_cast<unsigned char>(data[i])]) i++;
-        if (start < i) {
-            words.emplace_back(data + start, i - start);
-        }
-    }
+void GopherQualityFilter::wordStats(const DocumentAnalysis& doc, GopherQualityStats& stats,
+                                    bool count_stop_words) const {
+    // Whitespace tokenization (like Python str.split), shared with the other filters
+    const auto& words = doc.words();
 
-    const size_t n_words = words.size();
     size_t n_non_symbol_words = 0;
     size_t total_non_symbol_len = 0;
     size_t words_with_alpha = 0;
     size_t stop_word_count = 0;
 
-    for (const auto& w : words) {
+    // Pure-ASCII documents take the byte path even in Unicode mode.
+    const bool decode_utf8 = unicode_ && !Unicode::isAscii(doc.text());
+
+    size_t word_count = 0;
+    auto countWord = [&](std::string_view w) {
         bool non_symbol = false;
         bool has_alpha = false;
+        unsigned char high = 0;
         for (char ch : w) {
             unsigned char uc = static_cast<unsigned char>(ch);
             if (!punctuation_table_[uc]) non_symbol = true;
             if (alpha_table_[uc]) has_alpha = true;
+            high |= uc;
+        }
+        size_t word_len = w.size();
+        if (decode_utf8 && (high & 0x80)) {
+            if (!has_alpha) has_alpha = Unicode::containsLetter(w);
+            word_len = Unicode::codePointCount(w);
         }
+        word_count++;
         if (non_symbol) {
             n_non_symbol_words++;
-            total_non_symbol_len += w.size();
+            total_non_symbol_len += word_len;
         }
         if (has_alpha) {
             words_with_alpha++;
         }
-        if (min_stop_words_ && isStopWord(w.data(), w.size())) {
+        if (count_stop_words && isStopWord(w.data(), w.size())) {
             stop_word_count++;
         }
-    }
-
-    if (n_words == 0) {
-        return {false, "gopher_short_doc"};
-    }
-
-    if (min_doc_words_ && static_cast<int>(n_non_symbol_words) < min_doc_words_) {
-        return {false, "gopher_short_doc"};
-    }
-    if (max_doc_words_ && static_cast<int>(n_non_symbol_words) > max_doc_words_) {
-        return {false, "gopher_long_doc"};
-    }
+    };
 
-    if (n_non_symbol_words > 0) {
-        double avg_len = static_cast<double>(total_non_symbol_len) / static_cast<double>(n_non_symbol_words);
-        if (min_avg_word_length_ && avg_len < min_avg_word_length_) {
-            return {false, "gopher_below_avg_threshold"};
+    for (const TextSpan& span : words) {
+        std::string_view w = doc.view(span);
+        if (!unicode_) {
+            countWord(w);
+            continue;
         }
-        if (max_avg_word_length_ && avg_len > max_avg_word_length_) {
-            return {false, "gopher_above_avg_threshold"};
+        // str.split() also splits on NBSP, U+3000 and the other Unicode
+        // spaces the shared ASCII tokenization keeps inside a word.
+        size_t start = 0;
+        for (size_t i = 0; i < w.size();) {
+            const size_t space = Unicode::extraSpaceLength(w, i);
+            if (space == 0) {
+                i++;
+                continue;
+            }
+            if (i > start) countWord(w.substr(start, i - start));
+            i += space;
+            start = i;
         }
-    } else if (min_avg_word_length_) {
-        return {false, "gopher_below_avg_threshold"};
+        if (start < w.size()) countWord(w.substr(start));
     }
 
-    if (max_symbol_word_ratio_) {
-        size_t hash_count = std::count(text.begin(), text.end(), '#');
-
-        size_t ellipsis_tokens = 0;
-        for (size_t pos = 0; (pos = text.find("...", pos)) != std::string::npos; pos += 3) {
-            ellipsis_tokens++;
-        }
-        for (size_t pos = 0; (pos = text.find("\xE2\x80\xA6", pos)) != std::string::npos; pos += 3) {
-            ellipsis_tokens++;
-        }
-
-        double hash_ratio = static_cast<double>(hash_count) / static_cast<double>(n_words);
-        if (hash_ratio > max_symbol_word_ratio_) {
-            return {false, "gopher_too_many_hashes"};
-        }
-        double ellipsis_ratio = static_cast<double>(ellipsis_tokens) / static_cast<double>(n_words);
-        if (ellipsis_ratio > max_symbol_word_ratio_) {
-            return {false, "gopher_too_many_ellipsis"};
-        }
-    }
+    stats.words = static_cast<uint32_t>(word_count);
+    stats.non_symbol_words = static_cast<uint32_t>(n_non_symbol_words);
+    stats.non_symbol_chars = static_cast<uint32_t>(total_non_symbol_len);
+    stats.alpha_words = static_cast<uint32_t>(words_with_alpha);
+    stats.stop_words = static_cast<uint32_t>(stop_word_count);
+}
 
-    // Line-based checks
-    std::vector<std::string_view> lines;
-    size_t line_start = 0;
-    for (size_t idx = 0; idx <= n; ++idx) {
-        if (idx == n || data[idx] == '\n') {
-            lines.emplace_back(data + line_start, idx - line_start);
-            line_start = idx + 1;
-        }
+void GopherQualityFilter::symbolStats(const DocumentAnalysis& doc, GopherQualityStats& stats) const {
+    std::string_view text = doc.text();
+    size_t ellipsis_tokens = 0;
+    for (size_t pos = 0; (pos = text.find("...", pos)) != std::string_view::npos; pos += 3) {
+        ellipsis_tokens++;
     }
-    const size_t line_count = lines.size();
-    if (line_count == 0) {
-        return {false, "gopher_short_doc"};
+    for (size_t pos = 0; (pos = text.find("\xE2\x80\xA6", pos)) != std::string_view::npos; pos += 3) {
+        ellipsis_tokens++;
     }
+    stats.hashes = static_cast<uint32_t>(doc.charCounts().hash);
+    stats.ellipsis_tokens = static_cast<uint32_t>(ellipsis_tokens);
+}
 
+void GopherQualityFilter::lineStats(const DocumentAnalysis& doc, GopherQualityStats& stats) const {
+    // Unlike getline, a trailing newline (or an empty document) still counts
+    // as one more, empty, line.
+    const auto& lines = doc.lines();
     size_t bullet_lines = 0;
     size_t ellipsis_lines = 0;
-    for (auto line : lines) {
+    size_t extra_lines = 0;
+
+    // Unicode mode strips what str.strip() strips: NBSP, U+3000, ... too.
+    auto isSpaceAt = [this](std::string_view s, size_t i) -> size_t {
+        if (space_table_[static_cast<unsigned char>(s[i])]) return 1;
+        return unicode_ ? Unicode::extraSpaceLength(s, i) : 0;
+    };
+    auto countLine = [&](std::string_view line) {
         size_t l = 0;
-        while (l < line.size() && space_table_[static_cast<unsigned char>(line[l])]) l++;
+        while (l < line.size()) {
+            const size_t space = isSpaceAt(line, l);
+            if (space == 0) break;
+            l += space;
+        }
         if (l < line.size()) {
             unsigned char c0 = static_cast<unsigned char>(line[l]);
             if (c0 == '-') {
@@ -453,7 +601,12 @@ FilterResult GopherQualityFilter::filter(const std::string& text) const {
         }
 
         size_t r = line.size();
-        while (r > 0 && space_table_[static_cast<unsigned char>(line[r - 1])]) r--;
+        while (r > 0) {
+            size_t space = space_table_[static_cast<unsigned char>(line[r - 1])] ? 1 : 0;
+            if (space == 0 && unicode_) space = Unicode::extraSpaceLengthBefore(line, r);
+            if (space == 0) break;
+            r -= space;
+        }
         if (r >= 3) {
             const unsigned char* tail = reinterpret_cast<const unsigned char*>(line.data() + r - 3);
             if ((tail[0] == '.' && tail[1] == '.' && tail[2] == '.') ||
@@ -461,34 +614,510 @@ FilterResult GopherQualityFilter::filter(const std::string& text) const {
                 ellipsis_lines++;
             }
         }
+    };
+
+    for (const TextSpan& span : lines) {
+        std::string_view line = doc.view(span);
+        if (!unicode_) {
+            countLine(line);
+            continue;
+        }
+        // str.splitlines() also breaks on \r, U+2028 and the like; a \r
+        // right before the '\n' that ended this line is part of that break.
+        size_t stop = line.size();
+        if (stop > 0 && line[stop - 1] == '\r' && span.offset + span.length < doc.size()) stop--;
+        size_t begin = 0;
+        for (size_t i = 0; i < stop;) {
+            const size_t brk = Unicode::extraLineBreakLength(line, i);
+            if (brk == 0) {
+                i++;
+                continue;
+            }
+            countLine(line.substr(begin, i - begin));
+            extra_lines++;
+            i += brk;
+            begin = i;
+        }
+        countLine(line.substr(begin, stop - std::min(begin, stop)));
+    }
+    stats.lines = static_cast<uint32_t>(lines.size() + extra_lines +
+                                        ((doc.empty() || doc.endsWithNewline()) ? 1 : 0));
+    stats.bullet_lines = static_cast<uint32_t>(bullet_lines);
+    stats.ellipsis_lines = static_cast<uint32_t>(ellipsis_lines);
+}
+
+FilterResult GopherQualityFilter::checkWords(const GopherQualityStats& stats) const {
+    if (stats.words == 0) {
+        return {false, DropReason::GopherShortDoc};
+    }
+
+    if (min_doc_words_ && static_cast<int>(stats.non_symbol_words) < min_doc_words_) {
+        return {false, DropReason::GopherShortDoc};
+    }
+    if (max_doc_words_ && static_cast<int>(stats.non_symbol_words) > max_doc_words_) {
+        return {false, DropReason::GopherLongDoc};
+    }
+
+    if (stats.non_symbol_words > 0) {
+        double avg_len = static_cast<double>(stats.non_symbol_chars) / static_cast<double>(stats.non_symbol_words);
+        if (min_avg_word_length_ && avg_len < min_avg_word_length_) {
+            return {false, DropReason::GopherBelowAvgThreshold};
+        }
+        if (max_avg_word_length_ && avg_len > max_avg_word_length_) {
+            return {false, DropReason::GopherAboveAvgThreshold};
+        }
+    } else if (min_avg_word_length_) {
+        return {false, DropReason::GopherBelowAvgThreshold};
+    }
+    return {true};
+}
+
+FilterResult GopherQualityFilter::checkSymbols(const GopherQualityStats& stats) const {
+    if (max_symbol_word_ratio_) {
+        double hash_ratio = static_cast<double>(stats.hashes) / static_cast<double>(stats.words);
+        if (hash_ratio > max_symbol_word_ratio_) {
+            return {false, DropReason::GopherTooManyHashes};
+        }
+        double ellipsis_ratio = static_cast<double>(stats.ellipsis_tokens) / static_cast<double>(stats.words);
+        if (ellipsis_ratio > max_symbol_word_ratio_) {
+            return {false, DropReason::GopherTooManyEllipsis};
+        }
+    }
+    return {true};
+}
+
+FilterResult GopherQualityFilter::checkLines(const GopherQualityStats& stats) const {
+    if (stats.lines == 0) {
+        return {false, DropReason::GopherShortDoc};
     }
 
     if (max_bullet_lines_ratio_) {
-        double ratio = static_cast<double>(bullet_lines) / static_cast<double>(line_count);
+        double ratio = static_cast<double>(stats.bullet_lines) / static_cast<double>(stats.lines);
         if (ratio > max_bullet_lines_ratio_) {
-            return {false, "gopher_too_many_bullets"};
+            return {false, DropReason::GopherTooManyBullets};
         }
     }
 
     if (max_ellipsis_lines_ratio_) {
-        double ratio = static_cast<double>(ellipsis_lines) / static_cast<double>(line_count);
+        double ratio = static_cast<double>(stats.ellipsis_lines) / static_cast<double>(stats.lines);
         if (ratio > max_ellipsis_lines_ratio_) {
-            return {false, "gopher_too_many_end_ellipsis"};
+            return {false, DropReason::GopherTooManyEndEllipsis};
         }
     }
 
     if (max_non_alpha_words_ratio_) {
-        double ratio = static_cast<double>(words_with_alpha) / static_cast<double>(n_words);
+        double ratio = static_cast<double>(stats.alpha_words) / static_cast<double>(stats.words);
         if (ratio < max_non_alpha_words_ratio_) {
-            return {false, "gopher_below_alpha_threshold"};
+            return {false, DropReason::GopherBelowAlphaThreshold};
         }
     }
 
     if (min_stop_words_) {
-        if (static_cast<int>(stop_word_count) < min_stop_words_) {
-            return {false, "gopher_enough_stop_words"};
+        if (static_cast<int>(stats.stop_words) < min_stop_words_) {
+            return {false, DropReason::GopherEnoughStopWords};
+        }
+    }
+
+    return {true};
+}
+
+FilterResult GopherQualityFilter::filter(const DocumentAnalysis& doc) const {
+    GopherQualityStats stats;
+    wordStats(doc, stats, min_stop_words_ != 0);
+    FilterResult result = checkWords(stats);
+    if (!result.keep) return result;
+
+    if (max_symbol_word_ratio_) {
+        symbolStats(doc, stats);
+        result = checkSymbols(stats);
+        if (!result.keep) return result;
+    }
+
+    lineStats(doc, stats);
+    return checkLines(stats);
+}
+
+GopherQualityStats GopherQualityFilter::computeStats(const DocumentAnalysis& doc) const {
+    GopherQualityStats stats;
+    wordStats(doc, stats, true);
+    symbolStats(doc, stats);
+    lineStats(doc, stats);
+    return stats;
+}
+
+FilterResult GopherQualityFilter::evaluate(const GopherQualityStats& stats) const {
+    FilterResult result = checkWords(stats);
+    if (!result.keep) return result;
+    result = checkSymbols(stats);
+    if (!result.keep) return result;
+    return checkLines(stats);
+}
+
+void GopherQualityFilter::filterBatch(std::string_view arena, Span<const DocRef> docs, Span<Verdict> out) const {
+    filterEach(*this, arena, docs, out);
+}
+
+// Line-hash helpers shared by GopherRepetitionFilter and FineWebQualityFilter
+namespace {
+
+// Per-thread table for exact duplicate detection over text spans.
+HashCountTable& spanTable() {
+    thread_local HashCountTable table;
+    return table;
+}
+
+// Register a span; true if an identical span was registered before.
+bool isDuplicateSpan(HashCountTable& table, std::string_view text, const TextSpan* spans, uint32_t index) {
+    std::string_view e = text.substr(spans[index].offset, spans[index].length);
+    bool inserted = false;
+    table.findOrInsert(Hashing::hashBytes(e), index, [&](uint32_t j) {
+        return text.substr(spans[j].offset, spans[j].length) == e;
+    }, inserted);
+    return !inserted;
+}
+
+struct DuplicateCount {
+    size_t elements = 0;
+    size_t chars = 0;
+};
+
+// Python find_duplicates(): every repeat of an element already seen counts
+// once, together with its length.
+DuplicateCount findDuplicates(std::string_view text, const std::vector<TextSpan>& spans) {
+    DuplicateCount dup;
+    HashCountTable& table = spanTable();
+    table.reset(spans.size());
+    for (uint32_t i = 0; i < spans.size(); ++i) {
+        if (isDuplicateSpan(table, text, spans.data(), i)) {
+            dup.elements++;
+            dup.chars += spans[i].length;
+        }
+    }
+    return dup;
+}
+
+// Python re.split(r"\n{2,}", text.strip())
+void splitParagraphs(std::string_view text, std::vector<TextSpan>& out) {
+    out.clear();
+    size_t b = 0;
+    size_t e = text.size();
+    while (b < e && isspace(static_cast<unsigned char>(text[b]))) b++;
+    while (e > b && isspace(static_cast<unsigned char>(text[e - 1]))) e--;
+    size_t start = b;
+    size_t pos = b;
+    while (pos < e) {
+        if (text[pos] == '\n' && pos + 1 < e && text[pos + 1] == '\n') {
+            out.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(pos - start)});
+            while (pos < e && text[pos] == '\n') pos++;
+            start = pos;
+        } else {
+            pos++;
+        }
+    }
+    out.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(e - start)});
+}
+
+// Python re.split("\n+", text), derived from the document's lines: runs of
+// newlines collapse, but a leading and a trailing empty element survive.
+void splitLineRuns(const DocumentAnalysis& doc, std::vector<TextSpan>& out) {
+    out.clear();
+    const auto& lines = doc.lines();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (i == 0 || lines[i].length > 0) out.push_back(lines[i]);
+    }
+    if (out.empty() || doc.endsWithNewline()) {
+        out.push_back({static_cast<uint32_t>(doc.size()), 0});
+    }
+}
+
+// Polynomial hashing base (odd, so it is invertible modulo 2^64).
+constexpr uint64_t kPolyBase = 0x100000001B3ULL;
+
+constexpr uint64_t inverseMod64(uint64_t a) {
+    uint64_t x = a; // correct to 3 bits for odd a; each step doubles that
+    for (int i = 0; i < 5; ++i) x *= 2 - a * x;
+    return x;
+}
+
+constexpr uint64_t kPolyBaseInv = inverseMod64(kPolyBase);
+static_assert(kPolyBase * kPolyBaseInv == 1, "base must be invertible");
+
+struct RepetitionScratch {
+    std::vector<TextSpan> elements;
+
+    // Per word j (with one extra entry at the end):
+    std::vector<uint64_t> word_prefix;   // rolling hash over word hashes [0, j)
+    std::vector<uint64_t> concat_prefix; // rolling hash over the bytes of words [0, j), no separators
+    std::vector<uint64_t> concat_pow;    // base^(bytes in words [0, j))
+    std::vector<uint64_t> concat_inv;    // base^-(bytes in words [0, j))
+    std::vector<uint32_t> concat_len;    // bytes in words [0, j)
+
+    std::vector<HashCountTable> top_tables;
+    std::vector<HashCountTable> dup_tables;
+    std::vector<size_t> dup_next;
+    std::vector<size_t> dup_chars;
+};
+
+RepetitionScratch& repetitionScratch() {
+    thread_local RepetitionScratch scratch;
+    return scratch;
+}
+
+// "".join(words[a:a+n]) == "".join(words[b:b+n])
+bool concatEqual(std::string_view text, const std::vector<TextSpan>& words,
+                 const std::vector<uint32_t>& concat_len, size_t a, size_t b, size_t n) {
+    if (concat_len[a + n] - concat_len[a] != concat_len[b + n] - concat_len[b]) return false;
+    size_t wa = a, wb = b, oa = 0, ob = 0;
+    while (wa < a + n && wb < b + n) {
+        const TextSpan& sa = words[wa];
+        const TextSpan& sb = words[wb];
+        size_t len = std::min<size_t>(sa.length - oa, sb.length - ob);
+        if (std::memcmp(text.data() + sa.offset + oa, text.data() + sb.offset + ob, len) != 0) return false;
+        oa += len;
+        ob += len;
+        if (oa == sa.length) { wa++; oa = 0; }
+        if (ob == sb.length) { wb++; ob = 0; }
+    }
+    return true;
+}
+
+} // namespace
+
+GopherRepetitionFilter::GopherRepetitionFilter(const GopherRepetitionConfig& config) : config_(config) {
+    size_t max_n = 0;
+    for (const auto& top : config_.top_n_grams) max_n = std::max(max_n, static_cast<size_t>(std::max(top.first, 0)));
+    word_pow_.assign(max_n + 1, 1);
+    for (size_t k = 1; k < word_pow_.size(); ++k) word_pow_[k] = word_pow_[k - 1] * kPolyBase;
+}
+
+FilterResult GopherRepetitionFilter::filter(const DocumentAnalysis& doc) const {
+    std::string_view text = doc.text();
+    const double text_len = static_cast<double>(text.size());
+    if (text.empty()) {
+        return {true};
+    }
+    RepetitionScratch& sc = repetitionScratch();
+
+    splitParagraphs(text, sc.elements);
+    DuplicateCount para = findDuplicates(text, sc.elements);
+    if (config_.dup_para_frac &&
+        static_cast<double>(para.elements) / static_cast<double>(sc.elements.size()) > config_.dup_para_frac) {
+        return {false, DropReason::DupParaFrac};
+    }
+    if (config_.dup_para_char_frac && static_cast<double>(para.chars) / text_len > config_.dup_para_char_frac) {
+        return {false, DropReason::DupParaCharFrac};
+    }
+
+    splitLineRuns(doc, sc.elements);
+    DuplicateCount line = findDuplicates(text, sc.elements);
+    if (config_.dup_line_frac &&
+        static_cast<double>(line.elements) / static_cast<double>(sc.elements.size()) > config_.dup_line_frac) {
+        return {false, DropReason::DupLineFrac};
+    }
+    if (config_.dup_line_char_frac && static_cast<double>(line.chars) / text_len > config_.dup_line_char_frac) {
+        return {false, DropReason::DupLineCharFrac};
+    }
+
+    // Rolling-hash prefixes over the words, shared by every n.
+    const auto& words = doc.words();
+    const size_t m = words.size();
+    sc.word_prefix.resize(m + 1);
+    sc.concat_prefix.resize(m + 1);
+    sc.concat_pow.resize(m + 1);
+    sc.concat_inv.resize(m + 1);
+    sc.concat_len.resize(m + 1);
+    sc.word_prefix[0] = 0;
+    sc.concat_prefix[0] = 0;
+    sc.concat_pow[0] = 1;
+    sc.concat_inv[0] = 1;
+    sc.concat_len[0] = 0;
+    for (size_t j = 0; j < m; ++j) {
+        const unsigned char* w = reinterpret_cast<const unsigned char*>(text.data() + words[j].offset);
+        uint64_t h = 0;
+        uint64_t pow = 1;
+        uint64_t inv = 1;
+        for (uint32_t k = 0; k < words[j].length; ++k) {
+            h = h * kPolyBase + (w[k] + 1u);
+            pow *= kPolyBase;
+            inv *= kPolyBaseInv;
+        }
+        uint64_t word_hash = Hashing::mix64(h + words[j].length * Hashing::kMul0);
+        sc.word_prefix[j + 1] = sc.word_prefix[j] * kPolyBase + word_hash;
+        sc.concat_prefix[j + 1] = sc.concat_prefix[j] * pow + h;
+        sc.concat_pow[j + 1] = sc.concat_pow[j] * pow;
+        sc.concat_inv[j + 1] = sc.concat_inv[j] * inv;
+        sc.concat_len[j + 1] = sc.concat_len[j] + words[j].length;
+    }
+
+    auto wordsEqual = [&](size_t a, size_t b, size_t n) {
+        for (size_t k = 0; k < n; ++k) {
+            if (doc.view(words[a + k]) != doc.view(words[b + k])) return false;
+        }
+        return true;
+    };
+
+    const size_t n_top = config_.top_n_grams.size();
+    const size_t n_dup = config_.dup_n_grams.size();
+    if (sc.top_tables.size() < n_top) sc.top_tables.resize(n_top);
+    if (sc.dup_tables.size() < n_dup) sc.dup_tables.resize(n_dup);
+    sc.dup_next.assign(n_dup, 0);
+    sc.dup_chars.assign(n_dup, 0);
+    const std::vector<uint64_t>& word_pow = word_pow_;
+    for (size_t t = 0; t < n_top; ++t) sc.top_tables[t].reset(m);
+    for (size_t d = 0; d < n_dup; ++d) sc.dup_tables[d].reset(m);
+
+    // One sweep over the word positions for all n-gram sizes.
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t t = 0; t < n_top; ++t) {
+            const size_t n = static_cast<size_t>(config_.top_n_grams[t].first);
+            if (n == 0 || i + n > m) continue;
+            uint64_t key = Hashing::mix64(sc.word_prefix[i + n] - sc.word_prefix[i] * word_pow[n]);
+            bool inserted = false;
+            auto& slot = sc.top_tables[t].findOrInsert(key, static_cast<uint32_t>(i), [&](uint32_t first) {
+                return wordsEqual(first, i, n);
+            }, inserted);
+            slot.count++;
+        }
+        for (size_t d = 0; d < n_dup; ++d) {
+            const size_t n = static_cast<size_t>(config_.dup_n_grams[d].first);
+            if (n == 0 || sc.dup_next[d] != i || i + n > m) continue;
+            uint64_t key = Hashing::mix64(sc.concat_prefix[i + n] -
+                                          sc.concat_prefix[i] * sc.concat_pow[i + n] * sc.concat_inv[i]);
+            bool inserted = false;
+            sc.dup_tables[d].findOrInsert(key, static_cast<uint32_t>(i), [&](uint32_t first) {
+                return concatEqual(text, words, sc.concat_len, first, i, n);
+            }, inserted);
+            if (inserted) {
+                sc.dup_next[d] = i + 1;
+            } else {
+                sc.dup_chars[d] += sc.concat_len[i + n] - sc.concat_len[i];
+                sc.dup_next[d] = i + n;
+            }
+        }
+    }
+
+    for (size_t t = 0; t < n_top; ++t) {
+        const size_t n = static_cast<size_t>(config_.top_n_grams[t].first);
+        if (n == 0 || m < n) continue;
+        // Counter.most_common(1): highest count, earliest first occurrence on ties
+        uint32_t best_count = 0;
+        uint32_t best_first = 0;
+        sc.top_tables[t].forEach([&](const HashCountTable::Slot& s) {
+            if (s.count > best_count || (s.count == best_count && s.first < best_first)) {
+                best_count = s.count;
+                best_first = s.first;
+            }
+        });
+        // " ".join of the n-gram: word bytes plus n - 1 separators
+        size_t top_len = sc.concat_len[best_first + n] - sc.concat_len[best_first] + (n - 1);
+        if (static_cast<double>(top_len * best_count) / text_len > config_.top_n_grams[t].second) {
+            return {false, DropReason::TopNGram, static_cast<uint32_t>(n)};
+        }
+    }
+
+    for (size_t d = 0; d < n_dup; ++d) {
+        const size_t n = static_cast<size_t>(config_.dup_n_grams[d].first);
+        if (static_cast<double>(sc.dup_chars[d]) / text_len > config_.dup_n_grams[d].second) {
+            return {false, DropReason::DuplicatedNGrams, static_cast<uint32_t>(n)};
         }
     }
 
-    return {true, ""};
+    return {true};
+}
+
+// FineWebQualityFilter
+FineWebQualityFilter::FineWebQualityFilter(const FineWebQualityConfig& config) : config_(config) {
+    if (config_.stop_chars.empty()) {
+        config_.stop_chars = {
+            ".", "!", "?",
+            "\xE2\x80\xA6",         // … horizontal ellipsis
+            "\xE2\x80\xBC",         // ‼
+            "\xE2\x80\xBD",         // ‽
+            "\xE2\x81\x87",         // ⁇
+            "\xE2\x81\x88",         // ⁈
+            "\xE2\x81\x89",         // ⁉
+            "\xE3\x80\x82",         // 。 ideographic full stop
+            "\xEF\xBC\x81",         // ！ fullwidth exclamation mark
+            "\xEF\xBC\x8E",         // ． fullwidth full stop
+            "\xEF\xBC\x9F",         // ？ fullwidth question mark
+            "\xEF\xBD\xA1",         // ｡ halfwidth ideographic full stop
+            "\xD8\x9F",              // ؟ arabic question mark
+            "\xDB\x94",              // ۔ arabic full stop
+            "\xE0\xA5\xA4",         // । devanagari danda
+            "\xE0\xA5\xA5",         // ॥ devanagari double danda
+        };
+    }
+    ascii_stop_table_.fill(false);
+    for (const auto& sc : config_.stop_chars) {
+        if (sc.size() == 1) {
+            ascii_stop_table_[static_cast<unsigned char>(sc[0])] = true;
+        } else if (!sc.empty()) {
+            multibyte_stop_chars_.push_back(sc);
+        }
+    }
+}
+
+bool FineWebQualityFilter::endsWithStopChar(std::string_view line) const {
+    if (line.empty()) return false;
+    if (ascii_stop_table_[static_cast<unsigned char>(line.back())]) return true;
+    for (const auto& sc : multibyte_stop_chars_) {
+        if (line.size() >= sc.size() && line.compare(line.size() - sc.size(), sc.size(), sc) == 0) return true;
+    }
+    return false;
+}
+
+FilterResult FineWebQualityFilter::filter(const DocumentAnalysis& doc) const {
+    std::string_view text = doc.text();
+    const auto& lines = doc.lines();
+
+    // One pass over the non-blank lines for all three line statistics.
+    HashCountTable& table = spanTable();
+    table.reset(lines.size());
+    size_t n_lines = 0;
+    size_t punct_lines = 0;
+    size_t short_lines = 0;
+    size_t dup_chars = 0;
+    for (uint32_t i = 0; i < lines.size(); ++i) {
+        std::string_view line = doc.view(lines[i]);
+        bool blank = true;
+        for (char c : line) {
+            if (!isspace(static_cast<unsigned char>(c))) {
+                blank = false;
+                break;
+            }
+        }
+        if (blank) continue;
+
+        n_lines++;
+        if (endsWithStopChar(line)) punct_lines++;
+        if (static_cast<int>(line.size()) <= config_.short_line_length) short_lines++;
+        if (isDuplicateSpan(table, text, lines.data(), i)) dup_chars += line.size();
+    }
+
+    if (n_lines == 0) {
+        return {false, DropReason::FineWebEmpty};
+    }
+
+    double ratio = static_cast<double>(punct_lines) / static_cast<double>(n_lines);
+    if (ratio < config_.line_punct_thr && !(ratio == 0 && config_.line_punct_exclude_zero)) {
+        return {false, DropReason::LinePunctRatio};
+    }
+
+    ratio = static_cast<double>(short_lines) / static_cast<double>(n_lines);
+    if (ratio > config_.short_line_thr) {
+        return {false, DropReason::ShortLineRatio};
+    }
+
+    const size_t newlines = doc.charCounts().newline;
+    ratio = static_cast<double>(dup_chars) / static_cast<double>(text.size() - newlines);
+    if (ratio > config_.char_duplicates_ratio) {
+        return {false, DropReason::CharDupRatio};
+    }
+
+    ratio = static_cast<double>(newlines) / static_cast<double>(doc.words().size());
+    if (ratio > config_.new_line_ratio) {
+        return {false, DropReason::ListRatio};
+    }
+
+    return {true};
 }
@@ -1,56 +1,199 @@
 #pragma once
 
+#include "doc_block.hpp"
+#include "document.hpp"
+#include "perfect_hash.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <array>
 #include <unordered_set>
+#include <utility>
+
+// Why a document was dropped. Filters return these codes, plus a detail
+// value for reasons that carry one (the n of an n-gram check, the index of
+// a bad word); the text is only produced by formatDropReason() or
+// FilterChain::describe() when a CSV row or report is written.
+enum class DropReason : uint8_t {
+    None = 0,
+    EmptyText,
+    // C4QualityFilter
+    LoremIpsum,
+    CurlyBracket,
+    TooFewSentences,
+    // C4ParagraphFilter
+    FewParagraphs,
+    FewParagraphsLogicCheck,
+    ShortParagraphs,
+    // C4BadWordsFilter (detail: index into the filter's word list)
+    BadWord,
+    // GopherQualityFilter
+    GopherShortDoc,
+    GopherLongDoc,
+    GopherBelowAvgThreshold,
+    GopherAboveAvgThreshold,
+    GopherTooManyHashes,
+    GopherTooManyEllipsis,
+    GopherTooManyBullets,
+    GopherTooManyEndEllipsis,
+    GopherBelowAlphaThreshold,
+    GopherEnoughStopWords,
+    // GopherRepetitionFilter (n-gram reasons: detail is n)
+    DupParaFrac,
+    DupParaCharFrac,
+    DupLineFrac,
+    DupLineCharFrac,
+    TopNGram,
+    DuplicatedNGrams,
+    // FineWebQualityFilter
+    FineWebEmpty,
+    LinePunctRatio,
+    ShortLineRatio,
+    CharDupRatio,
+    ListRatio,
+    // ExactDedupFilter
+    Duplicate,
+    // MinHashDedupFilter
+    NearDuplicate,
+    // websift --url-filter (checked before extraction)
+    SeenUrl,
+    // LineFrequencyFilter (every line was frequent)
+    Boilerplate,
+    Count
+};
+
+constexpr size_t kDropReasonCount = static_cast<size_t>(DropReason::Count);
 
 struct FilterResult {
+    static constexpr uint16_t kNoStage = 0xFFFF;
+
     bool keep;
-    std::string reason;
+    DropReason reason = DropReason::None;
+    uint32_t detail = 0;
+    uint16_t stage = kNoStage; // set by FilterChain to the dropping stage
 };
 
-class C4QualityFilter {
-public:
-    C4QualityFilter();
-    FilterResult filter(std::string& text); // Modifies text (filters lines)
+// One result per document of a block.
+using Verdict = FilterResult;
 
-private:
-    bool split_paragraph = true;
+// Text of a reason as written to CSV and reports. Details that need the
+// filter's own data (bad words) are rendered by FilterChain::describe().
+std::string formatDropReason(DropReason reason, uint32_t detail = 0);
+
+// Lines are the text's '\n'-separated lines (datatrove's split_paragraph
+// default; sentence splitting is not implemented, so the option is not
+// accepted).
+struct C4QualityConfig {
     bool remove_citations = true;
     bool filter_no_terminal_punct = true;
-    int min_num_sentences = 5;
+    int min_num_sentences = 5;   // -1 disables
     int min_words_per_line = 5;
-    int max_word_length = 1000;
+    int max_word_length = 1000;  // -1 disables
     bool filter_lorem_ipsum = true;
     bool filter_javascript = true;
     bool filter_curly_bracket = true;
     bool filter_policy = true;
+};
+
+// What C4QualityFilter decides from besides min_num_sentences: the number
+// of lines it would keep, or the early drop (lorem ipsum, curly bracket) it
+// would make first.
+struct C4QualityStats {
+    uint32_t sentences = 0;
+    DropReason early_drop = DropReason::None;
+};
+
+class C4QualityFilter {
+public:
+    explicit C4QualityFilter(const C4QualityConfig& config = C4QualityConfig());
+    FilterResult filter(DocumentAnalysis& doc); // Modifies text (filters lines)
+    // No filterBatch(): the rewrite could not be handed on to later filters.
+
+    // Line statistics without rewriting the text; evaluate() then applies
+    // min_num_sentences. The other options shape the stats themselves.
+    C4QualityStats computeStats(const DocumentAnalysis& doc) const;
+    FilterResult evaluate(const C4QualityStats& stats) const;
+
+private:
+    bool remove_citations;
+    bool filter_no_terminal_punct;
+    int min_num_sentences;
+    int min_words_per_line;
+    int max_word_length;
+    bool filter_lorem_ipsum;
+    bool filter_javascript;
+    bool filter_curly_bracket;
+    bool filter_policy;
 
     std::vector<std::string> policy_substrings;
     std::array<bool, 256> end_punct_table{};
+
+    // Shared line walk; kept lines are appended to result/result_lower when
+    // those are non-null.
+    C4QualityStats scanLines(const DocumentAnalysis& doc, std::string* result, std::string* result_lower) const;
 };
 
 class C4ParagraphFilter {
 public:
-    C4ParagraphFilter();
-    FilterResult filter(const std::string& text);
+    explicit C4ParagraphFilter(int min_paragraphs = 3, int min_paragraph_len = 200);
+    FilterResult filter(const DocumentAnalysis& doc);
+    // Read-only, so it has the block API (see GopherQualityFilter::filterBatch).
+    void filterBatch(std::string_view arena, Span<const DocRef> docs, Span<Verdict> out);
 
 private:
-    int min_paragraphs = 3;
-    int min_paragraph_len = 200;
+    int min_paragraphs;
+    int min_paragraph_len;
 };
 
 class C4BadWordsFilter {
 public:
-    C4BadWordsFilter();
-    FilterResult filter(const std::string& text);
+    // Loads one word per line from path, falling back to a tiny built-in
+    // list when the file is missing.
+    explicit C4BadWordsFilter(const std::string& path = "badwords_en.txt");
+    explicit C4BadWordsFilter(std::vector<std::string> words);
+    FilterResult filter(const DocumentAnalysis& doc);
+    void filterBatch(std::string_view arena, Span<const DocRef> docs, Span<Verdict> out);
+    std::string describe(const FilterResult& result) const;
 
 private:
     // For this implementation, we'll use a simple list for "en"
     std::vector<std::string> badwords;
 
-    void loadBadWords();
+    void loadBadWords(const std::string& path);
+};
+
+struct GopherQualityConfig {
+    int min_doc_words = 50;
+    int max_doc_words = 100000;
+    int min_avg_word_length = 3;
+    int max_avg_word_length = 10;
+    double max_symbol_word_ratio = 0.1;
+    double max_bullet_lines_ratio = 0.9;
+    double max_ellipsis_lines_ratio = 0.3;
+    double max_non_alpha_words_ratio = 0.8;
+    int min_stop_words = 2;
+    std::vector<std::string> stop_words; // empty = default English list
+    // Decode UTF-8: letters by Unicode category, word lengths in code points,
+    // words split on and lines stripped of Unicode whitespace as well (NBSP,
+    // U+3000, ...), lines split like str.splitlines() (U+2028, \r, ...).
+    // Off by default so English parity stays byte-for-byte.
+    bool unicode = false;
+};
+
+// Raw per-document counts behind every GopherQualityFilter threshold, so a
+// threshold set can be applied later without the text (see stats_file.hpp).
+struct GopherQualityStats {
+    uint32_t words = 0;
+    uint32_t non_symbol_words = 0;
+    uint32_t non_symbol_chars = 0;  // total length of the non-symbol words
+    uint32_t alpha_words = 0;       // words with at least one letter
+    uint32_t stop_words = 0;
+    uint32_t hashes = 0;            // '#' characters
+    uint32_t ellipsis_tokens = 0;   // "..." and U+2026 occurrences
+    uint32_t lines = 0;
+    uint32_t bullet_lines = 0;
+    uint32_t ellipsis_lines = 0;    // lines ending in an ellipsis
 };
 
 class GopherQualityFilter {
@@ -67,20 +210,22 @@ public:
         int min_stop_words = 2,
         const std::vector<std::string>& stop_words = {}
     );
+    explicit GopherQualityFilter(const GopherQualityConfig& config);
 
-    FilterResult filter(const std::string& text) const;
+    FilterResult filter(const DocumentAnalysis& doc) const;
+    // Filter a block of documents stored in one arena, analysing each in
+    // place (no copy). out[i] must start as keep; documents already dropped
+    // are skipped. Only read-only filters have this: a filter that rewrites
+    // the text could not hand the rewrite to the next one.
+    void filterBatch(std::string_view arena, Span<const DocRef> docs, Span<Verdict> out) const;
 
-private:
-    struct TransparentHash {
-        using is_transparent = void;
-        size_t operator()(std::string_view sv) const { return std::hash<std::string_view>{}(sv); }
-        size_t operator()(const std::string& s) const { return std::hash<std::string_view>{}(s); }
-    };
-    struct TransparentEq {
-        using is_transparent = void;
-        bool operator()(std::string_view a, std::string_view b) const { return a == b; }
-    };
+    // filter() split in two: every statistic, then the thresholds alone.
+    // evaluate(computeStats(doc)) == filter(doc); filter() only stops early.
+    // The stop-word list and the unicode option shape the stats themselves.
+    GopherQualityStats computeStats(const DocumentAnalysis& doc) const;
+    FilterResult evaluate(const GopherQualityStats& stats) const;
 
+private:
     int min_doc_words_;
     int max_doc_words_;
     int min_avg_word_length_;
@@ -90,13 +235,79 @@ private:
     double max_ellipsis_lines_ratio_;
     double max_non_alpha_words_ratio_;
     int min_stop_words_;
+    bool unicode_ = false;
 
-    std::vector<std::string> stop_words_vec_;
+    PerfectHashSet stop_words_; // custom lists only
     bool using_default_stopwords_ = true;
     std::array<bool, 256> punctuation_table_{};
     std::array<bool, 256> space_table_{};
     std::array<bool, 256> alpha_table_{};
 
     bool isStopWord(const char* w, size_t len) const;
+
+    void wordStats(const DocumentAnalysis& doc, GopherQualityStats& stats, bool count_stop_words) const;
+    void symbolStats(const DocumentAnalysis& doc, GopherQualityStats& stats) const;
+    void lineStats(const DocumentAnalysis& doc, GopherQualityStats& stats) const;
+    FilterResult checkWords(const GopherQualityStats& stats) const;
+    FilterResult checkSymbols(const GopherQualityStats& stats) const;
+    FilterResult checkLines(const GopherQualityStats& stats) const;
+};
+
+
+struct GopherRepetitionConfig {
+    double dup_line_frac = 0.3;
+    double dup_para_frac = 0.3;
+    double dup_line_char_frac = 0.2;
+    double dup_para_char_frac = 0.2;
+    // (n, max fraction of characters in the most frequent n-gram)
+    std::vector<std::pair<int, double>> top_n_grams = {{2, 0.2}, {3, 0.18}, {4, 0.16}};
+    // (n, max fraction of characters in duplicated n-grams)
+    std::vector<std::pair<int, double>> dup_n_grams = {
+        {5, 0.15}, {6, 0.14}, {7, 0.13}, {8, 0.12}, {9, 0.11}, {10, 0.10}
+    };
+};
+
+// Gopher repetition heuristics (duplicate paragraphs/lines, top n-grams,
+// duplicated n-grams), matching the Python reference. Every n-gram size is
+// computed in one sweep over the word spans using rolling hashes and
+// per-thread open-addressing tables; hash hits are verified against the text,
+// so results are exact. Lengths are in bytes, which equals the Python
+// character count for ASCII text.
+class GopherRepetitionFilter {
+public:
+    explicit GopherRepetitionFilter(const GopherRepetitionConfig& config = GopherRepetitionConfig());
+
+    FilterResult filter(const DocumentAnalysis& doc) const;
+
+private:
+    GopherRepetitionConfig config_;
+    std::vector<uint64_t> word_pow_; // kPolyBase^k up to the largest top n-gram size
 };
 
+struct FineWebQualityConfig {
+    double line_punct_thr = 0.12;
+    bool line_punct_exclude_zero = false;
+    std::vector<std::string> stop_chars; // empty = default terminal punctuation
+    double short_line_thr = 0.67;
+    int short_line_length = 30;
+    double char_duplicates_ratio = 0.01;
+    double new_line_ratio = 0.3;
+};
+
+// FineWeb line heuristics: fraction of lines ending in terminal punctuation,
+// fraction of short lines, fraction of characters in duplicated lines and the
+// newline-per-word (list-like) ratio, all gathered in one pass over the
+// document's lines. Lengths are in bytes.
+class FineWebQualityFilter {
+public:
+    explicit FineWebQualityFilter(const FineWebQualityConfig& config = FineWebQualityConfig());
+
+    FilterResult filter(const DocumentAnalysis& doc) const;
+
+private:
+    FineWebQualityConfig config_;
+    std::array<bool, 256> ascii_stop_table_{};
+    std::vector<std::string> multibyte_stop_chars_;
+
+    bool endsWithStopChar(std::string_view line) const;
+};
@@ -1,19 +1,44 @@
 #include "filters.hpp"
+#include "pipeline.hpp"
 #include <iostream>
 #include <sstream>
+#include <string>
 
-int main() {
+int main(int argc, char** argv) {
     std::ios::sync_with_stdio(false);
     std::cin.tie(nullptr);
 
+    std::string spec = "gopher_quality";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--pipeline" && i + 1 < argc) {
+            spec = argv[++i];
+        } else {
+            std::cerr << "Usage: gopher_filter_cli [--pipeline spec] < text" << std::endl;
+            return 1;
+        }
+    }
+
+    FilterChain chain;
+    try {
+        chain = buildPipeline(spec);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
     std::ostringstream buffer;
     buffer << std::cin.rdbuf();
-    std::string text = buffer.str();
+    DocumentAnalysis doc(buffer.str());
 
-    GopherQualityFilter filter;
-    FilterResult res = filter.filter(text);
+    FilterResult res = chain.run(doc);
+    try {
+        chain.finish();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
 
-    std::cout << (res.keep ? "keep" : "drop") << "\t" << res.reason << std::endl;
+    std::cout << (res.keep ? "keep" : "drop") << "\t" << chain.describe(res) << std::endl;
     return 0;
 }
-
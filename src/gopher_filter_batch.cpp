@@ -1,73 +1,37 @@
+#include "bounded_queue.hpp"
 #include "filters.hpp"
+#include "pipeline.hpp"
+#include "stats_file.hpp"
+#include "work_stealing_pool.hpp"
 #include <zlib.h>
 
 #include <chrono>
 #include <fstream>
 #include <iostream>
 #include <sstream>
-#include <future>
 #include <thread>
 #include <memory>
-#include <deque>
 #include <atomic>
-#include <mutex>
-#include <condition_variable>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
 
 namespace {
-template <typename T>
-class BoundedQueue {
-public:
-    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
-
-    bool push(T&& item) {
-        std::unique_lock<std::mutex> lock(mu_);
-        cv_push_.wait(lock, [&] { return closed_ || queue_.size() < capacity_; });
-        if (closed_) return false;
-        queue_.push_back(std::move(item));
-        cv_pop_.notify_one();
-        return true;
-    }
-
-    bool pop(T& out) {
-        std::unique_lock<std::mutex> lock(mu_);
-        cv_pop_.wait(lock, [&] { return closed_ || !queue_.empty(); });
-        if (queue_.empty()) {
-            return false;
-        }
-        out = std::move(queue_.front());
-        queue_.pop_front();
-        cv_push_.notify_one();
-        return true;
-    }
-
-    void close() {
-        std::lock_guard<std::mutex> lock(mu_);
-        closed_ = true;
-        cv_pop_.notify_all();
-        cv_push_.notify_all();
-    }
-
-private:
-    std::mutex mu_;
-    std::condition_variable cv_push_;
-    std::condition_variable cv_pop_;
-    std::deque<T> queue_;
-    size_t capacity_;
-    bool closed_ = false;
-};
-
 struct Args {
     std::string input;
     int limit = -1;
     int threads = 1;
+    size_t batch_size = 128;
+    size_t batch_bytes = size_t{1} << 20;
+    std::string sweep;
 };
 
 Args parseArgs(int argc, char** argv) {
     Args args;
     if (argc < 2) {
-        std::cerr << "Usage: gopher_filter_batch <texts.jsonl[.gz]> [--limit N] [--threads N]\n";
+        std::cerr << "Usage: gopher_filter_batch <texts.jsonl[.gz]> [--limit N] [--threads N] [--batch-size N] [--batch-bytes N] [--sweep configs.txt]\n";
         std::exit(1);
     }
     args.input = argv[1];
@@ -77,6 +41,12 @@ Args parseArgs(int argc, char** argv) {
             args.limit = std::stoi(argv[++i]);
         } else if (arg == "--threads" && i + 1 < argc) {
             args.threads = std::stoi(argv[++i]);
+        } else if (arg == "--batch-size" && i + 1 < argc) {
+            args.batch_size = std::max<size_t>(1, static_cast<size_t>(std::stoul(argv[++i])));
+        } else if (arg == "--batch-bytes" && i + 1 < argc) {
+            args.batch_bytes = std::max<size_t>(1, static_cast<size_t>(std::stoul(argv[++i])));
+        } else if (arg == "--sweep" && i + 1 < argc) {
+            args.sweep = argv[++i];
         }
     }
     return args;
@@ -114,12 +84,27 @@ bool readLineGz(gzFile file, std::string& line) {
     }
 }
 
-std::string parseTextField(const std::string& line) {
-    const std::string key = "\"text\":\"";
-    size_t pos = line.find(key);
-    if (pos == std::string::npos) return {};
-    pos += key.size();
-    std::string out;
+// Position of the "text" value in a JSONL line, or npos.
+size_t textFieldStart(std::string_view line) {
+    constexpr std::string_view key = "\"text\":\"";
+    const size_t pos = line.find(key);
+    return pos == std::string_view::npos ? pos : pos + key.size();
+}
+
+// True if parseTextField() would return a non-empty text; lets the reader
+// count documents without decoding them.
+bool hasTextField(std::string_view line) {
+    const size_t pos = textFieldStart(line);
+    if (pos == std::string_view::npos || pos >= line.size()) return false;
+    if (line[pos] == '"') return false;
+    return line[pos] != '\\' || pos + 1 < line.size();
+}
+
+// Decodes the "text" value into out (replacing its contents).
+void parseTextField(std::string_view line, std::string& out) {
+    out.clear();
+    size_t pos = textFieldStart(line);
+    if (pos == std::string_view::npos) return;
     out.reserve(line.size() - pos);
     bool escape = false;
     for (size_t i = pos; i < line.size(); ++i) {
@@ -142,6 +127,135 @@ std::string parseTextField(const std::string& line) {
             out.push_back(c);
         }
     }
+}
+
+std::string parseTextField(const std::string& line) {
+    std::string out;
+    parseTextField(std::string_view(line), out);
+    return out;
+}
+
+// Run the filter over docs in blocks of batch_size; returns the kept count.
+size_t filterBlocks(const GopherQualityFilter& filter, std::string_view arena, Span<const DocRef> docs,
+                    size_t batch_size, std::vector<Verdict>& verdicts) {
+    size_t kept = 0;
+    for (size_t b = 0; b < docs.size(); b += batch_size) {
+        const size_t n = std::min(batch_size, docs.size() - b);
+        verdicts.assign(n, Verdict{true});
+        filter.filterBatch(arena, docs.subspan(b, n), Span<Verdict>(verdicts));
+        for (const Verdict& v : verdicts) kept += v.keep ? 1 : 0;
+    }
+    return kept;
+}
+
+struct SweepTally {
+    size_t kept = 0;
+    std::array<size_t, kDropReasonCount> drops{};
+
+    void merge(const SweepTally& other) {
+        kept += other.kept;
+        for (size_t r = 0; r < kDropReasonCount; ++r) drops[r] += other.drops[r];
+    }
+};
+
+// K threshold configurations evaluated in one pass: each document's stats
+// are computed once and every configuration is applied to them. The file
+// holds one gopher_quality/c4_quality pipeline spec per line ('#' comments,
+// blank lines skipped); all lines must agree on the settings that shape the
+// stats (stop words, unicode, C4 line rules).
+class Sweep {
+public:
+    explicit Sweep(const std::string& path) {
+        std::stringstream lines(readPipelineFile(path));
+        std::string line;
+        while (std::getline(lines, line)) {
+            const size_t hash = line.find('#');
+            if (hash != std::string::npos) line.erase(hash);
+            const size_t first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos) continue;
+            line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+            evaluators_.emplace_back(line);
+            specs_.push_back(line);
+        }
+        if (specs_.empty()) {
+            throw std::invalid_argument("sweep: no configurations in " + path);
+        }
+        bool with_c4 = false;
+        for (const std::string& spec : specs_) {
+            for (const StageSpec& stage : parsePipelineSpec(spec)) with_c4 |= stage.name == "c4_quality";
+        }
+        collector_ = std::make_unique<StatsCollector>(specs_[0], with_c4);
+        for (const std::string& spec : specs_) {
+            if (!collector_->collects(spec)) {
+                throw std::invalid_argument("sweep: '" + spec + "' changes stop_words, unicode or a C4 line rule; "
+                                            "all configurations must share them");
+            }
+        }
+    }
+
+    size_t size() const { return specs_.size(); }
+    const std::string& spec(size_t i) const { return specs_[i]; }
+
+    // Adds the verdicts of every configuration over docs to tallies (one
+    // per configuration), batch_size documents at a time.
+    void run(std::string_view arena, Span<const DocRef> docs, size_t batch_size,
+             std::vector<SweepTally>& tallies) const {
+        DocumentAnalysis doc{std::string()};
+        StatsColumns stats;
+        std::vector<Verdict> verdicts;
+        for (size_t b = 0; b < docs.size(); b += batch_size) {
+            const size_t n = std::min(batch_size, docs.size() - b);
+            stats.clear();
+            for (const DocRef& ref : docs.subspan(b, n)) {
+                doc.borrow(DocBlock::textOf(arena, ref));
+                stats.append(collector_->compute(doc));
+            }
+            for (size_t k = 0; k < evaluators_.size(); ++k) {
+                evaluators_[k].evaluate(stats, verdicts);
+                for (const Verdict& v : verdicts) {
+                    if (v.keep) {
+                        tallies[k].kept++;
+                    } else {
+                        tallies[k].drops[static_cast<size_t>(v.reason)]++;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<std::string> specs_;
+    std::vector<StatsEvaluator> evaluators_;
+    std::unique_ptr<StatsCollector> collector_;
+};
+
+// Lines a worker decodes and filters before it checks for idle workers to
+// hand half of the rest of its range to.
+constexpr size_t kStealGrain = 16;
+
+// State each worker of the --threads path keeps across blocks.
+struct alignas(64) BatchWorker {
+    DocBlock texts;
+    std::string text;
+    std::vector<Verdict> verdicts;
+    std::vector<SweepTally> tallies;
+    size_t kept = 0;
+    size_t bytes = 0;
+};
+
+std::string jsonEscape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\t') {
+            out += "\\t";
+        } else {
+            out.push_back(c);
+        }
+    }
     return out;
 }
 } // namespace
@@ -171,6 +285,16 @@ int main(int argc, char** argv) {
     }
 
     GopherQualityFilter filter;
+    std::unique_ptr<Sweep> sweep;
+    if (!args.sweep.empty()) {
+        try {
+            sweep = std::make_unique<Sweep>(args.sweep);
+        } catch (const std::invalid_argument& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    std::vector<SweepTally> tallies(sweep ? sweep->size() : 0);
 
     auto start = std::chrono::high_resolution_clock::now();
 
@@ -180,51 +304,80 @@ int main(int argc, char** argv) {
     size_t bytes = 0;
 
     if (use_parallel) {
-        std::vector<std::string> texts;
-        texts.reserve(args.limit > 0 ? static_cast<size_t>(args.limit) : 1024);
+        unsigned int hw_threads = std::thread::hardware_concurrency();
+        if (hw_threads == 0) hw_threads = 4;
+        unsigned int thread_count = args.threads > 0 ? static_cast<unsigned int>(args.threads) : hw_threads;
+        thread_count = std::max(1u, thread_count);
+
+        // Streaming: the reader only splits lines; blocks of raw lines
+        // (closed at batch_size documents or batch_bytes) go to the workers,
+        // which decode the JSON text field and filter. A few blocks per
+        // worker wait to start and emptied blocks come back through
+        // freeBlocks, so memory stays constant whatever the input size.
+        // Idle workers steal ranges of kStealGrain lines from busy ones, so
+        // a block of a few very long texts is shared out.
+        const size_t batch_size = args.batch_size;
+        const size_t batch_bytes = args.batch_bytes;
+        BoundedQueue<DocBlock> freeBlocks(thread_count * 5 + 1);
+        std::vector<BatchWorker> states(thread_count);
+        for (BatchWorker& st : states) st.tallies = tallies;
+
+        auto runLines = [&states, &filter, &sweep, batch_size](unsigned w, DocBlock& lines, size_t begin, size_t end) {
+            BatchWorker& st = states[w];
+            st.texts.clear();
+            for (size_t i = begin; i < end; ++i) {
+                parseTextField(lines.text(i), st.text);
+                st.bytes += st.text.size();
+                st.texts.add(st.text);
+            }
+            if (sweep) {
+                sweep->run(st.texts.arena(), st.texts.refs(), batch_size, st.tallies);
+            } else {
+                st.kept += filterBlocks(filter, st.texts.arena(), st.texts.refs(), batch_size, st.verdicts);
+            }
+        };
+        auto recycle = [&freeBlocks](unsigned, DocBlock& lines) {
+            lines.clear();
+            freeBlocks.tryPush(std::move(lines));
+        };
+        WorkStealingPool<DocBlock> pool(thread_count, kStealGrain, thread_count * 4, runLines, recycle);
 
         std::string line;
-        while (true) {
+        DocBlock block;
+        block.reserve(batch_size, batch_bytes);
+        bool open = true;
+        while (open) {
             bool ok = use_gz ? readLineGz(gz, line) : readLine(fin, line);
             if (!ok) break;
-            if (args.limit != -1 && static_cast<int>(texts.size()) >= args.limit) break;
-            if (line.empty()) continue;
-            std::string text = parseTextField(line);
-            if (text.empty()) continue;
-
-            bytes += text.size();
-            texts.emplace_back(std::move(text));
-        }
-
-        docs = texts.size();
+            if (args.limit != -1 && static_cast<int>(docs) >= args.limit) break;
+            if (line.empty() || !hasTextField(line)) continue;
 
-        unsigned int hw_threads = std::thread::hardware_concurrency();
-        if (hw_threads == 0) hw_threads = 4;
-        unsigned int thread_count = args.threads > 0 ? static_cast<unsigned int>(args.threads) : hw_threads;
-        thread_count = std::max(1u, std::min<unsigned int>(thread_count, static_cast<unsigned int>(docs == 0 ? 1 : docs)));
-
-        const size_t chunk = (docs + thread_count - 1) / thread_count;
-        std::vector<std::future<size_t>> futures;
-        futures.reserve(thread_count);
-
-        for (unsigned int t = 0; t < thread_count; ++t) {
-            const size_t start_idx = t * chunk;
-            if (start_idx >= docs) break;
-            const size_t end_idx = std::min(docs, start_idx + chunk);
-            futures.emplace_back(std::async(std::launch::async, [start_idx, end_idx, &texts, &filter]() -> size_t {
-                size_t kept_local = 0;
-                for (size_t i = start_idx; i < end_idx; ++i) {
-                    if (filter.filter(texts[i]).keep) kept_local++;
+            block.add(line);
+            docs++;
+            if (block.size() >= batch_size || block.bytes() >= batch_bytes) {
+                const size_t n = block.size();
+                open = pool.submit(std::move(block), n);
+                if (!freeBlocks.tryPop(block)) {
+                    block = DocBlock();
+                    block.reserve(batch_size, batch_bytes);
                 }
-                return kept_local;
-            }));
+            }
+        }
+        if (open && !block.empty()) {
+            const size_t n = block.size();
+            pool.submit(std::move(block), n);
         }
+        pool.close();
 
-        for (auto& f : futures) {
-            kept += f.get();
+        for (const BatchWorker& st : states) {
+            bytes += st.bytes;
+            kept += st.kept;
+            for (size_t k = 0; k < tallies.size(); ++k) tallies[k].merge(st.tallies[k]);
         }
     } else {
         std::string line;
+        DocBlock block;
+        std::vector<Verdict> verdicts;
         while (true) {
             bool ok = use_gz ? readLineGz(gz, line) : readLine(fin, line);
             if (!ok) break;
@@ -234,9 +387,21 @@ int main(int argc, char** argv) {
             if (text.empty()) continue;
 
             bytes += text.size();
-            FilterResult res = filter.filter(text);
-            if (res.keep) kept++;
+            block.add(text);
             docs++;
+            if (block.size() >= args.batch_size) {
+                if (sweep) {
+                    sweep->run(block.arena(), block.refs(), args.batch_size, tallies);
+                } else {
+                    kept += filterBlocks(filter, block.arena(), block.refs(), args.batch_size, verdicts);
+                }
+                block.clear();
+            }
+        }
+        if (sweep) {
+            sweep->run(block.arena(), block.refs(), args.batch_size, tallies);
+        } else {
+            kept += filterBlocks(filter, block.arena(), block.refs(), args.batch_size, verdicts);
         }
     }
 
@@ -249,9 +414,33 @@ int main(int argc, char** argv) {
     double docs_sec = secs > 0 ? static_cast<double>(docs) / secs : 0.0;
     double mb_sec = secs > 0 ? (bytes / 1024.0 / 1024.0) / secs : 0.0;
 
+    if (sweep) {
+        std::cout << "{"
+                  << "\"docs\":" << docs << ","
+                  << "\"elapsed_sec\":" << secs << ","
+                  << "\"docs_sec\":" << docs_sec << ","
+                  << "\"mb_sec\":" << mb_sec << ","
+                  << "\"configs\":[";
+        for (size_t k = 0; k < tallies.size(); ++k) {
+            std::cout << (k ? "," : "") << "\n{\"spec\":\"" << jsonEscape(sweep->spec(k)) << "\","
+                      << "\"kept\":" << tallies[k].kept << ","
+                      << "\"drop_reasons\":{";
+            bool first = true;
+            for (size_t r = 0; r < kDropReasonCount; ++r) {
+                if (tallies[k].drops[r] == 0) continue;
+                std::cout << (first ? "" : ",") << "\"" << formatDropReason(static_cast<DropReason>(r))
+                          << "\":" << tallies[k].drops[r];
+                first = false;
+            }
+            std::cout << "}}";
+        }
+        std::cout << "\n]}\n";
+        return 0;
+    }
+
     std::cout << "{"
-              << "\"docs\":" << docs_count << ","
-              << "\"kept\":" << kept_count << ","
+              << "\"docs\":" << docs << ","
+              << "\"kept\":" << kept << ","
               << "\"elapsed_sec\":" << secs << ","
               << "\"docs_sec\":" << docs_sec << ","
               << "\"mb_sec\":" << mb_sec
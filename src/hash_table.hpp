@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Open-addressing table of hashed elements with occurrence counts, meant to
+// be kept per thread and reused across documents: reset() is O(1) unless the
+// table has to grow, because slots are tagged with a generation instead of
+// being cleared.
+//
+// Keys are 64-bit hashes. Callers that need exact answers pass an equality
+// callback comparing the element at an existing slot's first index with the
+// element being inserted; colliding but different elements then simply probe
+// on to another slot.
+class HashCountTable {
+public:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t count = 0;
+        uint32_t first = 0; // caller-defined index of the first occurrence
+        uint32_t gen = 0;
+    };
+
+    // Prepare for up to `expected` distinct elements.
+    void reset(size_t expected) {
+        size_t want = 16;
+        while (want < expected * 2) want <<= 1;
+        if (want > slots_.size()) {
+            slots_.assign(want, Slot{});
+            gen_ = 0;
+        }
+        mask_ = slots_.size() - 1;
+        if (++gen_ == 0) {
+            // Generation wrapped; clear tags for real once every 2^32 resets.
+            for (Slot& s : slots_) s.gen = 0;
+            gen_ = 1;
+        }
+        size_ = 0;
+    }
+
+    // Find the element, or insert it with count 0 and first = index.
+    // `inserted` tells which happened. The count is not touched.
+    template <typename Eq>
+    Slot& findOrInsert(uint64_t hash, uint32_t index, Eq&& eq, bool& inserted) {
+        size_t pos = static_cast<size_t>(hash) & mask_;
+        while (true) {
+            Slot& s = slots_[pos];
+            if (s.gen != gen_) {
+                s.hash = hash;
+                s.count = 0;
+                s.first = index;
+                s.gen = gen_;
+                size_++;
+                inserted = true;
+                return s;
+            }
+            if (s.hash == hash && eq(s.first)) {
+                inserted = false;
+                return s;
+            }
+            pos = (pos + 1) & mask_;
+        }
+    }
+
+    size_t size() const { return size_; }
+
+    // Visit every occupied slot of the current generation.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const Slot& s : slots_) {
+            if (s.gen == gen_) fn(s);
+        }
+    }
+
+private:
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+    uint32_t gen_ = 0;
+};
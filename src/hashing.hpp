@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Fast non-cryptographic hashing for dedup-style lookups (not for anything
+// adversarial).
+namespace Hashing {
+
+constexpr uint64_t kMul0 = 0x9E3779B97F4A7C15ULL;
+constexpr uint64_t kMul1 = 0xBF58476D1CE4E5B9ULL;
+constexpr uint64_t kMul2 = 0x94D049BB133111EBULL;
+
+// splitmix64 finalizer: full avalanche of a 64-bit value.
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= kMul1;
+    x ^= x >> 27;
+    x *= kMul2;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint64_t load64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Tail of 1..7 bytes packed into one word.
+inline uint64_t loadTail(const unsigned char* p, size_t len) {
+    uint64_t v = 0;
+    std::memcpy(&v, p, len);
+    return v;
+}
+
+inline uint64_t hashBytes(const void* data, size_t len, uint64_t seed = 0) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (static_cast<uint64_t>(len) * kMul0);
+    while (len >= 8) {
+        h = (h ^ mix64(load64(p))) * kMul0;
+        h ^= h >> 29;
+        p += 8;
+        len -= 8;
+    }
+    if (len > 0) {
+        h = (h ^ mix64(loadTail(p, len))) * kMul0;
+    }
+    return mix64(h);
+}
+
+inline uint64_t hashBytes(std::string_view s, uint64_t seed = 0) {
+    return hashBytes(s.data(), s.size(), seed);
+}
+
+} // namespace Hashing
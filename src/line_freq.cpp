@@ -0,0 +1,144 @@
+#include "line_freq.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[8] = {'W', 'S', 'L', 'I', 'N', 'E', 'C', 'M'};
+
+template <typename T>
+void writePod(std::ofstream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+bool readPod(std::ifstream& in, T& v) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+} // namespace
+
+bool lineKey(std::string_view line, std::string& scratch, Hash128& key) {
+    scratch.clear();
+    bool pending_space = false;
+    for (char c : line) {
+        const unsigned char u = static_cast<unsigned char>(c);
+        if (std::isspace(u)) {
+            pending_space = !scratch.empty();
+            continue;
+        }
+        if (u < 0x80 && std::ispunct(u)) continue;
+        if (pending_space) scratch.push_back(' ');
+        pending_space = false;
+        scratch.push_back(std::isdigit(u) ? '0' : static_cast<char>(std::tolower(u)));
+    }
+    if (scratch.empty()) return false;
+    key = hash128(scratch);
+    return true;
+}
+
+LineFrequencySketch::LineFrequencySketch(uint32_t width_log2) : width_log2_(width_log2) {
+    if (width_log2 < 4 || width_log2 > 32) {
+        throw std::invalid_argument("line counts: width must be between 2^4 and 2^32");
+    }
+    counters_.assign(static_cast<size_t>(kDepth) << width_log2, 0);
+}
+
+size_t LineFrequencySketch::slot(uint32_t row, const Hash128& key) const {
+    // Row r uses lo + r * hi (double hashing), top width_log2 bits.
+    const uint64_t h = key.lo + row * (key.hi | 1);
+    return (static_cast<size_t>(row) << width_log2_) + static_cast<size_t>(h >> (64 - width_log2_));
+}
+
+void LineFrequencySketch::addDocument(const DocumentAnalysis& doc) {
+    thread_local std::string scratch;
+    thread_local std::vector<Hash128> keys;
+
+    keys.clear();
+    for (const TextSpan& line : doc.lines()) {
+        Hash128 key;
+        if (lineKey(doc.view(line), scratch, key)) keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end(), [](const Hash128& a, const Hash128& b) {
+        return a.lo != b.lo ? a.lo < b.lo : a.hi < b.hi;
+    });
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    for (const Hash128& key : keys) {
+        for (uint32_t r = 0; r < kDepth; ++r) __atomic_fetch_add(&counters_[slot(r, key)], 1u, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&documents_, uint64_t{1}, __ATOMIC_RELAXED);
+}
+
+uint32_t LineFrequencySketch::estimate(const Hash128& key) const {
+    uint32_t est = UINT32_MAX;
+    for (uint32_t r = 0; r < kDepth; ++r) est = std::min(est, counters_[slot(r, key)]);
+    return est;
+}
+
+void LineFrequencySketch::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) throw std::runtime_error("line counts: could not open " + path + " for writing");
+    out.write(kMagic, sizeof(kMagic));
+    writePod(out, kDepth);
+    writePod(out, width_log2_);
+    writePod(out, documents_);
+    out.write(reinterpret_cast<const char*>(counters_.data()),
+              static_cast<std::streamsize>(counters_.size() * sizeof(uint32_t)));
+    out.close();
+    if (!out) throw std::runtime_error("line counts: write to " + path + " failed");
+}
+
+LineFrequencySketch LineFrequencySketch::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) throw std::runtime_error("line counts: could not open " + path);
+    char magic[sizeof(kMagic)];
+    uint32_t depth = 0;
+    uint32_t width_log2 = 0;
+    uint64_t documents = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !readPod(in, depth) || !readPod(in, width_log2) || !readPod(in, documents) ||
+        depth != kDepth || width_log2 < 4 || width_log2 > 32) {
+        throw std::runtime_error("line counts: " + path + " is not a line count file");
+    }
+    LineFrequencySketch sketch(width_log2);
+    sketch.documents_ = documents;
+    if (!in.read(reinterpret_cast<char*>(sketch.counters_.data()),
+                 static_cast<std::streamsize>(sketch.counters_.size() * sizeof(uint32_t)))) {
+        throw std::runtime_error("line counts: " + path + " is truncated");
+    }
+    return sketch;
+}
+
+LineFrequencyFilter::LineFrequencyFilter(const LineFrequencyConfig& config) : config_(config) {
+    if (config.path.empty()) throw std::invalid_argument("line_freq_strip: path is required");
+    sketch_ = std::make_shared<const LineFrequencySketch>(LineFrequencySketch::load(config.path));
+}
+
+FilterResult LineFrequencyFilter::filter(DocumentAnalysis& doc) const {
+    thread_local std::string scratch;
+    const std::vector<TextSpan>& lines = doc.lines();
+    const uint32_t max_count = static_cast<uint32_t>(std::max(config_.max_count, 0));
+
+    std::string kept;
+    bool stripped = false;
+    bool first = true;
+    for (const TextSpan& line : lines) {
+        Hash128 key;
+        if (lineKey(doc.view(line), scratch, key) && sketch_->estimate(key) > max_count) {
+            stripped = true;
+            continue;
+        }
+        if (!first) kept.push_back('\n');
+        kept.append(doc.view(line));
+        first = false;
+    }
+    if (!stripped) return {true};
+    if (kept.empty()) return {false, DropReason::Boilerplate};
+    if (doc.endsWithNewline()) kept.push_back('\n');
+    doc.reset(std::move(kept));
+    return {true};
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "dedup.hpp"
+#include "document.hpp"
+#include "filters.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Corpus-wide line frequencies for boilerplate removal (CCNet-style).
+//
+// Pass one (websift --line-counts-output) counts, for every normalized line,
+// the number of documents containing it in a count-min sketch. Pass two
+// (the line_freq_strip stage) removes lines whose estimated count is above
+// a threshold, typically before c4_quality.
+//
+// Line normalization: ASCII lower-case, digits to '0', ASCII punctuation
+// removed, whitespace runs collapsed, trimmed. Lines that normalize to
+// nothing are never counted or stripped.
+
+// Hash of the normalized line; false if it normalizes to nothing.
+bool lineKey(std::string_view line, std::string& scratch, Hash128& key);
+
+// Count-min sketch of document frequencies. Counters are updated with
+// atomic adds, so workers share one sketch. Estimates never undercount;
+// they overcount by at most about e * documents / width with
+// probability 1 - e^-depth. File: the magic "WSLINECM", uint32 depth,
+// uint32 log2 width, uint64 documents, then the counters as uint32 rows
+// (host byte order); I/O errors throw std::runtime_error.
+class LineFrequencySketch {
+public:
+    static constexpr uint32_t kDefaultWidthLog2 = 22; // 4M counters per row
+    static constexpr uint32_t kDepth = 4;
+
+    explicit LineFrequencySketch(uint32_t width_log2 = kDefaultWidthLog2);
+    static LineFrequencySketch load(const std::string& path);
+    void save(const std::string& path) const;
+
+    // Count each distinct line of the document once.
+    void addDocument(const DocumentAnalysis& doc);
+    uint32_t estimate(const Hash128& key) const;
+    uint64_t documents() const { return documents_; }
+
+private:
+    uint32_t width_log2_;
+    std::vector<uint32_t> counters_; // kDepth rows
+    uint64_t documents_ = 0;
+
+    size_t slot(uint32_t row, const Hash128& key) const;
+};
+
+struct LineFrequencyConfig {
+    std::string path;   // sketch written by pass one
+    int max_count = 10; // strip lines found in more documents than this
+};
+
+// Pipeline stage (rewrites the text): removes frequent lines; a document
+// left with no text drops as "boilerplate". Copies share the loaded sketch.
+class LineFrequencyFilter {
+public:
+    explicit LineFrequencyFilter(const LineFrequencyConfig& config);
+    FilterResult filter(DocumentAnalysis& doc) const;
+
+private:
+    LineFrequencyConfig config_;
+    std::shared_ptr<const LineFrequencySketch> sketch_;
+};
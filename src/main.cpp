@@ -1,5 +1,15 @@
 #include "warc.hpp"
 #include "filters.hpp"
+#include "doc_block.hpp"
+#include "filter_chain.hpp"
+#include "line_freq.hpp"
+#include "minhash.hpp"
+#include "numa.hpp"
+#include "pipeline.hpp"
+#include "shard_lease.hpp"
+#include "stage_graph.hpp"
+#include "stats_file.hpp"
+#include "url_filter.hpp"
 #include "utils.hpp"
 #include <iostream>
 #include <chrono>
@@ -8,10 +18,16 @@
 #include <fstream>
 #include <string>
 #include <thread>
+#include <vector>
 #include <atomic>
-#include <deque>
 #include <mutex>
+#include <memory>
+#include <cstdlib>
+#include <functional>
 #include <condition_variable>
+#include <cstdio>
+
+#include <unistd.h>
 
 void downloadBadWords() {
     std::ifstream f("badwords_en.txt");
@@ -26,17 +42,38 @@ void downloadBadWords() {
 }
 
 struct Args {
-    std::string input_file;
+    std::vector<std::string> input_files;
     std::string csv_output_file;
     int limit = -1;
     int threads = 1;
+    bool auto_tune = false;  // --threads auto
+    int max_threads = 0;     // upper bound for --threads auto; 0 = hardware threads
+    size_t memory_budget = 0; // bytes of input in flight; 0 = no limit
     size_t queue_depth = 1024;
+    size_t batch_size = 128;
+    size_t batch_bytes = size_t{1} << 20;
+    bool numa = false;
+    bool adaptive_order = false;
+    size_t adaptive_window = 1024;
+    std::string pipeline;
+    std::string pipeline_file;
+    std::string stats_output;
+    std::string line_counts_output;
+    uint32_t line_counts_width = LineFrequencySketch::kDefaultWidthLog2;
+    std::string signatures_output;
+    std::string url_filter;
+    bool url_filter_update = false;
+    uint64_t url_filter_capacity = UrlBloomFilter::kDefaultCapacity;
+    // Coordinator mode: claim shards of a manifest through lease files in
+    // a shared work directory (see ShardLeases).
+    std::string manifest;
+    std::string work_dir;
+    double lease_timeout = 60;
+    std::string worker_id; // default: host:pid
 };
 
 Args parseArgs(int argc, char** argv) {
     Args args;
-    // Defaults
-    args.input_file = "CC-MAIN-20251119093413-20251119123413-00999.warc.gz";
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -45,269 +82,590 @@ Args parseArgs(int argc, char** argv) {
         } else if (arg == "--limit" && i + 1 < argc) {
             args.limit = std::stoi(argv[++i]);
         } else if (arg == "--threads" && i + 1 < argc) {
-            args.threads = std::stoi(argv[++i]);
+            const std::string value = argv[++i];
+            args.auto_tune = value == "auto";
+            args.threads = args.auto_tune ? 0 : std::stoi(value);
+        } else if (arg == "--max-threads" && i + 1 < argc) {
+            args.max_threads = std::stoi(argv[++i]);
+        } else if (arg == "--memory-budget" && i + 1 < argc) {
+            args.memory_budget = static_cast<size_t>(std::stoull(argv[++i]));
         } else if (arg == "--queue-depth" && i + 1 < argc) {
             args.queue_depth = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--batch-size" && i + 1 < argc) {
+            args.batch_size = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--batch-bytes" && i + 1 < argc) {
+            args.batch_bytes = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--numa") {
+            args.numa = true;
+        } else if (arg == "--adaptive-order") {
+            args.adaptive_order = true;
+        } else if (arg == "--adaptive-window" && i + 1 < argc) {
+            args.adaptive_window = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--pipeline" && i + 1 < argc) {
+            args.pipeline = argv[++i];
+        } else if (arg == "--pipeline-file" && i + 1 < argc) {
+            args.pipeline_file = argv[++i];
+        } else if (arg == "--stats-output" && i + 1 < argc) {
+            args.stats_output = argv[++i];
+        } else if (arg == "--line-counts-output" && i + 1 < argc) {
+            args.line_counts_output = argv[++i];
+        } else if (arg == "--line-counts-width" && i + 1 < argc) {
+            args.line_counts_width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--signatures-output" && i + 1 < argc) {
+            args.signatures_output = argv[++i];
+        } else if (arg == "--url-filter" && i + 1 < argc) {
+            args.url_filter = argv[++i];
+        } else if (arg == "--url-filter-update") {
+            args.url_filter_update = true;
+        } else if (arg == "--url-filter-capacity" && i + 1 < argc) {
+            args.url_filter_capacity = std::stoull(argv[++i]);
+        } else if (arg == "--manifest" && i + 1 < argc) {
+            args.manifest = argv[++i];
+        } else if (arg == "--work-dir" && i + 1 < argc) {
+            args.work_dir = argv[++i];
+        } else if (arg == "--lease-timeout" && i + 1 < argc) {
+            args.lease_timeout = std::stod(argv[++i]);
+        } else if (arg == "--worker-id" && i + 1 < argc) {
+            args.worker_id = argv[++i];
         } else if (arg[0] != '-') {
-            args.input_file = arg;
+            args.input_files.push_back(arg);
         }
     }
+    if (args.input_files.empty() && args.manifest.empty()) {
+        args.input_files.push_back("CC-MAIN-20251119093413-20251119123413-00999.warc.gz");
+    }
     return args;
 }
 
-template <typename T>
-class BoundedQueue {
-public:
-    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
-
-    bool push(T&& item) {
-        std::unique_lock<std::mutex> lock(mu_);
-        cv_push_.wait(lock, [&] { return closed_ || queue_.size() < capacity_; });
-        if (closed_) return false;
-        queue_.push_back(std::move(item));
-        cv_pop_.notify_one();
-        return true;
-    }
-
-    bool pop(T& out) {
-        std::unique_lock<std::mutex> lock(mu_);
-        cv_pop_.wait(lock, [&] { return closed_ || !queue_.empty(); });
-        if (queue_.empty()) return false;
-        out = std::move(queue_.front());
-        queue_.pop_front();
-        cv_push_.notify_one();
-        return true;
+// Reason column of the CSV output; empty for kept documents.
+std::string csvReason(const FilterChain& chain, const FilterResult& res) {
+    if (res.keep) return "";
+    std::string reason = chain.describe(res);
+    if (reason.find(',') != std::string::npos) {
+        reason = "\"" + reason + "\"";
     }
+    return reason;
+}
 
-    void close() {
-        std::lock_guard<std::mutex> lock(mu_);
-        closed_ = true;
-        cv_pop_.notify_all();
-        cv_push_.notify_all();
+// A block of records on its way through the stages. skipped holds the
+// records the reader dropped itself (seen URLs) as (index of the document
+// they precede, id), so their rows keep their place in the output.
+struct WorkBlock {
+    DocBlock docs;
+    std::vector<std::pair<size_t, std::string>> skipped;
+    std::vector<FilterResult> results; // one per document, for the CSV
+
+    bool empty() const { return docs.empty() && skipped.empty(); }
+    void clear() {
+        docs.clear();
+        skipped.clear();
+        results.clear();
     }
-
-private:
-    std::mutex mu_;
-    std::condition_variable cv_push_;
-    std::condition_variable cv_pop_;
-    std::deque<T> queue_;
-    size_t capacity_;
-    bool closed_ = false;
 };
 
-struct WorkItem {
-    std::string id;
-    std::string content;
+using SiftGraph = StageGraph<WorkBlock>;
+
+// Documents a worker runs before it checks for idle workers to hand half
+// of the rest of its range to.
+constexpr size_t kStealGrain = 4;
+
+// --threads auto: how often the tuner decides, how often it samples the
+// in-flight bytes in between, and the budget used without --memory-budget.
+constexpr auto kTuneInterval = std::chrono::milliseconds(250);
+constexpr int kTuneSamples = 10;
+constexpr size_t kDefaultMemoryBudget = size_t{256} << 20;
+
+// State each filter worker keeps across blocks.
+struct alignas(64) WorkerState {
+    FilterChain chain;
+    DocumentAnalysis doc;
+    std::string text; // extraction buffer, reused across documents
+    DropCounters drops;
+    StatsColumns statsRows;
+    std::string sigRecords;
+    std::vector<uint32_t> sig;
+    uint64_t extractNs = 0;
 };
 
-int main(int argc, char** argv) {
-    std::ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
-
-    Args args = parseArgs(argc, argv);
-
-    downloadBadWords();
-
-    WarcReader reader(args.input_file);
-    C4QualityFilter qualityFilter;
-    C4ParagraphFilter paragraphFilter;
-    C4BadWordsFilter badWordsFilter;
-
+// What the stages of one run share. main() fills it from the arguments;
+// the optional outputs are null when not requested.
+struct SiftContext {
+    explicit SiftContext(const Args& a) : args(a) {}
+
+    const Args& args;
+    FilterChain chain; // built once; every filter worker gets its own copy
+    // Stats-only mode: no filtering, one row of filter statistics per document.
+    std::unique_ptr<StatsCollector> statsCollector;
+    std::unique_ptr<StatsWriter> statsWriter;
+    std::mutex statsMu;
+    // Line-count mode (pass one of line_freq_strip): no filtering, every
+    // document's distinct lines are counted into a shared sketch.
+    std::unique_ptr<LineFrequencySketch> lineCounts;
+    // MinHash signatures of kept documents, with the minhash_dedup stage's
+    // settings if the pipeline has one.
+    std::unique_ptr<MinHasher> sigHasher;
+    std::unique_ptr<SignatureWriter> sigWriter;
+    std::mutex sigMu;
+    // Records whose URL an earlier run (or this one, when updating) already
+    // processed are skipped before extraction.
+    std::unique_ptr<UrlBloomFilter> urlFilter;
     std::ofstream csvOut;
-    if (!args.csv_output_file.empty()) {
-        csvOut.open(args.csv_output_file);
-        if (csvOut.is_open()) {
-            csvOut << "record_id,status,reason\n";
-        } else {
-            std::cerr << "Error: Could not open CSV output file " << args.csv_output_file << std::endl;
-        }
-    }
 
+    std::vector<WorkerState> workers;
+    std::atomic<size_t> produced{0}; // response records taken, for --limit
     std::atomic<size_t> totalDocs{0};
     std::atomic<size_t> keptDocs{0};
     std::atomic<size_t> droppedDocs{0};
     std::atomic<size_t> totalBytes{0};
-    std::map<std::string, size_t> dropReasons;
-    std::mutex dropMu;
-    std::mutex csvMu;
 
-    auto startTime = std::chrono::high_resolution_clock::now();
-
-    const bool use_parallel = args.threads != 1;
-    if (use_parallel) {
-        unsigned int hw_threads = std::thread::hardware_concurrency();
-        if (hw_threads == 0) hw_threads = 4;
-        unsigned int thread_count = args.threads > 0 ? static_cast<unsigned int>(args.threads) : hw_threads;
-        thread_count = std::max(1u, thread_count);
-
-        BoundedQueue<WorkItem> queue(args.queue_depth ? args.queue_depth : 1024);
-        std::vector<std::thread> workers;
-        workers.reserve(thread_count);
-
-        for (unsigned int t = 0; t < thread_count; ++t) {
-            workers.emplace_back([&queue, &csvOut, &csvMu, &dropReasons, &dropMu, &totalDocs, &keptDocs, &droppedDocs, &totalBytes]() {
-                C4QualityFilter qf;
-                C4ParagraphFilter pf;
-                C4BadWordsFilter bf;
-                std::string status;
-                std::string reason;
-
-                WorkItem item;
-                while (queue.pop(item)) {
-                    status = "kept";
-                    reason.clear();
-
-                    bool drop = false;
-                    if (item.content.empty()) {
-                        drop = true;
-                        reason = "empty_text";
-                    }
-
-                    if (!drop) {
-                        FilterResult res = qf.filter(item.content);
-                        if (!res.keep) {
-                            drop = true;
-                            reason = res.reason;
-                        }
-                    }
+    bool filtering() const { return !statsCollector && !lineCounts; }
 
-                    if (!drop) {
-                        FilterResult res = pf.filter(item.content);
-                        if (!res.keep) {
-                            drop = true;
-                            reason = res.reason;
-                        }
-                    }
+    bool seenUrl(const std::string& url) {
+        if (!urlFilter) return false;
+        const std::string key = normalizeUrl(url);
+        return args.url_filter_update ? urlFilter->insert(key) : urlFilter->contains(key);
+    }
+};
 
-                    if (!drop) {
-                        FilterResult res = bf.filter(item.content);
-                        if (!res.keep) {
-                            drop = true;
-                            reason = res.reason;
-                        }
-                    }
+// Source: reads response records with `next` into blocks of at most
+// batch_size documents or batch_bytes of payload and emits them, dealt to
+// every lane in turn when `deal` is set. Seen URLs are dropped here.
+// With `nodes` (one per lane) the reader moves to each lane's node before
+// filling its block, so the block's buffers are allocated and first
+// touched on the node whose workers use them; the move costs one affinity
+// call per block.
+void readRecords(SiftGraph::Source& source, SiftContext& ctx, const std::function<bool(WarcRecord&)>& next,
+                 DropCounters& skipped, bool deal, unsigned lanes, const std::vector<NumaNode>* nodes = nullptr) {
+    const Args& args = ctx.args;
+    const size_t batch_size = std::max<size_t>(1, args.batch_size);
+    const size_t batch_bytes = std::max<size_t>(1, args.batch_bytes);
+    unsigned lane = 0;
+    if (deal && nodes) pinThread((*nodes)[lane].cpus);
+    auto emit = [&]() {
+        WorkBlock& block = source.block();
+        block.results.resize(block.docs.size());
+        source.emit(block.docs.size(), block.docs.bytes());
+        if (!deal) return;
+        lane = (lane + 1) % lanes;
+        if (nodes) pinThread((*nodes)[lane].cpus);
+        source.setLane(lane);
+    };
+    WarcRecord record;
+    while (next(record)) {
+        if (record.type != "response") continue;
+        if (args.limit != -1 && static_cast<int>(ctx.produced.fetch_add(1, std::memory_order_relaxed)) >= args.limit) break;
+        WorkBlock& block = source.block();
+        if (block.docs.size() == 0 && block.skipped.empty()) block.docs.reserve(batch_size, batch_bytes);
+        if (ctx.seenUrl(record.url)) {
+            skipped.add(FilterResult{false, DropReason::SeenUrl});
+            ctx.totalDocs++;
+            ctx.droppedDocs++;
+            if (ctx.csvOut.is_open()) block.skipped.emplace_back(block.docs.size(), record.id);
+        } else {
+            block.docs.add(record.content, record.id);
+        }
+        if (block.docs.size() >= batch_size || block.docs.bytes() >= batch_bytes || block.skipped.size() >= batch_size) {
+            emit();
+        }
+    }
+    if (!source.block().empty()) emit();
+}
 
-                    totalDocs.fetch_add(1, std::memory_order_relaxed);
-                    totalBytes.fetch_add(item.content.size(), std::memory_order_relaxed);
-
-                    if (drop) {
-                        droppedDocs.fetch_add(1, std::memory_order_relaxed);
-                        status = "dropped";
-                        {
-                            std::lock_guard<std::mutex> lk(dropMu);
-                            dropReasons[reason]++;
-                        }
-                    } else {
-                        keptDocs.fetch_add(1, std::memory_order_relaxed);
-                    }
+// Stage "filter": HTTP parsing, text extraction and the filter chain (or,
+// in stats / line-count mode, the statistics) for each document.
+size_t addFilterStage(SiftGraph& graph, SiftContext& ctx, SiftGraph::StageOptions options) {
+    return graph.addStage("filter", std::move(options), [&ctx](unsigned w, WorkBlock& work, size_t begin, size_t end) {
+        WorkerState& st = ctx.workers[w];
+        const DocBlock& block = work.docs;
+        size_t kept = 0;
+        size_t bytes = 0;
+        auto extract = [&](size_t i) {
+            const auto start = std::chrono::steady_clock::now();
+            Utils::extractText(Utils::httpBody(block.text(i)), st.text);
+            st.doc.assign(st.text);
+            st.extractNs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        };
+        if (!ctx.filtering()) {
+            st.statsRows.clear();
+            for (size_t i = begin; i < end; ++i) {
+                extract(i);
+                if (ctx.statsCollector) st.statsRows.append(ctx.statsCollector->compute(st.doc));
+                if (ctx.lineCounts) ctx.lineCounts->addDocument(st.doc);
+                bytes += st.doc.size();
+            }
+            ctx.totalDocs.fetch_add(end - begin, std::memory_order_relaxed);
+            ctx.totalBytes.fetch_add(bytes, std::memory_order_relaxed);
+            if (ctx.statsCollector) {
+                std::lock_guard<std::mutex> lk(ctx.statsMu);
+                ctx.statsWriter->append(st.statsRows);
+            }
+            return;
+        }
+        st.sigRecords.clear();
+        for (size_t i = begin; i < end; ++i) {
+            if (i + 1 < end) prefetchText(block.text(i + 1));
+            extract(i);
+
+            FilterResult res{false, DropReason::EmptyText};
+            if (!st.doc.empty()) {
+                res = st.chain.run(st.doc);
+            }
 
-                    if (csvOut.is_open()) {
-                        std::lock_guard<std::mutex> lk(csvMu);
-                        std::string safeReason = reason;
-                        if (safeReason.find(',') != std::string::npos) {
-                            safeReason = "\"" + safeReason + "\"";
-                        }
-                        csvOut << item.id << "," << status << "," << safeReason << "\n";
-                    }
+            bytes += st.doc.size();
+            if (res.keep) {
+                kept++;
+                if (ctx.sigWriter) {
+                    ctx.sigHasher->signature(st.doc, st.sig);
+                    SignatureWriter::encode(st.sigRecords, block.id(i), st.sig);
                 }
-            });
+            } else {
+                st.drops.add(res);
+            }
+            work.results[i] = res;
         }
 
-        size_t produced = 0;
-        WarcRecord record;
-        while (reader.nextRecord(record)) {
-            if (record.type != "response") continue;
-            if (args.limit != -1 && static_cast<int>(produced) >= args.limit) break;
-            produced++;
-            WorkItem item;
-            item.id = record.id;
-            {
-                std::string body = Utils::extractHttpBody(record.content);
-                item.content = Utils::extractText(body);
-            }
-            if (!queue.push(std::move(item))) break;
+        ctx.totalDocs.fetch_add(end - begin, std::memory_order_relaxed);
+        ctx.totalBytes.fetch_add(bytes, std::memory_order_relaxed);
+        ctx.keptDocs.fetch_add(kept, std::memory_order_relaxed);
+        ctx.droppedDocs.fetch_add(end - begin - kept, std::memory_order_relaxed);
+        if (ctx.sigWriter && kept > 0) {
+            std::lock_guard<std::mutex> lk(ctx.sigMu);
+            ctx.sigWriter->append(st.sigRecords, kept);
         }
-        queue.close();
-        for (auto& w : workers) w.join();
-    } else {
-        WarcRecord record;
-        while (reader.nextRecord(record)) {
-            if (args.limit != -1 && (int)totalDocs.load(std::memory_order_relaxed) >= args.limit) break;
+    });
+}
 
-            if (record.type != "response") continue;
-            
-            std::string text;
-            {
-                Utils::ScopedTimer t("Extraction");
-                std::string body = Utils::extractHttpBody(record.content);
-                text = Utils::extractText(body);
+// Stage "csv": one row per record, in input order (the stage is ordered),
+// with the reader's seen_url rows in their place. The rows are the same at
+// every thread count unless the pipeline dedups: workers share the dedup
+// sets, so which copy of a duplicate is kept depends on which worker gets
+// there first (exact_dedup keeps one per group either way; minhash_dedup
+// may keep a different number, its matches not being transitive).
+size_t addCsvStage(SiftGraph& graph, SiftContext& ctx, unsigned threads) {
+    SiftGraph::StageOptions options;
+    options.threads = threads;
+    options.ordered = true;
+    auto rows = std::make_shared<std::string>();
+    return graph.addStage("csv", options, [&ctx, rows](unsigned, WorkBlock& work, size_t, size_t) {
+        const FilterChain& chain = ctx.chain;
+        const std::string seenUrlReason = csvReason(chain, FilterResult{false, DropReason::SeenUrl});
+        std::string& out = *rows;
+        out.clear();
+        size_t nextSkipped = 0;
+        for (size_t i = 0; i <= work.docs.size(); ++i) {
+            for (; nextSkipped < work.skipped.size() && work.skipped[nextSkipped].first == i; ++nextSkipped) {
+                out += work.skipped[nextSkipped].second;
+                out += ",dropped,";
+                out += seenUrlReason;
+                out += '\n';
             }
+            if (i == work.docs.size() || !ctx.filtering()) continue;
+            const FilterResult& res = work.results[i];
+            out += work.docs.id(i);
+            out += res.keep ? ",kept," : ",dropped,";
+            out += csvReason(chain, res);
+            out += '\n';
+        }
+        ctx.csvOut.write(out.data(), static_cast<std::streamsize>(out.size()));
+    });
+}
 
-            std::string status = "kept";
-            std::string reason = "";
-
-            bool drop = false;
+// The stages after "read", in order; returns the filter stage's index (the
+// one --threads auto tunes). New stages go here.
+size_t addStages(SiftGraph& graph, SiftContext& ctx, const SiftGraph::StageOptions& workers, bool serial) {
+    const size_t filter = addFilterStage(graph, ctx, workers);
+    if (ctx.csvOut.is_open()) addCsvStage(graph, ctx, serial ? 0 : 1);
+    return filter;
+}
 
-            if (text.empty()) {
-                drop = true;
-                reason = "empty_text";
-            }
+// Counts of one run, for the coordinator's per-shard stats.
+struct SiftTotals {
+    size_t docs = 0;
+    size_t kept = 0;
+    size_t dropped = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+    std::map<std::string, size_t> dropReasons;
+};
 
-            if (!drop) {
-                Utils::ScopedTimer t("QualityFilter");
-                FilterResult res = qualityFilter.filter(text);
-                if (!res.keep) {
-                    drop = true;
-                    reason = res.reason;
-                }
-            }
+std::string pipelineSpec(const Args& args) {
+    std::string spec = args.pipeline;
+    if (!args.pipeline_file.empty()) spec = readPipelineFile(args.pipeline_file);
+    if (spec.empty()) spec = kDefaultPipeline;
+    return spec;
+}
 
-            if (!drop) {
-                Utils::ScopedTimer t("ParagraphFilter");
-                FilterResult res = paragraphFilter.filter(text);
-                if (!res.keep) {
-                    drop = true;
-                    reason = res.reason;
-                }
+// One websift run over args.input_files; prints its report and returns
+// the exit code.
+int runSift(const Args& args, SiftTotals* totals) {
+    SiftContext ctx(args);
+    try {
+        const std::string spec = pipelineSpec(args);
+        ctx.chain = buildPipeline(spec);
+        if (!args.stats_output.empty()) {
+            ctx.statsCollector = std::make_unique<StatsCollector>(spec);
+            ctx.statsWriter = std::make_unique<StatsWriter>(args.stats_output, ctx.statsCollector->settings());
+        }
+        if (!args.line_counts_output.empty()) {
+            ctx.lineCounts = std::make_unique<LineFrequencySketch>(args.line_counts_width);
+        }
+        if (!args.signatures_output.empty()) {
+            MinHashConfig mc;
+            for (const StageSpec& stage : parsePipelineSpec(spec)) {
+                if (stage.name == "minhash_dedup") mc = minHashConfig(stage);
             }
+            ctx.sigHasher = std::make_unique<MinHasher>(mc.num_perm, mc.ngram, mc.seed);
+            ctx.sigWriter = std::make_unique<SignatureWriter>(args.signatures_output, *ctx.sigHasher);
+        }
+        if (!args.url_filter.empty()) {
+            ctx.urlFilter = std::make_unique<UrlBloomFilter>(args.url_filter, args.url_filter_update, args.url_filter_capacity);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    FilterChain& filterChain = ctx.chain;
+    filterChain.setOrder(args.adaptive_order ? FilterChain::Order::Adaptive : FilterChain::Order::Fixed);
+    filterChain.setWindow(args.adaptive_window);
+    filterChain.setProfiling(true);
+
+    // Inputs are read one after another as a single record stream.
+    size_t inputIndex = 0;
+    auto reader = std::make_unique<WarcReader>(args.input_files[0]);
+    auto nextRecord = [&reader, &inputIndex, &args](WarcRecord& record) {
+        while (!reader->nextRecord(record)) {
+            if (++inputIndex >= args.input_files.size()) return false;
+            reader = std::make_unique<WarcReader>(args.input_files[inputIndex]);
+        }
+        return true;
+    };
 
-            if (!drop) {
-                Utils::ScopedTimer t("BadWordsFilter");
-                FilterResult res = badWordsFilter.filter(text);
-                if (!res.keep) {
-                    drop = true;
-                    reason = res.reason;
-                }
-            }
+    if (!args.csv_output_file.empty()) {
+        ctx.csvOut.open(args.csv_output_file);
+        if (ctx.csvOut.is_open()) {
+            ctx.csvOut << "record_id,status,reason\n";
+        } else {
+            std::cerr << "Error: Could not open CSV output file " << args.csv_output_file << std::endl;
+        }
+    }
 
-            totalDocs++;
-            totalBytes += text.size();
+    DropCounters dropCounters;
+    std::vector<FilterChain::StageSummary> stageSummary;
 
-            if (drop) {
-                droppedDocs++;
-                dropReasons[reason]++;
-                status = "dropped";
-            } else {
-                keptDocs++;
-            }
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-            if (csvOut.is_open()) {
-                if (reason.find(',') != std::string::npos) {
-                    reason = "\"" + reason + "\"";
+    // One code path for every thread count: read -> filter -> csv over
+    // blocks (see StageGraph). --threads 1 runs the filter and csv stages
+    // inline on the reading thread; otherwise the filter stage gets the
+    // workers, idle ones stealing ranges of a few documents from busy ones,
+    // and the csv stage a thread of its own. queue_depth bounds the
+    // documents between the reader and the filter workers.
+    const bool serial = args.threads == 1;
+    unsigned int hw_threads = std::thread::hardware_concurrency();
+    if (hw_threads == 0) hw_threads = 4;
+    unsigned int thread_count = args.threads > 0 ? static_cast<unsigned int>(args.threads) : hw_threads;
+    if (args.auto_tune && args.max_threads > 0) thread_count = static_cast<unsigned int>(args.max_threads);
+    thread_count = std::max(1u, thread_count);
+
+    const size_t batch_size = std::max<size_t>(1, args.batch_size);
+    const size_t batch_bytes = std::max<size_t>(1, args.batch_bytes);
+    const size_t queue_docs = args.queue_depth ? args.queue_depth : 1024;
+    const size_t budget = args.memory_budget ? args.memory_budget : kDefaultMemoryBudget;
+    // Under --threads auto the in-flight limit does the bounding, so the
+    // block count only has to leave room for the whole budget.
+    const size_t queue_blocks = std::max<size_t>(1, args.auto_tune ? std::max(queue_docs / batch_size, budget / batch_bytes)
+                                                                    : queue_docs / batch_size);
+
+    // With --numa the workers are split over the NUMA nodes in proportion
+    // to their CPUs and pinned there, and each node is a lane of the graph
+    // (its own workers and free blocks), so a block is filled, processed
+    // and recycled by threads of one node. With at least one input per
+    // node, every node also runs its own pinned reader, taking the next
+    // unread input; otherwise the main thread reads and deals blocks to
+    // the nodes in turn, moving to each block's node to fill it.
+    std::vector<NumaNode> topology{NumaNode{}};
+    if (args.numa && !serial) {
+        // WEBSIFT_SYSFS points the lookup at a copy of /sys (for tests).
+        const char* root = std::getenv("WEBSIFT_SYSFS");
+        try {
+            topology = numaTopology(root ? root : "/sys");
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        if (topology.size() > thread_count) topology.resize(thread_count);
+    }
+    const size_t nodeCount = topology.size();
+    std::vector<unsigned> nodeWorkers(nodeCount, 0);
+    for (unsigned t = 0; t < thread_count; ++t) {
+        // Next worker to the node with the fewest workers per CPU.
+        size_t best = 0;
+        for (size_t n = 1; n < nodeCount; ++n) {
+            if (nodeWorkers[n] * topology[best].cpus.size() < nodeWorkers[best] * topology[n].cpus.size()) best = n;
+        }
+        nodeWorkers[best]++;
+    }
+    const bool nodeReaders = nodeCount > 1 && args.input_files.size() >= nodeCount;
+
+    const unsigned laneWorkers = *std::max_element(nodeWorkers.begin(), nodeWorkers.end());
+    SiftGraph graph("read", static_cast<unsigned>(nodeCount), queue_blocks + laneWorkers + 2);
+    ctx.workers.resize(serial ? 1 : thread_count);
+
+    SiftGraph::StageOptions filterOptions;
+    if (!serial) {
+        filterOptions.threads = thread_count;
+        filterOptions.lane_threads = nodeWorkers;
+        filterOptions.grain = kStealGrain;
+        const bool pin = args.numa;
+        filterOptions.start = [&ctx, &topology, pin](unsigned lane, unsigned w) {
+            const std::vector<int>& cpus = topology[lane].cpus;
+            if (pin) pinThread({cpus[w % cpus.size()]});
+            // Copied on the worker's own thread, so with pinning its
+            // memory is allocated on the worker's node.
+            ctx.workers[w].chain = ctx.chain;
+        };
+    } else {
+        ctx.workers[0].chain = filterChain;
+    }
+    const size_t filterStage = addStages(graph, ctx, filterOptions, serial);
+
+    // Input bytes between the reader and the workers are capped by
+    // --memory-budget; with --threads auto the tuner moves the cap
+    // between two blocks per worker and the budget, and starts with
+    // half the workers (see AutoTuner).
+    std::unique_ptr<AutoTuner> tuner;
+    if (args.auto_tune) {
+        const unsigned startWorkers = std::max(1u, thread_count / 2);
+        tuner = std::make_unique<AutoTuner>(thread_count, startWorkers, 2 * batch_bytes, budget,
+                                            4 * batch_bytes * startWorkers);
+        graph.setByteLimit(tuner->inflightBytes());
+        graph.setActive(filterStage, tuner->workers());
+    } else if (args.memory_budget) {
+        graph.setByteLimit(args.memory_budget);
+    }
+    std::mutex tuneMu;
+    std::condition_variable tuneCv;
+    bool reading = true;
+    std::thread tunerThread;
+    if (tuner) {
+        tunerThread = std::thread([&]() {
+            InflightLimit& inflight = *graph.inflight();
+            auto last = std::chrono::steady_clock::now();
+            uint64_t lastDocs = ctx.totalDocs.load(std::memory_order_relaxed);
+            double lastStall = graph.stallSeconds();
+            double lastIdle = graph.idleSeconds(filterStage);
+            std::unique_lock<std::mutex> lk(tuneMu);
+            while (reading) {
+                double occupancy = 0;
+                int samples = 0;
+                for (; samples < kTuneSamples && reading; ++samples) {
+                    tuneCv.wait_for(lk, kTuneInterval / kTuneSamples);
+                    occupancy += static_cast<double>(inflight.used()) / inflight.limit();
                 }
-                csvOut << record.id << "," << status << "," << reason << "\n";
+                if (!reading) break;
+                const auto now = std::chrono::steady_clock::now();
+                const uint64_t docs = ctx.totalDocs.load(std::memory_order_relaxed);
+                const double stall = graph.stallSeconds();
+                const double idle = graph.idleSeconds(filterStage);
+                TunerSample sample;
+                sample.seconds = std::chrono::duration<double>(now - last).count();
+                sample.docs = docs - lastDocs;
+                sample.reader_stall = stall - lastStall;
+                sample.worker_idle = idle - lastIdle;
+                sample.occupancy = occupancy / samples;
+                tuner->update(sample);
+                graph.setActive(filterStage, tuner->workers());
+                inflight.setLimit(tuner->inflightBytes());
+                last = now;
+                lastDocs = docs;
+                lastStall = stall;
+                lastIdle = idle;
             }
+        });
+    }
+
+    std::vector<DropCounters> skipped(nodeReaders ? nodeCount : 1);
+    if (nodeReaders) {
+        // Each reader takes whole inputs; which node reads which input
+        // depends on timing, and so does the order of the CSV rows.
+        std::atomic<size_t> nextInput{0};
+        std::vector<std::thread> readers;
+        for (size_t n = 0; n < nodeCount; ++n) {
+            readers.emplace_back([&, n]() {
+                pinThread(topology[n].cpus);
+                std::unique_ptr<WarcReader> input;
+                auto next = [&](WarcRecord& record) {
+                    while (!input || !input->nextRecord(record)) {
+                        const size_t i = nextInput.fetch_add(1);
+                        if (i >= args.input_files.size()) return false;
+                        input = std::make_unique<WarcReader>(args.input_files[i]);
+                    }
+                    return true;
+                };
+                SiftGraph::Source source(graph, static_cast<unsigned>(n));
+                readRecords(source, ctx, next, skipped[n], false, static_cast<unsigned>(nodeCount));
+            });
+        }
+        for (std::thread& r : readers) r.join();
+    } else {
+        SiftGraph::Source source(graph, 0);
+        readRecords(source, ctx, nextRecord, skipped[0], nodeCount > 1, static_cast<unsigned>(nodeCount),
+                    args.numa ? &topology : nullptr);
+        if (args.numa && nodeCount > 1) {
+            // Let the main thread run anywhere again.
+            std::vector<int> all;
+            for (const NumaNode& node : topology) all.insert(all.end(), node.cpus.begin(), node.cpus.end());
+            pinThread(all);
+        }
+    }
+    if (tunerThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lk(tuneMu);
+            reading = false;
         }
+        tuneCv.notify_one();
+        tunerThread.join();
+    }
+    graph.finish();
+    ctx.csvOut.flush();
+    uint64_t extractNs = 0;
+    for (const WorkerState& st : ctx.workers) {
+        dropCounters.merge(st.drops);
+        FilterChain::mergeSummary(stageSummary, st.chain.summary());
+        extractNs += st.extractNs;
+    }
+    for (const DropCounters& d : skipped) dropCounters.merge(d);
+
+    // Workers are done with their copies of the chain; shared filter state
+    // (the dedup set) can be saved now.
+    try {
+        if (ctx.statsWriter) ctx.statsWriter->close();
+        if (ctx.lineCounts) ctx.lineCounts->save(args.line_counts_output);
+        if (ctx.filtering()) filterChain.finish();
+        if (ctx.sigWriter) ctx.sigWriter->close();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
     }
 
     auto endTime = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = endTime - startTime;
 
-    size_t totalDocsCount = totalDocs.load(std::memory_order_relaxed);
-    size_t totalBytesCount = totalBytes.load(std::memory_order_relaxed);
-    size_t keptDocsCount = keptDocs.load(std::memory_order_relaxed);
-    size_t droppedDocsCount = droppedDocs.load(std::memory_order_relaxed);
+    size_t totalDocsCount = ctx.totalDocs.load(std::memory_order_relaxed);
+    size_t totalBytesCount = ctx.totalBytes.load(std::memory_order_relaxed);
+    size_t keptDocsCount = ctx.keptDocs.load(std::memory_order_relaxed);
+    size_t droppedDocsCount = ctx.droppedDocs.load(std::memory_order_relaxed);
 
+    if (args.numa) {
+        std::cout << "NUMA Nodes: " << nodeCount << " (workers";
+        for (unsigned n : nodeWorkers) std::cout << " " << n;
+        std::cout << (nodeReaders ? ", one reader per node)" : ", one reader)") << std::endl;
+    }
+    if (tuner) {
+        std::cout << "Auto Tuning: " << tuner->workers() << " of " << thread_count << " workers, in-flight limit "
+                  << tuner->inflightBytes() / 1024 << " KiB" << std::endl;
+    }
     std::cout << "Processing completed in " << elapsed.count() << " seconds." << std::endl;
     std::cout << "Total Docs: " << totalDocsCount << std::endl;
     std::cout << "Total Bytes: " << totalBytesCount << std::endl;
@@ -318,12 +676,226 @@ int main(int argc, char** argv) {
         std::cout << "MB/sec: " << (elapsed.count() > 0 ? (totalBytesCount / 1024.0 / 1024.0) / elapsed.count() : 0) << std::endl;
     }
 
+    if (ctx.statsWriter) {
+        std::cout << "Stats Rows: " << ctx.statsWriter->rowsWritten() << " (" << args.stats_output << ")" << std::endl;
+    }
+
+    if (ctx.lineCounts) {
+        std::cout << "Line Counts: " << ctx.lineCounts->documents() << " docs (" << args.line_counts_output << ")" << std::endl;
+    }
+    if (ctx.sigWriter) {
+        std::cout << "Signatures: " << ctx.sigWriter->written() << " (" << args.signatures_output << ")" << std::endl;
+    }
+
+    // Busy: time in the stage summed over its workers (for the reader,
+    // reading and splitting records); wait: workers idle for lack of
+    // blocks or, for the reader, held back by the block and byte limits.
+    std::cout << "\nPipeline Stages:" << std::endl;
+    for (const SiftGraph::StageMetrics& m : graph.metrics()) {
+        std::cout << "  " << m.name << ": threads=" << m.threads << " blocks=" << m.blocks << " docs=" << m.items
+                  << " busy_s=" << m.busy_seconds << " wait_s=" << m.wait_seconds << std::endl;
+    }
     std::cout << "\nDrop Reasons:" << std::endl;
-    for (const auto& pair : dropReasons) {
+    for (const auto& pair : dropCounters.report(filterChain)) {
         std::cout << "  " << pair.first << ": " << pair.second << std::endl;
     }
 
-    Utils::Profiler::instance().printStats();
+    if (args.adaptive_order) {
+        std::cout << "\nFilter Stages (adaptive order):" << std::endl;
+        for (const auto& s : stageSummary) {
+            double ns_per_byte = s.bytes > 0 ? static_cast<double>(s.ns) / static_cast<double>(s.bytes) : 0.0;
+            double drop_rate = s.runs > 0 ? static_cast<double>(s.drops) / static_cast<double>(s.runs) : 0.0;
+            std::cout << "  " << s.name << ": runs=" << s.runs << " drops=" << s.drops
+                      << " drop_rate=" << drop_rate << " ns/byte=" << ns_per_byte << std::endl;
+        }
+    }
+
+    // Per-filter times come from the workers' chains (profiling is on). A
+    // profiler of this run's own, not the process-wide instance: with
+    // --manifest each shard is a run and reports only its own times.
+    Utils::Profiler profiler;
+    profiler.add("Extraction", extractNs / 1e6, ctx.totalDocs.load(std::memory_order_relaxed));
+    for (const auto& s : stageSummary) {
+        if (s.runs > 0) profiler.add(s.name, s.ns / 1e6, s.runs);
+    }
+    profiler.printStats();
+
+    if (totals) {
+        totals->docs = totalDocsCount;
+        totals->kept = keptDocsCount;
+        totals->dropped = droppedDocsCount;
+        totals->bytes = totalBytesCount;
+        totals->seconds = elapsed.count();
+        totals->dropReasons = dropCounters.report(filterChain);
+    }
+    return 0;
+}
+
+// Minimal JSON string escaping for the stats files.
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Coordinator mode: claim shards of the manifest one at a time, run each
+// as its own websift run writing into <work>/out, and mark it done. Any
+// number of processes may run this against the same work directory.
+int runShards(const Args& args) {
+    std::vector<std::string> shards;
+    std::unique_ptr<ShardLeases> leases;
+    std::string owner = args.worker_id;
+    if (owner.empty()) {
+        char host[256] = {0};
+        gethostname(host, sizeof(host) - 1);
+        owner = std::string(host) + ":" + std::to_string(getpid());
+    }
+    try {
+        if (args.work_dir.empty()) throw std::invalid_argument("--manifest needs --work-dir");
+        // State a run writes back as it goes (URLs marked seen, a saved
+        // dedup set) would survive a shard that fails or loses its lease,
+        // and its retry would then drop every document as already seen.
+        if (args.url_filter_update) {
+            throw std::invalid_argument("--url-filter-update cannot be used with --manifest (update the filter in a separate pass)");
+        }
+        for (const StageSpec& stage : parsePipelineSpec(pipelineSpec(args))) {
+            for (const auto& param : stage.params) {
+                if (stage.name == "exact_dedup" && param.first == "path") {
+                    throw std::invalid_argument("exact_dedup(path=...) cannot be used with --manifest; each shard dedups on its own");
+                }
+            }
+        }
+        shards = ShardLeases::readManifest(args.manifest);
+        leases = std::make_unique<ShardLeases>(args.work_dir, owner, args.lease_timeout);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    size_t processed = 0;
+    while (true) {
+        long claimed = 0;
+        try {
+            claimed = leases->claimNext(shards.size());
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        if (claimed < 0) break;
+        const size_t shard = static_cast<size_t>(claimed);
+        const std::string name = ShardLeases::shardName(shard);
+        std::cout << "Shard " << name << ": claimed by " << leases->owner() << " (" << shards[shard] << ")" << std::endl;
+
+        // Heartbeats run beside the shard; a lost lease (we stalled past
+        // the timeout and someone took over) discards this run's outputs.
+        std::mutex beatMu;
+        std::condition_variable beatCv;
+        bool running = true;
+        std::atomic<bool> lost{false};
+        std::thread beat([&]() {
+            const auto every = std::chrono::duration<double>(leases->timeout() / 4);
+            std::unique_lock<std::mutex> lk(beatMu);
+            while (running && !beatCv.wait_for(lk, every, [&] { return !running; })) {
+                if (!leases->heartbeat(shard)) lost = true;
+            }
+        });
+
+        // Outputs go to temporary names, published only once complete.
+        const std::string tmpSuffix = ".tmp." + leases->owner();
+        Args shardArgs = args;
+        shardArgs.input_files = {shards[shard]};
+        std::vector<std::pair<std::string, std::string>> outputs; // (temporary, final)
+        auto redirect = [&](std::string& path, const std::string& suffix, bool always) {
+            if (path.empty() && !always) return;
+            path = leases->outputPath(shard, suffix) + tmpSuffix;
+            outputs.emplace_back(path, leases->outputPath(shard, suffix));
+        };
+        redirect(shardArgs.csv_output_file, ".csv", true);
+        redirect(shardArgs.signatures_output, ".sig", false);
+        redirect(shardArgs.stats_output, ".stats", false);
+        redirect(shardArgs.line_counts_output, ".lines", false);
+
+        SiftTotals totals;
+        int rc = 1;
+        try {
+            rc = runSift(shardArgs, &totals);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: shard " << name << ": " << e.what() << std::endl;
+        }
+        {
+            std::lock_guard<std::mutex> lk(beatMu);
+            running = false;
+        }
+        beatCv.notify_one();
+        beat.join();
+
+        // Renew the lease right before publishing: a takeover from here on
+        // needs this worker to stall a whole timeout (see ShardLeases).
+        if (rc != 0 || lost || !leases->heartbeat(shard)) {
+            for (const auto& out : outputs) std::remove(out.first.c_str());
+            if (rc != 0) {
+                leases->release(shard);
+                std::cerr << "Error: shard " << name << " failed; lease released" << std::endl;
+                return rc;
+            }
+            std::cerr << "Warning: lost the lease on shard " << name << "; outputs dropped" << std::endl;
+            continue;
+        }
 
+        bool published = true;
+        try {
+            const std::string statsPath = leases->outputPath(shard, ".json");
+            {
+                std::ofstream js(statsPath + tmpSuffix);
+                js << "{\"shard\": " << jsonString(name) << ", \"input\": " << jsonString(shards[shard])
+                   << ", \"worker\": " << jsonString(leases->owner()) << ", \"docs\": " << totals.docs
+                   << ", \"kept\": " << totals.kept << ", \"dropped\": " << totals.dropped
+                   << ", \"bytes\": " << totals.bytes << ", \"seconds\": " << totals.seconds << ", \"drop_reasons\": {";
+                bool first = true;
+                for (const auto& reason : totals.dropReasons) {
+                    js << (first ? "" : ", ") << jsonString(reason.first) << ": " << reason.second;
+                    first = false;
+                }
+                js << "}}\n";
+                if (!js) throw std::runtime_error("cannot write " + statsPath + tmpSuffix);
+            }
+            outputs.emplace_back(statsPath + tmpSuffix, statsPath);
+            // Each rename rechecks the lease, and markDone refuses once it moved.
+            for (const auto& out : outputs) {
+                published = leases->publish(shard, out.first, out.second);
+                if (!published) break;
+            }
+            published = published && leases->markDone(shard);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: shard " << name << ": " << e.what() << std::endl;
+            leases->release(shard);
+            return 1;
+        }
+        if (!published) {
+            for (const auto& out : outputs) std::remove(out.first.c_str());
+            std::cerr << "Warning: lost the lease on shard " << name << " while publishing; outputs dropped" << std::endl;
+            continue;
+        }
+        processed++;
+        std::cout << "Shard " << name << ": done" << std::endl;
+    }
+    std::cout << "Coordinator: " << processed << " of " << shards.size() << " shards processed by " << leases->owner()
+              << "; all shards done" << std::endl;
     return 0;
 }
+
+int main(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+
+    Args args = parseArgs(argc, argv);
+
+    downloadBadWords();
+
+    if (!args.manifest.empty()) return runShards(args);
+    return runSift(args, nullptr);
+}
@@ -0,0 +1,244 @@
+#include "minhash.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WEBSIFT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr char kMagic[8] = {'W', 'S', 'M', 'H', 'S', 'I', 'G', '1'};
+constexpr size_t kLanes = 8;
+constexpr uint64_t kGolden = 0x9E3779B97F4A7C15ULL;
+
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += kGolden);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+inline uint32_t fmix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+template <typename T>
+void writePod(std::ofstream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+} // namespace
+
+void minHash8Scalar(const uint32_t* seeds, const std::vector<uint32_t>& shingles, uint32_t* mins) {
+    uint32_t acc[kLanes];
+    std::fill(acc, acc + kLanes, std::numeric_limits<uint32_t>::max());
+    for (uint32_t x : shingles) {
+        for (size_t l = 0; l < kLanes; ++l) acc[l] = std::min(acc[l], fmix32(x ^ seeds[l]));
+    }
+    std::memcpy(mins, acc, sizeof(acc));
+}
+
+#if defined(WEBSIFT_X86)
+namespace {
+
+// Compiled for AVX2 whatever the build flags; only called after the CPU
+// check in minHash8Avx2().
+__attribute__((target("avx2"))) void minHash8Avx2Kernel(const uint32_t* seeds, const std::vector<uint32_t>& shingles,
+                                                        uint32_t* mins) {
+    const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(seeds));
+    const __m256i m1 = _mm256_set1_epi32(static_cast<int>(0x85ebca6bU));
+    const __m256i m2 = _mm256_set1_epi32(static_cast<int>(0xc2b2ae35U));
+    __m256i acc = _mm256_set1_epi32(-1);
+    for (uint32_t x : shingles) {
+        __m256i h = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(x)), s);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        h = _mm256_mullo_epi32(h, m1);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+        h = _mm256_mullo_epi32(h, m2);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        acc = _mm256_min_epu32(acc, h);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(mins), acc);
+}
+
+} // namespace
+#endif
+
+bool minHashHasAvx2() {
+#if defined(WEBSIFT_X86)
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+#else
+    return false;
+#endif
+}
+
+bool minHash8Avx2(const uint32_t* seeds, const std::vector<uint32_t>& shingles, uint32_t* mins) {
+#if defined(WEBSIFT_X86)
+    if (!minHashHasAvx2()) return false;
+    minHash8Avx2Kernel(seeds, shingles, mins);
+    return true;
+#else
+    (void)seeds;
+    (void)shingles;
+    (void)mins;
+    return false;
+#endif
+}
+
+MinHasher::MinHasher(int num_perm, int ngram, uint64_t seed) : ngram_(ngram), seed_(seed) {
+    if (num_perm <= 0 || num_perm % static_cast<int>(kLanes) != 0) {
+        throw std::invalid_argument("minhash: num_perm must be a positive multiple of 8");
+    }
+    if (ngram < 1) throw std::invalid_argument("minhash: ngram must be at least 1");
+    uint64_t state = seed;
+    seeds_.resize(static_cast<size_t>(num_perm));
+    for (uint32_t& s : seeds_) s = static_cast<uint32_t>(splitmix64(state));
+}
+
+void MinHasher::signature(const DocumentAnalysis& doc, std::vector<uint32_t>& out) const {
+    thread_local std::vector<uint64_t> word_hashes;
+    thread_local std::vector<uint32_t> shingles;
+
+    const std::string_view lower = doc.lower();
+    word_hashes.clear();
+    for (const TextSpan& w : doc.words()) word_hashes.push_back(hash128(lower.substr(w.offset, w.length)).lo);
+
+    shingles.clear();
+    if (!word_hashes.empty()) {
+        const size_t n = std::min(word_hashes.size(), static_cast<size_t>(ngram_));
+        for (size_t i = 0; i + n <= word_hashes.size(); ++i) {
+            uint64_t s = 0;
+            for (size_t j = 0; j < n; ++j) s = (rotl64(s, 23) ^ word_hashes[i + j]) * kGolden;
+            shingles.push_back(static_cast<uint32_t>(s >> 32));
+        }
+    }
+
+    out.resize(seeds_.size());
+    if (minHashHasAvx2()) {
+        for (size_t p = 0; p < seeds_.size(); p += kLanes) minHash8Avx2(&seeds_[p], shingles, &out[p]);
+    } else {
+        for (size_t p = 0; p < seeds_.size(); p += kLanes) minHash8Scalar(&seeds_[p], shingles, &out[p]);
+    }
+}
+
+std::pair<int, int> lshParams(double threshold, int num_perm) {
+    auto integrate = [](auto f, double a, double b) {
+        constexpr int kSteps = 200;
+        const double step = (b - a) / kSteps;
+        double sum = 0;
+        for (int i = 0; i < kSteps; ++i) sum += f(a + (i + 0.5) * step);
+        return sum * step;
+    };
+    std::pair<int, int> best{1, num_perm};
+    double best_error = std::numeric_limits<double>::max();
+    for (int b = 1; b <= num_perm; ++b) {
+        for (int r = 1; r <= num_perm / b; ++r) {
+            auto candidate = [b, r](double s) { return 1.0 - std::pow(1.0 - std::pow(s, r), b); };
+            const double fp = integrate(candidate, 0.0, threshold);
+            const double fn = integrate([&](double s) { return 1.0 - candidate(s); }, threshold, 1.0);
+            const double error = 0.5 * fp + 0.5 * fn;
+            if (error < best_error) {
+                best_error = error;
+                best = {b, r};
+            }
+        }
+    }
+    return best;
+}
+
+MinHashDedupFilter::MinHashDedupFilter(const MinHashConfig& config)
+    : config_(config),
+      hasher_(config.num_perm, config.ngram, config.seed),
+      bands_seen_(std::make_shared<ExactDedupSet>(static_cast<size_t>(std::max(config.max_mb, 1)) << 20)) {
+    if (config.threshold <= 0.0 || config.threshold >= 1.0) {
+        throw std::invalid_argument("minhash: threshold must be between 0 and 1");
+    }
+    if (config.bands < 0 || config.bands > config.num_perm) {
+        throw std::invalid_argument("minhash: bands must be between 1 and num_perm");
+    }
+    if (config.bands > 0) {
+        bands_ = config.bands;
+        rows_ = config.num_perm / config.bands;
+    } else {
+        std::tie(bands_, rows_) = lshParams(config.threshold, config.num_perm);
+    }
+}
+
+FilterResult MinHashDedupFilter::filter(const DocumentAnalysis& doc) const {
+    if (doc.words().empty()) return {true};
+
+    thread_local std::vector<uint32_t> sig;
+    thread_local std::vector<Hash128> keys;
+    hasher_.signature(doc, sig);
+
+    keys.clear();
+    for (int b = 0; b < bands_; ++b) {
+        const char* band = reinterpret_cast<const char*>(&sig[static_cast<size_t>(b * rows_)]);
+        keys.push_back(hash128(std::string_view(band, static_cast<size_t>(rows_) * sizeof(uint32_t)),
+                               static_cast<uint64_t>(b)));
+    }
+    // One atomic step: of two near duplicates on different workers, only
+    // one can find its bands absent and record them.
+    if (bands_seen_->testAndInsertAll(keys.data(), keys.size())) return {false, DropReason::NearDuplicate};
+    return {true};
+}
+
+void MinHashDedupFilter::finish() const {
+    if (bands_seen_->overflow() > 0) {
+        std::cerr << "minhash_dedup: memory bound (max_mb=" << config_.max_mb << ") reached; "
+                  << bands_seen_->overflow() << " bands were not recorded\n";
+    }
+}
+
+SignatureWriter::SignatureWriter(const std::string& path, const MinHasher& hasher)
+    : out_(path, std::ios::binary), path_(path) {
+    if (!out_.is_open()) {
+        throw std::runtime_error("minhash: could not open " + path + " for writing");
+    }
+    out_.write(kMagic, sizeof(kMagic));
+    writePod(out_, static_cast<uint32_t>(hasher.numPerm()));
+    writePod(out_, static_cast<uint32_t>(hasher.ngram()));
+    writePod(out_, hasher.seed());
+}
+
+SignatureWriter::~SignatureWriter() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // Destructors must not throw; call close() to see write errors.
+    }
+}
+
+void SignatureWriter::encode(std::string& buf, std::string_view id, const std::vector<uint32_t>& signature) {
+    const uint16_t len = static_cast<uint16_t>(std::min<size_t>(id.size(), 0xFFFF));
+    buf.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    buf.append(id.data(), len);
+    buf.append(reinterpret_cast<const char*>(signature.data()), signature.size() * sizeof(uint32_t));
+}
+
+void SignatureWriter::append(std::string_view records, size_t count) {
+    out_.write(records.data(), static_cast<std::streamsize>(records.size()));
+    if (!out_) throw std::runtime_error("minhash: write to " + path_ + " failed");
+    written_ += count;
+}
+
+void SignatureWriter::close() {
+    if (!out_.is_open()) return;
+    out_.close();
+    if (!out_) throw std::runtime_error("minhash: write to " + path_ + " failed");
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "dedup.hpp"
+#include "document.hpp"
+#include "filters.hpp"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Near-duplicate detection with MinHash and LSH banding.
+//
+// Shingles are runs of `ngram` consecutive words (whitespace-separated,
+// ASCII lower-cased); a document with fewer words is one shingle. Each
+// shingle is hashed to 32 bits, and permutation i maps it to
+// fmix32(x ^ seed_i); the signature is the per-permutation minimum,
+// computed 8 permutations at a time (AVX2 when the CPU has it, checked at
+// run time; the build needs no -mavx2).
+
+struct MinHashConfig {
+    int ngram = 5;
+    int num_perm = 128;      // multiple of 8
+    double threshold = 0.8;  // Jaccard similarity treated as duplicate
+    int bands = 0;           // 0: choose bands/rows for threshold
+    uint64_t seed = 1;
+    int max_mb = 1024;       // memory bound of the band tables
+};
+
+class MinHasher {
+public:
+    MinHasher(int num_perm, int ngram, uint64_t seed);
+
+    // Empty documents get an all-0xFFFFFFFF signature.
+    void signature(const DocumentAnalysis& doc, std::vector<uint32_t>& out) const;
+    int numPerm() const { return static_cast<int>(seeds_.size()); }
+    int ngram() const { return ngram_; }
+    uint64_t seed() const { return seed_; }
+
+private:
+    int ngram_;
+    uint64_t seed_;
+    std::vector<uint32_t> seeds_;
+};
+
+// The kernel behind MinHasher::signature: mins[l] = min over shingles of
+// fmix32(x ^ seeds[l]) for 8 permutations. minHash8Avx2 returns false
+// (leaving mins alone) on CPUs without AVX2. Both produce the same values.
+void minHash8Scalar(const uint32_t* seeds, const std::vector<uint32_t>& shingles, uint32_t* mins);
+bool minHash8Avx2(const uint32_t* seeds, const std::vector<uint32_t>& shingles, uint32_t* mins);
+bool minHashHasAvx2();
+
+// (bands, rows) with bands * rows <= num_perm minimizing the equally
+// weighted false positive and false negative probability mass around
+// threshold (the same choice datasketch's MinHashLSH makes).
+std::pair<int, int> lshParams(double threshold, int num_perm);
+
+// Pipeline stage: a document whose signature shares any LSH band with an
+// earlier kept document drops as "near_duplicate"; otherwise its bands are
+// recorded. Copies share the band tables (one ExactDedupSet keyed by band
+// and band hash), so all workers dedup against each other.
+class MinHashDedupFilter {
+public:
+    explicit MinHashDedupFilter(const MinHashConfig& config = {});
+
+    FilterResult filter(const DocumentAnalysis& doc) const;
+    void finish() const;
+
+private:
+    MinHashConfig config_;
+    MinHasher hasher_;
+    int bands_;
+    int rows_;
+    std::shared_ptr<ExactDedupSet> bands_seen_;
+};
+
+// Signatures of kept documents for cross-shard clustering. File: the magic
+// "WSMHSIG1", uint32 num_perm, uint32 ngram, uint64 seed, then per document
+// a uint16 id length, the id bytes and num_perm uint32 values (host byte
+// order). I/O errors throw std::runtime_error.
+class SignatureWriter {
+public:
+    SignatureWriter(const std::string& path, const MinHasher& hasher);
+    ~SignatureWriter();
+
+    // Serialize one record into buf, so workers can batch a block of
+    // records and write it with one append().
+    static void encode(std::string& buf, std::string_view id, const std::vector<uint32_t>& signature);
+    void append(std::string_view records, size_t count);
+    void close();
+    size_t written() const { return written_; }
+
+private:
+    std::ofstream out_;
+    std::string path_;
+    size_t written_ = 0;
+};
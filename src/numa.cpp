@@ -0,0 +1,87 @@
+#include "numa.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+
+bool readFirstLine(const std::string& path, std::string& line) {
+    std::ifstream in(path);
+    return in.is_open() && static_cast<bool>(std::getline(in, line));
+}
+
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty()) cpus.push_back(0);
+    return cpus;
+}
+
+} // namespace
+
+std::vector<int> parseCpuList(std::string_view list) {
+    std::vector<int> cpus;
+    while (!list.empty() && (list.back() == '\n' || list.back() == ' ')) list.remove_suffix(1);
+    std::stringstream ss{std::string(list)};
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        try {
+            size_t used = 0;
+            const int first = std::stoi(item, &used);
+            int last = first;
+            if (used < item.size()) {
+                if (item[used] != '-') throw std::invalid_argument(item);
+                size_t used2 = 0;
+                last = std::stoi(item.substr(used + 1), &used2);
+                if (used + 1 + used2 != item.size()) throw std::invalid_argument(item);
+            }
+            if (first < 0 || last < first) throw std::invalid_argument(item);
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        } catch (const std::exception&) {
+            throw std::invalid_argument("cpu list: bad entry '" + item + "'");
+        }
+    }
+    return cpus;
+}
+
+std::vector<NumaNode> numaTopology(const std::string& sysfs_root) {
+    const std::vector<int> allowed = allowedCpus();
+    const std::string base = sysfs_root + "/devices/system/node/";
+
+    std::vector<NumaNode> nodes;
+    std::string line;
+    if (readFirstLine(base + "online", line)) {
+        for (int id : parseCpuList(line)) {
+            std::string cpulist;
+            if (!readFirstLine(base + "node" + std::to_string(id) + "/cpulist", cpulist)) continue;
+            NumaNode node;
+            node.id = id;
+            for (int cpu : parseCpuList(cpulist)) {
+                if (std::binary_search(allowed.begin(), allowed.end(), cpu)) node.cpus.push_back(cpu);
+            }
+            if (!node.cpus.empty()) nodes.push_back(std::move(node));
+        }
+    }
+    if (nodes.empty()) nodes.push_back(NumaNode{0, allowed});
+    return nodes;
+}
+
+bool pinThread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
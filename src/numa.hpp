@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// NUMA topology from sysfs (no libnuma): /sys/devices/system/node/online
+// and node<N>/cpulist, restricted to the CPUs this process may run on.
+// Nodes left with no usable CPU are dropped; without NUMA information the
+// result is one node holding every allowed CPU.
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+// `sysfs_root` is "/sys" outside of tests.
+std::vector<NumaNode> numaTopology(const std::string& sysfs_root = "/sys");
+
+// Parses a kernel CPU list such as "0-3,8,10-11"; throws
+// std::invalid_argument on malformed input.
+std::vector<int> parseCpuList(std::string_view list);
+
+// Restricts the calling thread to the given CPUs; false if the kernel
+// refuses.
+bool pinThread(const std::vector<int>& cpus);
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "hashing.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Static string set backed by a minimal perfect hash (hash-and-displace),
+// built once at construction. A lookup is one hash of the key, one mix to
+// pick its slot and a single key comparison, whatever the set size.
+//
+// Keys are hashed once; the high bits pick a bucket, and every bucket gets
+// a seed, found by trial, that sends all of its keys to distinct free slots
+// of a table with exactly one slot per key.
+class PerfectHashSet {
+public:
+    PerfectHashSet() = default;
+
+    explicit PerfectHashSet(std::vector<std::string> keys) {
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        if (keys.empty()) return;
+        // A seed search only fails if two keys share a full 64-bit hash; then
+        // rehash everything with another salt.
+        while (!build(keys)) salt_++;
+    }
+
+    bool contains(std::string_view key) const {
+        if (slots_.empty()) return false;
+        const uint64_t h = Hashing::hashBytes(key, salt_);
+        const Slot& s = slots_[slotFor(h, seeds_[bucketFor(h)])];
+        return s.length == key.size() && key.compare(0, key.size(), arena_.data() + s.offset, s.length) == 0;
+    }
+
+    size_t size() const { return slots_.size(); }
+    bool empty() const { return slots_.empty(); }
+
+private:
+    struct Slot {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    std::string arena_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> seeds_;
+    uint64_t salt_ = 0;
+
+    static constexpr uint32_t kMaxSeed = 1u << 20;
+
+    size_t bucketFor(uint64_t h) const {
+        return static_cast<size_t>((h >> 32) % seeds_.size());
+    }
+
+    size_t slotFor(uint64_t h, uint32_t seed) const {
+        return static_cast<size_t>(Hashing::mix64(h ^ (seed * Hashing::kMul0)) % slots_.size());
+    }
+
+    bool build(const std::vector<std::string>& keys) {
+        const size_t n = keys.size();
+
+        std::vector<uint64_t> hashes(n);
+        for (size_t i = 0; i < n; ++i) hashes[i] = Hashing::hashBytes(keys[i], salt_);
+
+        arena_.clear();
+        slots_.assign(n, Slot{});
+        // About two keys per bucket keeps the seed search short.
+        seeds_.assign(n / 2 + 1, 0);
+        std::vector<std::vector<uint32_t>> buckets(seeds_.size());
+        for (uint32_t i = 0; i < n; ++i) buckets[bucketFor(hashes[i])].push_back(i);
+
+        // Place the largest buckets first, while the table is still empty.
+        std::vector<uint32_t> order(buckets.size());
+        for (uint32_t b = 0; b < order.size(); ++b) order[b] = b;
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        std::vector<bool> taken(n, false);
+        std::vector<size_t> placed;
+        for (uint32_t b : order) {
+            const auto& bucket = buckets[b];
+            if (bucket.empty()) break;
+            uint32_t seed = 1;
+            for (; seed < kMaxSeed; ++seed) {
+                placed.clear();
+                bool ok = true;
+                for (uint32_t k : bucket) {
+                    size_t slot = slotFor(hashes[k], seed);
+                    if (taken[slot] || std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+                        ok = false;
+                        break;
+                    }
+                    placed.push_back(slot);
+                }
+                if (!ok) continue;
+                seeds_[b] = seed;
+                for (size_t j = 0; j < bucket.size(); ++j) {
+                    taken[placed[j]] = true;
+                    const std::string& key = keys[bucket[j]];
+                    slots_[placed[j]] = Slot{static_cast<uint32_t>(arena_.size()), static_cast<uint32_t>(key.size())};
+                    arena_ += key;
+                }
+                break;
+            }
+            if (seed == kMaxSeed) return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,368 @@
+#include "pipeline.hpp"
+#include "dedup.hpp"
+#include "filters.hpp"
+#include "line_freq.hpp"
+#include "minhash.hpp"
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+const char* const kDefaultPipeline = "c4_quality,c4_paragraph,c4_badwords";
+
+namespace {
+
+std::string trim(const std::string& s) {
+    size_t first = s.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return "";
+    size_t last = s.find_last_not_of(" \t\r\n");
+    return s.substr(first, last - first + 1);
+}
+
+std::string stripComments(const std::string& spec) {
+    std::string out;
+    out.reserve(spec.size());
+    bool in_comment = false;
+    for (char c : spec) {
+        if (c == '#') in_comment = true;
+        if (c == '\n') in_comment = false;
+        if (!in_comment) out.push_back(c);
+    }
+    return out;
+}
+
+// Typed access to a stage's parameters; finish() rejects any parameter that
+// was never read, so typos fail loudly instead of silently using defaults.
+class ParamReader {
+public:
+    explicit ParamReader(const StageSpec& spec) : spec_(spec), used_(spec.params.size(), false) {}
+
+    void get(const char* key, int& out) {
+        if (const std::string* v = find(key)) {
+            size_t idx = 0;
+            try {
+                out = std::stoi(*v, &idx);
+            } catch (const std::exception&) {
+                idx = 0;
+            }
+            if (idx == 0 || idx != v->size()) fail(key, *v, "an integer");
+        }
+    }
+
+    void get(const char* key, double& out) {
+        if (const std::string* v = find(key)) {
+            size_t idx = 0;
+            try {
+                out = std::stod(*v, &idx);
+            } catch (const std::exception&) {
+                idx = 0;
+            }
+            if (idx == 0 || idx != v->size()) fail(key, *v, "a number");
+        }
+    }
+
+    void get(const char* key, bool& out) {
+        if (const std::string* v = find(key)) {
+            if (*v == "true" || *v == "1") {
+                out = true;
+            } else if (*v == "false" || *v == "0") {
+                out = false;
+            } else {
+                fail(key, *v, "true/false");
+            }
+        }
+    }
+
+    void get(const char* key, std::string& out) {
+        if (const std::string* v = find(key)) out = *v;
+    }
+
+    void get(const char* key, std::vector<std::string>& out) {
+        if (const std::string* v = find(key)) {
+            out.clear();
+            std::stringstream ss(*v);
+            std::string item;
+            while (std::getline(ss, item, '|')) {
+                item = trim(item);
+                if (!item.empty()) out.push_back(item);
+            }
+        }
+    }
+
+    // "n:fraction" pairs, e.g. top_n_grams=2:0.2|3:0.18
+    void get(const char* key, std::vector<std::pair<int, double>>& out) {
+        std::vector<std::string> items;
+        get(key, items);
+        if (items.empty()) return;
+        out.clear();
+        for (const std::string& item : items) {
+            size_t colon = item.find(':');
+            size_t n_idx = 0;
+            size_t f_idx = 0;
+            std::pair<int, double> pair{0, 0.0};
+            try {
+                if (colon != std::string::npos) {
+                    pair.first = std::stoi(item.substr(0, colon), &n_idx);
+                    pair.second = std::stod(item.substr(colon + 1), &f_idx);
+                }
+            } catch (const std::exception&) {
+                n_idx = 0;
+            }
+            if (colon == std::string::npos || n_idx != colon || f_idx != item.size() - colon - 1 || pair.first <= 0) {
+                fail(key, item, "an n:fraction pair");
+            }
+            out.push_back(pair);
+        }
+    }
+
+    void finish() const {
+        for (size_t i = 0; i < used_.size(); ++i) {
+            if (!used_[i]) {
+                throw std::invalid_argument("pipeline: unknown parameter '" + spec_.params[i].first +
+                                            "' for filter '" + spec_.name + "'");
+            }
+        }
+    }
+
+private:
+    const StageSpec& spec_;
+    std::vector<bool> used_;
+
+    // Keys are unique within a stage (parsePipelineSpec rejects repeats).
+    const std::string* find(const char* key) {
+        for (size_t i = 0; i < spec_.params.size(); ++i) {
+            if (spec_.params[i].first == key) {
+                used_[i] = true;
+                return &spec_.params[i].second;
+            }
+        }
+        return nullptr;
+    }
+
+    [[noreturn]] void fail(const char* key, const std::string& value, const char* expected) const {
+        throw std::invalid_argument("pipeline: " + spec_.name + "." + key + "=" + value +
+                                    " is not " + expected);
+    }
+};
+
+void readConfig(ParamReader& params, C4QualityConfig& c) {
+    params.get("remove_citations", c.remove_citations);
+    params.get("filter_no_terminal_punct", c.filter_no_terminal_punct);
+    params.get("min_num_sentences", c.min_num_sentences);
+    params.get("min_words_per_line", c.min_words_per_line);
+    params.get("max_word_length", c.max_word_length);
+    params.get("filter_lorem_ipsum", c.filter_lorem_ipsum);
+    params.get("filter_javascript", c.filter_javascript);
+    params.get("filter_curly_bracket", c.filter_curly_bracket);
+    params.get("filter_policy", c.filter_policy);
+}
+
+void readConfig(ParamReader& params, GopherQualityConfig& c) {
+    params.get("min_doc_words", c.min_doc_words);
+    params.get("max_doc_words", c.max_doc_words);
+    params.get("min_avg_word_length", c.min_avg_word_length);
+    params.get("max_avg_word_length", c.max_avg_word_length);
+    params.get("max_symbol_word_ratio", c.max_symbol_word_ratio);
+    params.get("max_bullet_lines_ratio", c.max_bullet_lines_ratio);
+    params.get("max_ellipsis_lines_ratio", c.max_ellipsis_lines_ratio);
+    params.get("max_non_alpha_words_ratio", c.max_non_alpha_words_ratio);
+    params.get("min_stop_words", c.min_stop_words);
+    params.get("stop_words", c.stop_words);
+    params.get("unicode", c.unicode);
+}
+
+void readConfig(ParamReader& params, MinHashConfig& c) {
+    int seed = static_cast<int>(c.seed);
+    params.get("ngram", c.ngram);
+    params.get("num_perm", c.num_perm);
+    params.get("threshold", c.threshold);
+    params.get("bands", c.bands);
+    params.get("seed", seed);
+    params.get("max_mb", c.max_mb);
+    c.seed = static_cast<uint64_t>(seed);
+}
+
+void addStage(FilterChain& chain, const StageSpec& spec) {
+    ParamReader params(spec);
+
+    if (spec.name == "c4_quality") {
+        C4QualityConfig c;
+        readConfig(params, c);
+        params.finish();
+        chain.add("QualityFilter", C4QualityFilter(c), /*barrier=*/true);
+    } else if (spec.name == "c4_paragraph") {
+        int min_paragraphs = 3;
+        int min_paragraph_len = 200;
+        params.get("min_paragraphs", min_paragraphs);
+        params.get("min_paragraph_len", min_paragraph_len);
+        params.finish();
+        chain.add("ParagraphFilter", C4ParagraphFilter(min_paragraphs, min_paragraph_len));
+    } else if (spec.name == "c4_badwords") {
+        std::string path = "badwords_en.txt";
+        std::vector<std::string> words;
+        params.get("path", path);
+        params.get("words", words);
+        params.finish();
+        if (!words.empty()) {
+            chain.add("BadWordsFilter", C4BadWordsFilter(std::move(words)));
+        } else {
+            chain.add("BadWordsFilter", C4BadWordsFilter(path));
+        }
+    } else if (spec.name == "gopher_quality") {
+        GopherQualityConfig c;
+        readConfig(params, c);
+        params.finish();
+        chain.add("GopherQualityFilter", GopherQualityFilter(c));
+    } else if (spec.name == "gopher_repetition") {
+        GopherRepetitionConfig c;
+        params.get("dup_line_frac", c.dup_line_frac);
+        params.get("dup_para_frac", c.dup_para_frac);
+        params.get("dup_line_char_frac", c.dup_line_char_frac);
+        params.get("dup_para_char_frac", c.dup_para_char_frac);
+        params.get("top_n_grams", c.top_n_grams);
+        params.get("dup_n_grams", c.dup_n_grams);
+        params.finish();
+        chain.add("GopherRepetitionFilter", GopherRepetitionFilter(c));
+    } else if (spec.name == "fineweb_quality") {
+        FineWebQualityConfig c;
+        params.get("line_punct_thr", c.line_punct_thr);
+        params.get("line_punct_exclude_zero", c.line_punct_exclude_zero);
+        params.get("stop_chars", c.stop_chars);
+        params.get("short_line_thr", c.short_line_thr);
+        params.get("short_line_length", c.short_line_length);
+        params.get("char_duplicates_ratio", c.char_duplicates_ratio);
+        params.get("new_line_ratio", c.new_line_ratio);
+        params.finish();
+        chain.add("FineWebQualityFilter", FineWebQualityFilter(c));
+    } else if (spec.name == "exact_dedup") {
+        ExactDedupConfig c;
+        params.get("normalize", c.normalize);
+        params.get("max_mb", c.max_mb);
+        params.get("path", c.path);
+        params.finish();
+        chain.add("ExactDedupFilter", ExactDedupFilter(c), /*barrier=*/true);
+    } else if (spec.name == "minhash_dedup") {
+        MinHashConfig c;
+        readConfig(params, c);
+        params.finish();
+        chain.add("MinHashDedupFilter", MinHashDedupFilter(c), /*barrier=*/true);
+    } else if (spec.name == "line_freq_strip") {
+        LineFrequencyConfig c;
+        params.get("path", c.path);
+        params.get("max_count", c.max_count);
+        params.finish();
+        chain.add("LineFrequencyFilter", LineFrequencyFilter(c), /*barrier=*/true);
+    } else {
+        throw std::invalid_argument("pipeline: unknown filter '" + spec.name + "'");
+    }
+}
+
+} // namespace
+
+std::vector<StageSpec> parsePipelineSpec(const std::string& raw) {
+    const std::string spec = stripComments(raw);
+    std::vector<StageSpec> stages;
+    size_t i = 0;
+    const size_t n = spec.size();
+
+    auto isSeparator = [](char c) {
+        return c == ',' || c == ';' || std::isspace(static_cast<unsigned char>(c));
+    };
+
+    while (i < n) {
+        while (i < n && isSeparator(spec[i])) i++;
+        if (i == n) break;
+
+        StageSpec stage;
+        size_t start = i;
+        while (i < n && (std::isalnum(static_cast<unsigned char>(spec[i])) || spec[i] == '_')) i++;
+        stage.name = spec.substr(start, i - start);
+        if (stage.name.empty()) {
+            throw std::invalid_argument("pipeline: expected a filter name at '" + spec.substr(start, 20) + "'");
+        }
+
+        size_t after_name = i;
+        while (i < n && (spec[i] == ' ' || spec[i] == '\t')) i++;
+        if (i == n || spec[i] != '(') i = after_name;
+        if (i < n && spec[i] == '(') {
+            size_t close = spec.find(')', i);
+            if (close == std::string::npos) {
+                throw std::invalid_argument("pipeline: missing ')' after '" + stage.name + "('");
+            }
+            const std::string body = spec.substr(i + 1, close - i - 1);
+            if (body.find('(') != std::string::npos) {
+                throw std::invalid_argument("pipeline: unbalanced '(' in '" + stage.name + "(" + body + ")'");
+            }
+            std::stringstream ss(body);
+            std::string param;
+            while (std::getline(ss, param, ',')) {
+                param = trim(param);
+                if (param.empty()) continue;
+                size_t eq = param.find('=');
+                if (eq == std::string::npos) {
+                    throw std::invalid_argument("pipeline: expected key=value in '" + stage.name + "(" + param + ")'");
+                }
+                std::string key = trim(param.substr(0, eq));
+                for (const auto& seen : stage.params) {
+                    if (seen.first == key) {
+                        throw std::invalid_argument("pipeline: duplicate parameter '" + key + "' for filter '" +
+                                                    stage.name + "'");
+                    }
+                }
+                stage.params.emplace_back(std::move(key), trim(param.substr(eq + 1)));
+            }
+            i = close + 1;
+        }
+        if (i < n && !isSeparator(spec[i])) {
+            throw std::invalid_argument("pipeline: unexpected '" + std::string(1, spec[i]) + "' after '" + stage.name + "'");
+        }
+        stages.push_back(std::move(stage));
+    }
+
+    if (stages.empty()) {
+        throw std::invalid_argument("pipeline: no filters given");
+    }
+    return stages;
+}
+
+C4QualityConfig c4QualityConfig(const StageSpec& stage) {
+    ParamReader params(stage);
+    C4QualityConfig c;
+    readConfig(params, c);
+    params.finish();
+    return c;
+}
+
+MinHashConfig minHashConfig(const StageSpec& stage) {
+    ParamReader params(stage);
+    MinHashConfig c;
+    readConfig(params, c);
+    params.finish();
+    return c;
+}
+
+GopherQualityConfig gopherQualityConfig(const StageSpec& stage) {
+    ParamReader params(stage);
+    GopherQualityConfig c;
+    readConfig(params, c);
+    params.finish();
+    return c;
+}
+
+FilterChain buildPipeline(const std::string& spec) {
+    FilterChain chain;
+    for (const StageSpec& stage : parsePipelineSpec(spec)) {
+        addStage(chain, stage);
+    }
+    return chain;
+}
+
+std::string readPipelineFile(const std::string& path) {
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        throw std::invalid_argument("pipeline: could not open " + path);
+    }
+    std::stringstream buffer;
+    buffer << f.rdbuf();
+    return buffer.str();
+}
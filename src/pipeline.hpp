@@ -0,0 +1,45 @@
+#pragma once
+
+#include "filter_chain.hpp"
+#include "minhash.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+// Declarative filter pipelines.
+//
+// A spec names the filters in the order they run, each with optional
+// parameters:
+//
+//   gopher_quality(min_doc_words=50, max_symbol_word_ratio=0.1),
+//   c4_quality(min_words_per_line=3), c4_paragraph, c4_badwords(path=badwords_en.txt)
+//
+// Stages are separated by ',', ';' or newlines; '#' starts a comment that
+// runs to the end of the line, so the same syntax works for a config file.
+// List values (stop_words, words) are '|'-separated; n-gram thresholds are
+// '|'-separated n:fraction pairs (top_n_grams=2:0.2|3:0.18). Unknown filters or
+// parameters throw std::invalid_argument.
+//
+// Filters: c4_quality, c4_paragraph, c4_badwords, gopher_quality,
+// gopher_repetition, fineweb_quality, exact_dedup, minhash_dedup,
+// line_freq_strip.
+// Parameter names match the fields of the filters' config structs.
+
+struct StageSpec {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> params;
+};
+
+// The pipeline websift ran before it was configurable.
+extern const char* const kDefaultPipeline;
+
+std::vector<StageSpec> parsePipelineSpec(const std::string& spec);
+FilterChain buildPipeline(const std::string& spec);
+std::string readPipelineFile(const std::string& path);
+
+// Config of a single c4_quality / gopher_quality / minhash_dedup stage, read
+// the same way buildPipeline() reads it (tools that use the filters' stats
+// or signatures directly).
+C4QualityConfig c4QualityConfig(const StageSpec& stage);
+GopherQualityConfig gopherQualityConfig(const StageSpec& stage);
+MinHashConfig minHashConfig(const StageSpec& stage);
@@ -0,0 +1,194 @@
+#include "shard_lease.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+void makeDir(const std::string& path) {
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("work dir: cannot create " + path + ": " + std::strerror(errno));
+    }
+}
+
+bool exists(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+} // namespace
+
+ShardLeases::ShardLeases(std::string work_dir, std::string owner, double timeout_seconds)
+    : dir_(std::move(work_dir)), owner_(std::move(owner)), timeout_(timeout_seconds > 0 ? timeout_seconds : 60) {
+    // The id goes into file names (leases renamed aside, temporary files).
+    for (char& c : owner_) {
+        if (c == '/' || c == '\n' || c == ' ') c = '_';
+    }
+    while (dir_.size() > 1 && dir_.back() == '/') dir_.pop_back();
+    makeDir(dir_);
+    makeDir(dir_ + "/leases");
+    makeDir(dir_ + "/out");
+    makeDir(dir_ + "/done");
+}
+
+std::vector<std::string> ShardLeases::readManifest(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("manifest: cannot open " + path);
+    std::vector<std::string> shards;
+    std::string line;
+    while (std::getline(in, line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+        const size_t start = line.find_first_not_of(' ');
+        if (start == std::string::npos || line[start] == '#') continue;
+        shards.push_back(line.substr(start));
+    }
+    return shards;
+}
+
+std::string ShardLeases::shardName(size_t shard) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "shard-%05zu", shard);
+    return name;
+}
+
+std::string ShardLeases::leasePath(size_t shard) const { return dir_ + "/leases/" + shardName(shard) + ".lease"; }
+
+std::string ShardLeases::donePath(size_t shard) const { return dir_ + "/done/" + shardName(shard) + ".done"; }
+
+std::string ShardLeases::outputPath(size_t shard, const std::string& suffix) const {
+    return dir_ + "/out/" + shardName(shard) + suffix;
+}
+
+bool ShardLeases::isDone(size_t shard) const { return exists(donePath(shard)); }
+
+bool ShardLeases::heldId(size_t shard, FileId& id) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    const auto it = held_.find(shard);
+    if (it == held_.end()) return false;
+    id = it->second;
+    return true;
+}
+
+bool ShardLeases::owns(size_t shard) const {
+    FileId id;
+    struct stat st;
+    if (!heldId(shard, id) || stat(leasePath(shard).c_str(), &st) != 0) return false;
+    return FileId(st.st_dev, st.st_ino) == id;
+}
+
+bool ShardLeases::tryCreate(size_t shard) {
+    const std::string path = leasePath(shard);
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        if (errno == EEXIST) return false;
+        throw std::runtime_error("lease: cannot create " + path + ": " + std::strerror(errno));
+    }
+    const std::string line = owner_ + "\n";
+    struct stat st;
+    const bool ok = write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size()) && fstat(fd, &st) == 0;
+    close(fd);
+    if (!ok) {
+        unlink(path.c_str());
+        throw std::runtime_error("lease: cannot write " + path);
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    held_[shard] = FileId(st.st_dev, st.st_ino);
+    return true;
+}
+
+bool ShardLeases::takeOverIfStale(size_t shard) {
+    const std::string path = leasePath(shard);
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return tryCreate(shard); // released meanwhile
+    const double age = std::difftime(std::time(nullptr), st.st_mtime);
+    if (age < timeout_) return false;
+    // Of several workers renaming the same stale lease aside, one succeeds;
+    // the rest get ENOENT.
+    const std::string aside = path + ".stale." + owner_;
+    if (rename(path.c_str(), aside.c_str()) != 0) return false;
+    // A worker that took the lease over after our stat has a fresh one in
+    // its place: put that back. link() fails if yet another claim got there
+    // first; the holder then sees it lost the lease and drops the shard.
+    if (stat(aside.c_str(), &st) == 0 && std::difftime(std::time(nullptr), st.st_mtime) < timeout_) {
+        link(aside.c_str(), path.c_str());
+        unlink(aside.c_str());
+        return false;
+    }
+    unlink(aside.c_str());
+    return tryCreate(shard);
+}
+
+long ShardLeases::claimNext(size_t shard_count) {
+    const auto poll = std::chrono::duration<double>(std::min(1.0, timeout_ / 4));
+    while (true) {
+        bool pending = false;
+        for (size_t shard = 0; shard < shard_count; ++shard) {
+            if (isDone(shard)) continue;
+            if (tryCreate(shard) || takeOverIfStale(shard)) {
+                // Finished by its previous holder between the check and the claim.
+                if (isDone(shard)) {
+                    release(shard);
+                    continue;
+                }
+                return static_cast<long>(shard);
+            }
+            pending = true;
+        }
+        if (!pending) return -1;
+        std::this_thread::sleep_for(poll);
+    }
+}
+
+bool ShardLeases::heartbeat(size_t shard) const {
+    // Touch through an fd checked to be our inode: if the lease is taken
+    // over after the open, this renews our old file, not the new lease.
+    FileId id;
+    if (!heldId(shard, id)) return false;
+    const int fd = open(leasePath(shard).c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    const bool ours = fstat(fd, &st) == 0 && FileId(st.st_dev, st.st_ino) == id;
+    const bool ok = ours && futimens(fd, nullptr) == 0;
+    close(fd);
+    return ok;
+}
+
+bool ShardLeases::publish(size_t shard, const std::string& tmp_path, const std::string& path) const {
+    if (!owns(shard)) return false;
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("output: cannot move " + tmp_path + " to " + path + ": " + std::strerror(errno));
+    }
+    return true;
+}
+
+bool ShardLeases::markDone(size_t shard) {
+    const std::string path = donePath(shard);
+    const std::string tmp = path + ".tmp." + owner_;
+    {
+        std::ofstream out(tmp);
+        out << owner_ << "\n";
+        if (!out) throw std::runtime_error("done marker: cannot write " + tmp);
+    }
+    if (!publish(shard, tmp, path)) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    release(shard);
+    return true;
+}
+
+void ShardLeases::release(size_t shard) {
+    if (owns(shard)) unlink(leasePath(shard).c_str());
+    std::lock_guard<std::mutex> lock(mu_);
+    held_.erase(shard);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+// Splits the shards of a manifest between any number of worker processes
+// (on one machine, or many sharing a filesystem) through files in a shared
+// work directory; there is no coordinator process:
+//
+//   <work>/leases/<shard>.lease  held by one worker; the file holds its id
+//                                and its mtime is the worker's heartbeat
+//   <work>/out/<shard>.*         the shard's outputs and stats
+//   <work>/done/<shard>.done     written once the outputs are in place
+//
+// A worker claims a shard by creating its lease with O_EXCL. A lease whose
+// heartbeat is older than the timeout belongs to a dead worker and is taken
+// over: it is renamed aside, which only one of several racing workers can
+// do, and then claimed afresh. Outputs are written under temporary names
+// and renamed into place before the done marker, so a shard is either
+// complete or absent. A worker that finds its lease taken over (it stalled
+// past the timeout) drops its outputs.
+//
+// A lease is held while the lease file is the inode this worker created,
+// so a heartbeat (futimens on an fd checked to be that inode) can never
+// renew another worker's lease. Publishing is not atomic with the check:
+// each rename is preceded by one, and the caller renews the lease just
+// before publishing, so a takeover in between needs this worker to stall
+// for a whole timeout across a few renames.
+//
+// Heartbeats compare file mtimes with the local clock, so the workers'
+// clocks must agree to well within the timeout.
+class ShardLeases {
+public:
+    // Creates the work directory layout if needed; throws
+    // std::runtime_error if it cannot.
+    ShardLeases(std::string work_dir, std::string owner, double timeout_seconds);
+
+    // Shard paths, one per line; blank lines and '#' comments are skipped.
+    // Throws std::runtime_error if the file cannot be read.
+    static std::vector<std::string> readManifest(const std::string& path);
+
+    // "shard-00042": the name of shard i's files.
+    static std::string shardName(size_t shard);
+
+    // A shard this worker now holds, or -1 once every shard is done.
+    // While the remaining shards are all leased by live workers it polls,
+    // so it can take over from one that dies.
+    long claimNext(size_t shard_count);
+
+    // Renews the lease; false if this worker no longer holds it.
+    bool heartbeat(size_t shard) const;
+    // True while the lease file is still the one this worker created.
+    bool owns(size_t shard) const;
+    bool isDone(size_t shard) const;
+
+    // Path under <work>/out for one of the shard's outputs.
+    std::string outputPath(size_t shard, const std::string& suffix) const;
+    // Moves a finished output from its temporary name into place; false
+    // (and nothing moved) if the lease is no longer held. I/O errors throw.
+    bool publish(size_t shard, const std::string& tmp_path, const std::string& path) const;
+    // Writes the done marker and drops the lease; false (and no marker) if
+    // the lease is no longer held.
+    bool markDone(size_t shard);
+    // Drops the lease without marking the shard done (on failure).
+    void release(size_t shard);
+
+    const std::string& owner() const { return owner_; }
+    double timeout() const { return timeout_; }
+
+private:
+    std::string leasePath(size_t shard) const;
+    std::string donePath(size_t shard) const;
+    bool tryCreate(size_t shard);
+    bool takeOverIfStale(size_t shard);
+
+    using FileId = std::pair<dev_t, ino_t>;
+    bool heldId(size_t shard, FileId& id) const;
+
+    std::string dir_;
+    std::string owner_;
+    double timeout_;
+    mutable std::mutex mu_; // held_: the heartbeat thread reads it
+    std::map<size_t, FileId> held_;
+};
@@ -0,0 +1,386 @@
+#pragma once
+
+#include "auto_tuner.hpp"
+#include "bounded_queue.hpp"
+#include "work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A line of processing stages over reusable blocks. Sources fill blocks and
+// emit them; each block then passes through every stage in the order they
+// were added and finally returns, clear()ed, to its source's free list.
+//
+// A stage runs with its own parallelism:
+//  - threads == 0: inline, on the thread that hands it the block, one block
+//    at a time; a graph whose stages are all inline runs entirely on its
+//    source thread, with no queues or threads at all;
+//  - threads > 0: its own workers (a WorkStealingPool per lane), which with
+//    grain > 0 share the items of a block in ranges of `grain`;
+//  - ordered: blocks are handed to the stage in emit order (inline or one
+//    thread), as writers need.
+//
+// Backpressure comes from the blocks themselves: each lane owns at most
+// `blocks_per_lane` of them (and, with setByteLimit, the emitted ones hold
+// at most that many bytes), so a source waits for a block to come back
+// rather than queueing without bound. Every channel has room for all of a
+// lane's blocks, so stages never wait on each other and a slow stage only
+// holds up the sources.
+//
+// Lanes (NUMA nodes, say) partition a stage's workers and the blocks: a
+// block emitted on a lane runs on that lane's workers of every unordered
+// stage and comes back to that lane's free list.
+//
+// Blocks must have clear(). Add every stage before creating a source.
+template <typename Block>
+class StageGraph {
+    // A block and what the graph tracks about it.
+    struct Envelope {
+        Block block;
+        uint64_t seq = 0;
+        unsigned lane = 0;
+        size_t items = 0;
+        size_t bytes = 0;
+    };
+
+public:
+    // run(worker, block, begin, end): items [begin, end) of the block, or
+    // the whole block (begin 0, end its item count) for unsplit stages.
+    // Workers are numbered across lanes, lane 0 first.
+    using RunFn = std::function<void(unsigned, Block&, size_t, size_t)>;
+    // start(lane, worker) runs first on each worker thread.
+    using StartFn = std::function<void(unsigned, unsigned)>;
+
+    struct StageOptions {
+        unsigned threads = 0;               // 0: inline
+        std::vector<unsigned> lane_threads; // workers per lane; default: threads spread evenly
+        size_t grain = 0;                   // 0: whole blocks
+        bool ordered = false;
+        StartFn start;
+    };
+
+    // Per stage; the sources appear first, as one stage named at
+    // construction.
+    struct StageMetrics {
+        std::string name;
+        unsigned threads = 0;
+        uint64_t blocks = 0;
+        uint64_t items = 0;
+        double busy_seconds = 0; // running the stage, summed over workers; sources: filling blocks
+        double wait_seconds = 0; // stages: workers waiting for blocks; sources: waiting for a free block or bytes
+    };
+
+    StageGraph(std::string source_name, unsigned lanes, size_t blocks_per_lane)
+        : source_name_(std::move(source_name)), lanes_(std::max(1u, lanes)), cap_(std::max<size_t>(1, blocks_per_lane)),
+          created_(lanes_) {
+        for (unsigned l = 0; l < lanes_; ++l) free_.push_back(std::make_unique<BoundedQueue<Envelope*>>(cap_));
+    }
+
+    ~StageGraph() { finish(); }
+
+    StageGraph(const StageGraph&) = delete;
+    StageGraph& operator=(const StageGraph&) = delete;
+
+    unsigned lanes() const { return lanes_; }
+
+    // Returns the stage's index. Throws std::invalid_argument for an
+    // ordered stage with more than one worker.
+    size_t addStage(std::string name, StageOptions options, RunFn run) {
+        if (options.ordered && (options.threads > 1 || options.grain > 0)) {
+            throw std::invalid_argument("stage " + name + ": an ordered stage runs whole blocks on at most one thread");
+        }
+        auto stage = std::make_unique<Stage>();
+        stage->name = std::move(name);
+        stage->run = std::move(run);
+        stage->ordered = options.ordered;
+        stage->grain = options.grain;
+        const size_t k = stages_.size();
+        if (options.threads > 0) {
+            std::vector<unsigned> split = options.lane_threads;
+            const unsigned poolCount = options.ordered ? 1 : lanes_;
+            if (split.size() != poolCount) {
+                split.assign(poolCount, 0);
+                for (unsigned t = 0; t < options.threads; ++t) split[t % poolCount]++;
+            }
+            unsigned first = 0;
+            for (unsigned l = 0; l < poolCount; ++l) {
+                const unsigned threads = std::max(1u, split[l]);
+                StartFn start = options.start;
+                stage->pools.push_back(std::make_unique<WorkStealingPool<Envelope*>>(
+                    threads, stage->grain ? stage->grain : 1, cap_ * lanes_,
+                    [this, k, first](unsigned w, Envelope*& env, size_t begin, size_t end) { runRange(k, first + w, *env, begin, end); },
+                    [this, k](unsigned, Envelope*& env) { stageDone(k, env); },
+                    [start, l, first](unsigned w) {
+                        if (start) start(l, first + w);
+                    }));
+                first += threads;
+            }
+            stage->threads = first;
+        }
+        stages_.push_back(std::move(stage));
+        return k;
+    }
+
+    // A source's handle, used from one thread: fill block() and emit() it.
+    class Source {
+    public:
+        Source(StageGraph& graph, unsigned lane)
+            : graph_(graph), lane_(lane % graph.lanes_), mark_(std::chrono::steady_clock::now()) {
+            graph_.sources_.fetch_add(1, std::memory_order_relaxed);
+        }
+        ~Source() {
+            leaveBody();
+            if (env_) graph_.recycle(env_);
+        }
+        Source(const Source&) = delete;
+        Source& operator=(const Source&) = delete;
+
+        // The block being filled (taken on first use after an emit; may
+        // wait for one to come back).
+        Block& block() {
+            if (!env_) {
+                leaveBody();
+                env_ = graph_.take(lane_);
+                mark_ = std::chrono::steady_clock::now();
+            }
+            return env_->block;
+        }
+
+        // Emit the following blocks on another lane (to deal them out).
+        void setLane(unsigned lane) {
+            lane %= graph_.lanes_;
+            if (env_ && env_->lane != lane) {
+                graph_.recycle(env_);
+                env_ = nullptr;
+            }
+            lane_ = lane;
+        }
+
+        // Hands the block with `items` items and `bytes` bytes to the first
+        // stage.
+        void emit(size_t items, size_t bytes) {
+            block();
+            leaveBody();
+            Envelope* env = env_;
+            env_ = nullptr;
+            env->items = items;
+            env->bytes = bytes;
+            graph_.emit(env);
+            mark_ = std::chrono::steady_clock::now();
+        }
+
+    private:
+        // The source's busy time is its own code: everything but waiting
+        // for blocks or bytes and the inline stages emit() runs.
+        void leaveBody() { graph_.source_busy_ns_.fetch_add(nanosSince(mark_), std::memory_order_relaxed); }
+
+        StageGraph& graph_;
+        unsigned lane_;
+        Envelope* env_ = nullptr;
+        std::chrono::steady_clock::time_point mark_;
+    };
+
+    // Caps the bytes of emitted blocks not yet back in a free list.
+    void setByteLimit(size_t bytes) {
+        if (!inflight_) {
+            inflight_ = std::make_unique<InflightLimit>(bytes);
+        } else {
+            inflight_->setLimit(bytes);
+        }
+    }
+    InflightLimit* inflight() { return inflight_.get(); }
+
+    // Workers of a threaded stage allowed to take blocks, spread over its
+    // lanes like its threads.
+    void setActive(size_t stage, unsigned workers) {
+        Stage& s = *stages_.at(stage);
+        if (s.threads == 0) return;
+        for (auto& pool : s.pools) {
+            pool->setActive(static_cast<unsigned>((uint64_t{workers} * pool->size() + s.threads - 1) / s.threads));
+        }
+    }
+
+    // Seconds the stage's workers waited for blocks so far.
+    double idleSeconds(size_t stage) const {
+        double idle = 0;
+        for (const auto& pool : stages_.at(stage)->pools) idle += pool->idleSeconds();
+        return idle;
+    }
+    // Seconds the sources waited for room under the byte limit (the stall
+    // AutoTuner reads), and for a free block to come back; both include
+    // waits still in progress.
+    double stallSeconds() const { return inflight_ ? inflight_->stallSeconds() : 0.0; }
+    double blockWaitSeconds() const { return block_wait_.seconds(); }
+
+    // Call once every source is done: runs what was emitted through all
+    // stages and stops the workers.
+    void finish() {
+        for (auto& stage : stages_) {
+            for (auto& pool : stage->pools) pool->close();
+        }
+    }
+
+    std::vector<StageMetrics> metrics() const {
+        std::vector<StageMetrics> out;
+        StageMetrics source;
+        source.name = source_name_;
+        source.threads = sources_.load(std::memory_order_relaxed);
+        source.blocks = emitted_.load(std::memory_order_relaxed);
+        source.items = emitted_items_.load(std::memory_order_relaxed);
+        source.busy_seconds = source_busy_ns_.load(std::memory_order_relaxed) * 1e-9;
+        source.wait_seconds = stallSeconds() + blockWaitSeconds();
+        out.push_back(source);
+        for (size_t k = 0; k < stages_.size(); ++k) {
+            const Stage& s = *stages_[k];
+            StageMetrics m;
+            m.name = s.name;
+            m.threads = s.threads;
+            m.blocks = s.blocks.load(std::memory_order_relaxed);
+            m.items = s.items.load(std::memory_order_relaxed);
+            m.busy_seconds = s.busy_ns.load(std::memory_order_relaxed) * 1e-9;
+            m.wait_seconds = idleSeconds(k);
+            out.push_back(m);
+        }
+        return out;
+    }
+
+private:
+    struct Stage {
+        std::string name;
+        RunFn run;
+        bool ordered = false;
+        size_t grain = 0;
+        unsigned threads = 0;
+        std::vector<std::unique_ptr<WorkStealingPool<Envelope*>>> pools;
+        std::mutex inline_mu;
+        // Ordered stages: blocks that arrived ahead of their turn.
+        std::mutex order_mu;
+        std::map<uint64_t, Envelope*> pending;
+        uint64_t next_seq = 0;
+        bool draining = false;
+        std::atomic<uint64_t> blocks{0};
+        std::atomic<uint64_t> items{0};
+        std::atomic<uint64_t> busy_ns{0};
+    };
+
+    static uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    Envelope* take(unsigned lane) {
+        Envelope* env = nullptr;
+        if (free_[lane]->tryPop(env)) return env;
+        {
+            std::lock_guard<std::mutex> lk(all_mu_);
+            if (created_[lane] < cap_) {
+                created_[lane]++;
+                all_.push_back(std::make_unique<Envelope>());
+                all_.back()->lane = lane;
+                return all_.back().get();
+            }
+        }
+        const auto start = block_wait_.begin();
+        free_[lane]->pop(env);
+        block_wait_.end(start);
+        return env;
+    }
+
+    void emit(Envelope* env) {
+        if (inflight_) inflight_->acquire(env->bytes);
+        env->seq = next_seq_.fetch_add(1, std::memory_order_relaxed);
+        emitted_.fetch_add(1, std::memory_order_relaxed);
+        emitted_items_.fetch_add(env->items, std::memory_order_relaxed);
+        forward(0, env);
+    }
+
+    void forward(size_t k, Envelope* env) {
+        if (k == stages_.size()) {
+            recycle(env, true);
+            return;
+        }
+        Stage& s = *stages_[k];
+        if (!s.ordered) {
+            deliver(k, env);
+            return;
+        }
+        // Whoever finds the next block in line delivers it and every block
+        // queued behind it; the others only leave theirs in pending.
+        std::unique_lock<std::mutex> lk(s.order_mu);
+        s.pending.emplace(env->seq, env);
+        if (s.draining) return;
+        s.draining = true;
+        while (!s.pending.empty() && s.pending.begin()->first == s.next_seq) {
+            Envelope* next = s.pending.begin()->second;
+            s.pending.erase(s.pending.begin());
+            s.next_seq++;
+            lk.unlock();
+            deliver(k, next);
+            lk.lock();
+        }
+        s.draining = false;
+    }
+
+    void deliver(size_t k, Envelope* env) {
+        Stage& s = *stages_[k];
+        if (s.threads > 0) {
+            auto& pool = s.pools[s.ordered ? 0 : env->lane];
+            pool->submit(std::move(env), s.grain ? env->items : 1);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lk(s.inline_mu);
+            runRange(k, 0, *env, 0, env->items, false);
+        }
+        stageDone(k, env);
+    }
+
+    void runRange(size_t k, unsigned worker, Envelope& env, size_t begin, size_t end, bool pooled = true) {
+        Stage& s = *stages_[k];
+        if (pooled && !s.grain) {
+            begin = 0;
+            end = env.items;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        s.run(worker, env.block, begin, end);
+        s.busy_ns.fetch_add(nanosSince(start), std::memory_order_relaxed);
+        s.items.fetch_add(end - begin, std::memory_order_relaxed);
+    }
+
+    void stageDone(size_t k, Envelope* env) {
+        stages_[k]->blocks.fetch_add(1, std::memory_order_relaxed);
+        forward(k + 1, env);
+    }
+
+    void recycle(Envelope* env, bool emitted = false) {
+        env->block.clear();
+        if (emitted && inflight_) inflight_->release(env->bytes);
+        free_[env->lane]->tryPush(std::move(env));
+    }
+
+    const std::string source_name_;
+    const unsigned lanes_;
+    const size_t cap_;
+    std::vector<std::unique_ptr<Stage>> stages_;
+    std::vector<std::unique_ptr<BoundedQueue<Envelope*>>> free_;
+    std::mutex all_mu_;
+    std::vector<std::unique_ptr<Envelope>> all_;
+    std::vector<size_t> created_;
+    std::unique_ptr<InflightLimit> inflight_;
+    std::atomic<uint64_t> next_seq_{0};
+    std::atomic<unsigned> sources_{0};
+    std::atomic<uint64_t> emitted_{0};
+    std::atomic<uint64_t> emitted_items_{0};
+    WaitClock block_wait_;
+    std::atomic<uint64_t> source_busy_ns_{0};
+};
@@ -0,0 +1,82 @@
+#include "stats_file.hpp"
+#include "pipeline.hpp"
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+
+// Applies a threshold set to a stats file written by `websift --stats-output`
+// and prints the same summary websift would have printed.
+int main(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+
+    std::string input;
+    std::string spec = "gopher_quality";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--pipeline" && i + 1 < argc) {
+            spec = argv[++i];
+        } else if (arg == "--pipeline-file" && i + 1 < argc) {
+            try {
+                spec = readPipelineFile(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        } else if (arg[0] != '-' && input.empty()) {
+            input = arg;
+        } else {
+            input.clear();
+            break;
+        }
+    }
+    if (input.empty()) {
+        std::cerr << "Usage: stats_eval <stats.bin> [--pipeline spec | --pipeline-file path]" << std::endl;
+        return 1;
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    size_t totalDocs = 0;
+    size_t keptDocs = 0;
+    std::array<size_t, kDropReasonCount> drops{};
+    try {
+        StatsEvaluator evaluator(spec);
+        StatsReader reader(input);
+        evaluator.checkSettings(reader.settings());
+        StatsColumns group;
+        std::vector<Verdict> verdicts;
+        while (reader.next(group)) {
+            evaluator.evaluate(group, verdicts);
+            totalDocs += verdicts.size();
+            for (const Verdict& v : verdicts) {
+                if (v.keep) {
+                    keptDocs++;
+                } else {
+                    drops[static_cast<size_t>(v.reason)]++;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+
+    std::cout << "Evaluated in " << elapsed.count() << " seconds." << std::endl;
+    std::cout << "Total Docs: " << totalDocs << std::endl;
+    std::cout << "Kept Docs: " << keptDocs << std::endl;
+    std::cout << "Dropped Docs: " << (totalDocs - keptDocs) << std::endl;
+
+    std::map<std::string, size_t> reasons;
+    for (size_t r = 0; r < kDropReasonCount; ++r) {
+        if (drops[r]) reasons[formatDropReason(static_cast<DropReason>(r))] += drops[r];
+    }
+    std::cout << "\nDrop Reasons:" << std::endl;
+    for (const auto& pair : reasons) {
+        std::cout << "  " << pair.first << ": " << pair.second << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,371 @@
+#include "stats_file.hpp"
+#include "pipeline.hpp"
+#include <cstring>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[8] = {'W', 'S', 'S', 'T', 'A', 'T', 'S', '2'};
+
+GopherQualityConfig gopherConfigOf(const std::string& spec) {
+    for (const StageSpec& stage : parsePipelineSpec(spec)) {
+        if (stage.name == "gopher_quality") return gopherQualityConfig(stage);
+    }
+    return GopherQualityConfig();
+}
+
+C4QualityConfig c4ConfigOf(const std::string& spec) {
+    for (const StageSpec& stage : parsePipelineSpec(spec)) {
+        if (stage.name == "c4_quality") return c4QualityConfig(stage);
+    }
+    return C4QualityConfig();
+}
+
+// "stage.param" -> value, from StatsCollector::settings().
+std::map<std::string, std::string> parseSettings(const std::string& settings) {
+    std::map<std::string, std::string> out;
+    std::istringstream in(settings);
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t eq = line.find('=');
+        if (eq != std::string::npos) out[line.substr(0, eq)] = line.substr(eq + 1);
+    }
+    return out;
+}
+
+template <typename T>
+void writePod(std::ofstream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <typename T>
+bool readPod(std::ifstream& in, T& v) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(v)));
+}
+
+} // namespace
+
+// StatsColumns
+const char* const StatsColumns::kColumnNames[StatsColumns::kColumns] = {
+    "bytes",
+    "words",
+    "non_symbol_words",
+    "non_symbol_chars",
+    "alpha_words",
+    "stop_words",
+    "hashes",
+    "ellipsis_tokens",
+    "lines",
+    "bullet_lines",
+    "ellipsis_lines",
+    "c4_sentences",
+    "c4_early_drop",
+};
+
+void StatsColumns::clear() {
+    for (auto& c : columns_) c.clear();
+}
+
+void StatsColumns::append(const DocStats& s) {
+    const uint32_t values[kColumns] = {
+        s.bytes,
+        s.gopher.words,
+        s.gopher.non_symbol_words,
+        s.gopher.non_symbol_chars,
+        s.gopher.alpha_words,
+        s.gopher.stop_words,
+        s.gopher.hashes,
+        s.gopher.ellipsis_tokens,
+        s.gopher.lines,
+        s.gopher.bullet_lines,
+        s.gopher.ellipsis_lines,
+        s.c4.sentences,
+        static_cast<uint32_t>(s.c4.early_drop),
+    };
+    for (size_t c = 0; c < kColumns; ++c) columns_[c].push_back(values[c]);
+}
+
+void StatsColumns::append(const StatsColumns& other) {
+    for (size_t c = 0; c < kColumns; ++c) {
+        columns_[c].insert(columns_[c].end(), other.columns_[c].begin(), other.columns_[c].end());
+    }
+}
+
+DocStats StatsColumns::row(size_t i) const {
+    DocStats s;
+    s.bytes = columns_[kBytes][i];
+    s.gopher.words = columns_[kWords][i];
+    s.gopher.non_symbol_words = columns_[kNonSymbolWords][i];
+    s.gopher.non_symbol_chars = columns_[kNonSymbolChars][i];
+    s.gopher.alpha_words = columns_[kAlphaWords][i];
+    s.gopher.stop_words = columns_[kStopWords][i];
+    s.gopher.hashes = columns_[kHashes][i];
+    s.gopher.ellipsis_tokens = columns_[kEllipsisTokens][i];
+    s.gopher.lines = columns_[kLines][i];
+    s.gopher.bullet_lines = columns_[kBulletLines][i];
+    s.gopher.ellipsis_lines = columns_[kEllipsisLines][i];
+    s.c4.sentences = columns_[kC4Sentences][i];
+    s.c4.early_drop = static_cast<DropReason>(columns_[kC4EarlyDrop][i]);
+    return s;
+}
+
+// StatsCollector
+StatsCollector::StatsCollector(const std::string& spec, bool with_c4)
+    : gopher_config_(gopherConfigOf(spec)),
+      c4_config_(c4ConfigOf(spec)),
+      gopher_(gopher_config_),
+      c4_(c4_config_),
+      with_c4_(with_c4) {}
+
+DocStats StatsCollector::compute(const DocumentAnalysis& doc) const {
+    DocStats s;
+    s.bytes = static_cast<uint32_t>(doc.size());
+    s.gopher = gopher_.computeStats(doc);
+    if (with_c4_) s.c4 = c4_.computeStats(doc);
+    return s;
+}
+
+bool StatsCollector::collects(const std::string& spec) const {
+    return StatsCollector(spec, with_c4_).settings() == settings();
+}
+
+std::string StatsCollector::settings() const {
+    std::string stop_words;
+    for (const std::string& w : gopher_config_.stop_words) stop_words += (stop_words.empty() ? "" : "|") + w;
+    const C4QualityConfig& c = c4_config_;
+    std::ostringstream out;
+    out << "gopher_quality.stop_words=" << stop_words << "\n"
+        << "gopher_quality.unicode=" << gopher_config_.unicode << "\n"
+        << "c4_quality.collected=" << with_c4_ << "\n"
+        << "c4_quality.remove_citations=" << c.remove_citations << "\n"
+        << "c4_quality.filter_no_terminal_punct=" << c.filter_no_terminal_punct << "\n"
+        << "c4_quality.min_words_per_line=" << c.min_words_per_line << "\n"
+        << "c4_quality.max_word_length=" << c.max_word_length << "\n"
+        << "c4_quality.filter_lorem_ipsum=" << c.filter_lorem_ipsum << "\n"
+        << "c4_quality.filter_javascript=" << c.filter_javascript << "\n"
+        << "c4_quality.filter_curly_bracket=" << c.filter_curly_bracket << "\n"
+        << "c4_quality.filter_policy=" << c.filter_policy << "\n";
+    return out.str();
+}
+
+// StatsEvaluator
+StatsEvaluator::StatsEvaluator(const std::string& spec) : spec_(spec) {
+    bool after_rewrite = false;
+    for (const StageSpec& stage : parsePipelineSpec(spec)) {
+        if (stage.name == "gopher_quality") {
+            // Stats are taken on the original text, not on what c4_quality
+            // leaves behind.
+            if (after_rewrite) {
+                throw std::invalid_argument("stats: gopher_quality after c4_quality needs the rewritten text; "
+                                            "list it first");
+            }
+            addGopherChecks(gopherQualityConfig(stage));
+        } else if (stage.name == "c4_quality") {
+            after_rewrite = true;
+            addC4Checks(c4QualityConfig(stage));
+        } else {
+            throw std::invalid_argument("stats: filter '" + stage.name + "' cannot be evaluated from stats");
+        }
+    }
+}
+
+// The tests of GopherQualityFilter::checkWords, checkSymbols and
+// checkLines, in that order; a zero threshold disables its test there too.
+void StatsEvaluator::addGopherChecks(const GopherQualityConfig& c) {
+    using C = StatsColumns;
+    checks_.push_back({Check::Zero, C::kWords, DropReason::GopherShortDoc});
+    if (c.min_doc_words) checks_.push_back({Check::Below, C::kNonSymbolWords, DropReason::GopherShortDoc, double(c.min_doc_words)});
+    if (c.max_doc_words) checks_.push_back({Check::Above, C::kNonSymbolWords, DropReason::GopherLongDoc, double(c.max_doc_words)});
+    if (c.min_avg_word_length) {
+        checks_.push_back({Check::RatioBelow, C::kNonSymbolChars, DropReason::GopherBelowAvgThreshold,
+                           double(c.min_avg_word_length), C::kNonSymbolWords});
+    }
+    if (c.max_avg_word_length) {
+        checks_.push_back({Check::RatioAbove, C::kNonSymbolChars, DropReason::GopherAboveAvgThreshold,
+                           double(c.max_avg_word_length), C::kNonSymbolWords});
+    }
+    if (c.max_symbol_word_ratio) {
+        checks_.push_back({Check::RatioAbove, C::kHashes, DropReason::GopherTooManyHashes, c.max_symbol_word_ratio, C::kWords});
+        checks_.push_back({Check::RatioAbove, C::kEllipsisTokens, DropReason::GopherTooManyEllipsis, c.max_symbol_word_ratio, C::kWords});
+    }
+    checks_.push_back({Check::Zero, C::kLines, DropReason::GopherShortDoc});
+    if (c.max_bullet_lines_ratio) {
+        checks_.push_back({Check::RatioAbove, C::kBulletLines, DropReason::GopherTooManyBullets, c.max_bullet_lines_ratio, C::kLines});
+    }
+    if (c.max_ellipsis_lines_ratio) {
+        checks_.push_back({Check::RatioAbove, C::kEllipsisLines, DropReason::GopherTooManyEndEllipsis,
+                           c.max_ellipsis_lines_ratio, C::kLines});
+    }
+    if (c.max_non_alpha_words_ratio) {
+        checks_.push_back({Check::RatioBelow, C::kAlphaWords, DropReason::GopherBelowAlphaThreshold,
+                           c.max_non_alpha_words_ratio, C::kWords});
+    }
+    if (c.min_stop_words) checks_.push_back({Check::Below, C::kStopWords, DropReason::GopherEnoughStopWords, double(c.min_stop_words)});
+}
+
+// C4QualityFilter::evaluate.
+void StatsEvaluator::addC4Checks(const C4QualityConfig& c) {
+    checks_.push_back({Check::EarlyDrop, StatsColumns::kC4EarlyDrop, DropReason::None});
+    if (c.min_num_sentences != -1) {
+        checks_.push_back({Check::Below, StatsColumns::kC4Sentences, DropReason::TooFewSentences, double(c.min_num_sentences)});
+    }
+}
+
+void StatsEvaluator::checkSettings(const std::string& settings) const {
+    const std::map<std::string, std::string> collected = parseSettings(settings);
+    std::set<std::string> stages;
+    for (const StageSpec& stage : parsePipelineSpec(spec_)) stages.insert(stage.name);
+    // Only the settings of stages the spec runs matter.
+    for (const auto& wanted : parseSettings(StatsCollector(spec_).settings())) {
+        const std::string stage = wanted.first.substr(0, wanted.first.find('.'));
+        if (!stages.count(stage)) continue;
+        const auto it = collected.find(wanted.first);
+        if (it == collected.end() || it->second != wanted.second) {
+            throw std::invalid_argument("stats: the file was collected with " + wanted.first + "=" +
+                                        (it == collected.end() ? "?" : it->second) + " but the spec needs " +
+                                        wanted.second + "; only thresholds can change after collection");
+        }
+    }
+}
+
+void StatsEvaluator::evaluate(const StatsColumns& group, std::vector<Verdict>& out) const {
+    const size_t n = group.rows();
+    out.assign(n, Verdict{true});
+    const uint32_t* bytes = group.column(StatsColumns::kBytes).data();
+    for (size_t i = 0; i < n; ++i) {
+        if (bytes[i] == 0) out[i] = Verdict{false, DropReason::EmptyText};
+    }
+    // One pass per threshold over its columns.
+    for (const Check& check : checks_) {
+        const uint32_t* col = group.column(check.column).data();
+        const uint32_t* den = group.column(check.denominator).data();
+        const double limit = check.limit;
+        auto pass = [&](auto drops) {
+            for (size_t i = 0; i < n; ++i) {
+                if (out[i].keep && drops(i)) out[i] = Verdict{false, check.reason};
+            }
+        };
+        switch (check.kind) {
+        case Check::Zero:
+            pass([&](size_t i) { return col[i] == 0; });
+            break;
+        case Check::Below:
+            pass([&](size_t i) { return double(col[i]) < limit; });
+            break;
+        case Check::Above:
+            pass([&](size_t i) { return double(col[i]) > limit; });
+            break;
+        case Check::RatioBelow:
+            pass([&](size_t i) { return den[i] == 0 || double(col[i]) / double(den[i]) < limit; });
+            break;
+        case Check::RatioAbove:
+            pass([&](size_t i) { return den[i] != 0 && double(col[i]) / double(den[i]) > limit; });
+            break;
+        case Check::EarlyDrop:
+            for (size_t i = 0; i < n; ++i) {
+                if (out[i].keep && col[i] != 0) out[i] = Verdict{false, static_cast<DropReason>(col[i])};
+            }
+            break;
+        }
+    }
+}
+
+// StatsWriter
+StatsWriter::StatsWriter(const std::string& path, const std::string& settings) : out_(path, std::ios::binary) {
+    if (!out_.is_open()) {
+        throw std::runtime_error("stats: could not open " + path + " for writing");
+    }
+    out_.write(kMagic, sizeof(kMagic));
+    writePod(out_, static_cast<uint32_t>(StatsColumns::kColumns));
+    for (const char* name : StatsColumns::kColumnNames) {
+        const uint16_t len = static_cast<uint16_t>(std::strlen(name));
+        writePod(out_, len);
+        out_.write(name, len);
+    }
+    writePod(out_, static_cast<uint32_t>(settings.size()));
+    out_.write(settings.data(), static_cast<std::streamsize>(settings.size()));
+}
+
+StatsWriter::~StatsWriter() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // Destructors must not throw; call close() to see write errors.
+    }
+}
+
+void StatsWriter::append(const DocStats& stats) {
+    pending_.append(stats);
+    if (pending_.rows() >= kRowGroupRows) flushGroup();
+}
+
+void StatsWriter::append(const StatsColumns& rows) {
+    pending_.append(rows);
+    if (pending_.rows() >= kRowGroupRows) flushGroup();
+}
+
+void StatsWriter::flushGroup() {
+    if (pending_.rows() == 0) return;
+    const uint32_t rows = static_cast<uint32_t>(pending_.rows());
+    writePod(out_, rows);
+    for (size_t c = 0; c < StatsColumns::kColumns; ++c) {
+        const std::vector<uint32_t>& col = pending_.column(c);
+        out_.write(reinterpret_cast<const char*>(col.data()), static_cast<std::streamsize>(col.size() * sizeof(uint32_t)));
+    }
+    if (!out_) throw std::runtime_error("stats: write failed");
+    rows_written_ += rows;
+    pending_.clear();
+}
+
+void StatsWriter::close() {
+    if (!out_.is_open()) return;
+    flushGroup();
+    out_.close();
+}
+
+// StatsReader
+StatsReader::StatsReader(const std::string& path) : in_(path, std::ios::binary), path_(path) {
+    if (!in_.is_open()) {
+        throw std::runtime_error("stats: could not open " + path);
+    }
+    char magic[sizeof(kMagic)];
+    uint32_t columns = 0;
+    if (!in_.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !readPod(in_, columns) || columns != StatsColumns::kColumns) {
+        throw std::runtime_error("stats: " + path + " is not a stats file of this version");
+    }
+    for (const char* expected : StatsColumns::kColumnNames) {
+        uint16_t len = 0;
+        std::string name;
+        if (readPod(in_, len)) {
+            name.resize(len);
+            in_.read(&name[0], len);
+        }
+        if (!in_ || name != expected) {
+            throw std::runtime_error("stats: unexpected column '" + name + "' in " + path);
+        }
+    }
+    uint32_t len = 0;
+    if (readPod(in_, len)) {
+        settings_.resize(len);
+        in_.read(&settings_[0], len);
+    }
+    if (!in_) throw std::runtime_error("stats: truncated header in " + path);
+}
+
+bool StatsReader::next(StatsColumns& group) {
+    group.clear();
+    uint32_t rows = 0;
+    if (!readPod(in_, rows)) return false;
+    for (size_t c = 0; c < StatsColumns::kColumns; ++c) {
+        std::vector<uint32_t>& col = group.column(c);
+        col.resize(rows);
+        if (!in_.read(reinterpret_cast<char*>(col.data()), static_cast<std::streamsize>(rows * sizeof(uint32_t)))) {
+            throw std::runtime_error("stats: truncated row group in " + path_);
+        }
+    }
+    return true;
+}
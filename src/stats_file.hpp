@@ -0,0 +1,152 @@
+#pragma once
+
+#include "document.hpp"
+#include "filters.hpp"
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Per-document filter statistics for threshold sweeps: computed once from
+// the text, then any threshold set can be applied to them without the text.
+struct DocStats {
+    uint32_t bytes = 0;
+    GopherQualityStats gopher;
+    C4QualityStats c4;
+};
+
+// A block of DocStats stored column by column.
+class StatsColumns {
+public:
+    enum Column : size_t {
+        kBytes,
+        kWords,
+        kNonSymbolWords,
+        kNonSymbolChars,
+        kAlphaWords,
+        kStopWords,
+        kHashes,
+        kEllipsisTokens,
+        kLines,
+        kBulletLines,
+        kEllipsisLines,
+        kC4Sentences,
+        kC4EarlyDrop,
+        kColumns
+    };
+    static const char* const kColumnNames[kColumns];
+
+    void clear();
+    void append(const DocStats& stats);
+    void append(const StatsColumns& other);
+    size_t rows() const { return columns_[0].size(); }
+    DocStats row(size_t i) const;
+
+    std::vector<uint32_t>& column(size_t c) { return columns_[c]; }
+    const std::vector<uint32_t>& column(size_t c) const { return columns_[c]; }
+
+private:
+    std::array<std::vector<uint32_t>, kColumns> columns_;
+};
+
+// Computes DocStats with the gopher_quality and c4_quality settings of a
+// pipeline spec (defaults for stages the spec does not name; other stages
+// are ignored). The stop-word list, unicode mode and the C4 line rules are
+// fixed here; the thresholds stay free for StatsEvaluator. Without with_c4
+// the C4 columns are left at zero.
+class StatsCollector {
+public:
+    explicit StatsCollector(const std::string& spec, bool with_c4 = true);
+    DocStats compute(const DocumentAnalysis& doc) const;
+    // True if the stats this collector computes are valid for `spec`, i.e.
+    // the spec agrees on every setting that shapes them.
+    bool collects(const std::string& spec) const;
+    // Those settings, one "stage.param=value" line each (stats file header).
+    std::string settings() const;
+
+private:
+    GopherQualityConfig gopher_config_;
+    C4QualityConfig c4_config_;
+    GopherQualityFilter gopher_;
+    C4QualityFilter c4_;
+    bool with_c4_;
+};
+
+// Applies the gopher_quality and c4_quality stages of a pipeline spec, in
+// spec order, to stored stats. Other stages, and gopher_quality after
+// c4_quality (which would see rewritten text), throw std::invalid_argument.
+// Empty documents drop as empty_text, as in websift.
+//
+// Each threshold is one pass over its columns, in the order the filters
+// test them, so a document drops for the same reason as in websift.
+class StatsEvaluator {
+public:
+    explicit StatsEvaluator(const std::string& spec);
+    // Throws std::invalid_argument if the spec's stages differ from the
+    // collection settings (StatsCollector::settings()) in anything but a
+    // threshold: the stats would not be the ones the spec computes.
+    void checkSettings(const std::string& settings) const;
+    void evaluate(const StatsColumns& group, std::vector<Verdict>& out) const;
+
+private:
+    // Rows still kept that fail the test drop with `reason`.
+    struct Check {
+        enum Kind {
+            Zero,       // column == 0
+            Below,      // column < limit
+            Above,      // column > limit
+            RatioBelow, // column / denominator < limit; an empty denominator drops
+            RatioAbove, // column / denominator > limit; an empty denominator passes
+            EarlyDrop,  // the column holds the reason itself (C4 early drops)
+        };
+        Kind kind;
+        size_t column;
+        DropReason reason;
+        double limit = 0;
+        size_t denominator = 0;
+    };
+
+    void addGopherChecks(const GopherQualityConfig& c);
+    void addC4Checks(const C4QualityConfig& c);
+
+    std::string spec_;
+    std::vector<Check> checks_;
+};
+
+// Binary columnar file: the magic "WSSTATS2", the column count and names,
+// the collection settings (uint32 length and text), then row groups of up
+// to kRowGroupRows rows, each a uint32 row count followed by every column
+// as a uint32 array (host byte order). I/O errors throw std::runtime_error.
+class StatsWriter {
+public:
+    static constexpr size_t kRowGroupRows = 65536;
+
+    StatsWriter(const std::string& path, const std::string& settings);
+    ~StatsWriter();
+
+    void append(const DocStats& stats);
+    void append(const StatsColumns& rows);
+    void close();
+    size_t rowsWritten() const { return rows_written_; }
+
+private:
+    std::ofstream out_;
+    StatsColumns pending_;
+    size_t rows_written_ = 0;
+
+    void flushGroup();
+};
+
+class StatsReader {
+public:
+    explicit StatsReader(const std::string& path);
+    // Next row group; false at the end of the file.
+    bool next(StatsColumns& group);
+    const std::string& settings() const { return settings_; }
+
+private:
+    std::ifstream in_;
+    std::string path_;
+    std::string settings_;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "unicode_tables.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// UTF-8 helpers for the Unicode-aware filter modes.
+namespace Unicode {
+
+inline bool isLetter(uint32_t cp) {
+    if (cp > kMaxCodePoint) return false;
+    const uint8_t* block = kLetterBlocks[kLetterBlockIndex[cp >> kLetterBlockBits]];
+    const uint32_t bit = cp & ((1u << kLetterBlockBits) - 1);
+    return (block[bit >> 3] >> (bit & 7)) & 1;
+}
+
+// Decode one code point starting at s[i] and advance i. Malformed or
+// truncated sequences consume a single byte and yield U+FFFD.
+inline uint32_t decodeUtf8(std::string_view s, size_t& i) {
+    const unsigned char c0 = static_cast<unsigned char>(s[i]);
+    if (c0 < 0x80) {
+        i += 1;
+        return c0;
+    }
+    size_t len;
+    uint32_t cp;
+    uint32_t min;
+    if ((c0 & 0xE0) == 0xC0) {
+        len = 2; cp = c0 & 0x1F; min = 0x80;
+    } else if ((c0 & 0xF0) == 0xE0) {
+        len = 3; cp = c0 & 0x0F; min = 0x800;
+    } else if ((c0 & 0xF8) == 0xF0) {
+        len = 4; cp = c0 & 0x07; min = 0x10000;
+    } else {
+        i += 1;
+        return 0xFFFD;
+    }
+    if (i + len > s.size()) {
+        i += 1;
+        return 0xFFFD;
+    }
+    for (size_t k = 1; k < len; ++k) {
+        const unsigned char c = static_cast<unsigned char>(s[i + k]);
+        if ((c & 0xC0) != 0x80) {
+            i += 1;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (c & 0x3F);
+    }
+    if (cp < min || cp > kMaxCodePoint || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        i += 1;
+        return 0xFFFD;
+    }
+    i += len;
+    return cp;
+}
+
+// True if any byte of the 32-byte block at p has its high bit set.
+inline bool blockHasNonAscii(const char* p) {
+#if defined(__AVX2__)
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    return _mm256_movemask_epi8(v) != 0;
+#elif defined(__SSE2__)
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+    return _mm_movemask_epi8(_mm_or_si128(a, b)) != 0;
+#else
+    uint64_t w[4];
+    std::memcpy(w, p, sizeof(w));
+    return ((w[0] | w[1] | w[2] | w[3]) & 0x8080808080808080ULL) != 0;
+#endif
+}
+
+// Pure-ASCII check, 32 bytes at a time.
+inline bool isAscii(std::string_view s) {
+    const char* p = s.data();
+    size_t n = s.size();
+    for (; n >= 32; p += 32, n -= 32) {
+        if (blockHasNonAscii(p)) return false;
+    }
+    for (; n > 0; ++p, --n) {
+        if (static_cast<unsigned char>(*p) & 0x80) return false;
+    }
+    return true;
+}
+
+// Number of code points, counting each malformed byte as one.
+inline size_t codePointCount(std::string_view s) {
+    size_t count = 0;
+    for (size_t i = 0; i < s.size();) {
+        decodeUtf8(s, i);
+        count++;
+    }
+    return count;
+}
+
+// Byte length of the whitespace character at s[i] that Python's str.split()
+// splits on but ASCII splitting (space, \t \n \r \f \v) does not: U+001C..
+// U+001F, U+0085, U+00A0, U+1680, U+2000..U+200A, U+2028, U+2029, U+202F,
+// U+205F and U+3000. 0 if there is none at i.
+inline size_t extraSpaceLength(std::string_view s, size_t i) {
+    const unsigned char c0 = static_cast<unsigned char>(s[i]);
+    if (c0 >= 0x1C && c0 <= 0x1F) return 1;
+    if (c0 < 0xC2 || c0 > 0xE3) return 0;
+    const size_t left = s.size() - i;
+    const unsigned char c1 = left > 1 ? static_cast<unsigned char>(s[i + 1]) : 0;
+    if (c0 == 0xC2) return (c1 == 0x85 || c1 == 0xA0) ? 2 : 0;
+    if (left < 3) return 0;
+    const unsigned char c2 = static_cast<unsigned char>(s[i + 2]);
+    switch (c0) {
+    case 0xE1:
+        return (c1 == 0x9A && c2 == 0x80) ? 3 : 0;
+    case 0xE2:
+        if (c1 == 0x80) return ((c2 >= 0x80 && c2 <= 0x8A) || c2 == 0xA8 || c2 == 0xA9 || c2 == 0xAF) ? 3 : 0;
+        return (c1 == 0x81 && c2 == 0x9F) ? 3 : 0;
+    case 0xE3:
+        return (c1 == 0x80 && c2 == 0x80) ? 3 : 0;
+    default:
+        return 0;
+    }
+}
+
+// The same for a space ending right before s[end] (for trimming from the
+// right).
+inline size_t extraSpaceLengthBefore(std::string_view s, size_t end) {
+    s = s.substr(0, end);
+    for (size_t len = 1; len <= 3 && len <= end; ++len) {
+        if (extraSpaceLength(s, end - len) == len) return len;
+    }
+    return 0;
+}
+
+// Byte length of the line break at s[i] that Python's str.splitlines()
+// breaks on besides '\n': \r, \v, \f, U+001C..U+001E, U+0085, U+2028 and
+// U+2029. 0 if there is none at i.
+inline size_t extraLineBreakLength(std::string_view s, size_t i) {
+    const unsigned char c0 = static_cast<unsigned char>(s[i]);
+    if (c0 == '\r' || c0 == '\v' || c0 == '\f' || (c0 >= 0x1C && c0 <= 0x1E)) return 1;
+    const size_t left = s.size() - i;
+    if (c0 == 0xC2) return left > 1 && static_cast<unsigned char>(s[i + 1]) == 0x85 ? 2 : 0;
+    if (c0 == 0xE2 && left > 2 && static_cast<unsigned char>(s[i + 1]) == 0x80) {
+        const unsigned char c2 = static_cast<unsigned char>(s[i + 2]);
+        return (c2 == 0xA8 || c2 == 0xA9) ? 3 : 0;
+    }
+    return 0;
+}
+
+inline bool containsLetter(std::string_view s) {
+    for (size_t i = 0; i < s.size();) {
+        if (isLetter(decodeUtf8(s, i))) return true;
+    }
+    return false;
+}
+
+} // namespace Unicode
@@ -0,0 +1,172 @@
+#include "url_filter.hpp"
+#include "dedup.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kMagic[8] = {'W', 'S', 'U', 'R', 'L', 'B', 'F', '1'};
+constexpr uint32_t kBitsSet = 8;           // k
+constexpr size_t kBlockWords = 64 / sizeof(uint64_t);
+
+std::string errnoText() { return std::strerror(errno); }
+
+void lowerInPlace(std::string& s, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) s[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(s[i])));
+}
+
+} // namespace
+
+std::string normalizeUrl(std::string_view url) {
+    while (!url.empty() && std::isspace(static_cast<unsigned char>(url.front()))) url.remove_prefix(1);
+    while (!url.empty() && std::isspace(static_cast<unsigned char>(url.back()))) url.remove_suffix(1);
+    if (url.size() >= 2 && url.front() == '<' && url.back() == '>') url = url.substr(1, url.size() - 2);
+    const size_t hash = url.find('#');
+    if (hash != std::string_view::npos) url = url.substr(0, hash);
+
+    std::string out(url);
+    const size_t scheme_end = out.find("://");
+    if (scheme_end == std::string::npos) return out;
+    lowerInPlace(out, 0, scheme_end);
+
+    const size_t host_begin = scheme_end + 3;
+    size_t host_end = out.find_first_of("/?", host_begin);
+    if (host_end == std::string::npos) host_end = out.size();
+    lowerInPlace(out, host_begin, host_end);
+
+    const std::string_view scheme(out.data(), scheme_end);
+    const std::string_view authority(out.data() + host_begin, host_end - host_begin);
+    const char* default_port = scheme == "http" ? ":80" : scheme == "https" ? ":443" : nullptr;
+    if (default_port && authority.size() > std::strlen(default_port) &&
+        authority.substr(authority.size() - std::strlen(default_port)) == default_port) {
+        const size_t port_len = std::strlen(default_port);
+        out.erase(host_end - port_len, port_len);
+        host_end -= port_len;
+    }
+    if (host_end == out.size() || out[host_end] != '/') out.insert(host_end, "/");
+    return out;
+}
+
+UrlBloomFilter::UrlBloomFilter(const std::string& path, bool writable, uint64_t capacity) : writable_(writable) {
+    fd_ = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd_ < 0 && errno == ENOENT && writable) {
+        create(path, capacity);
+        fd_ = ::open(path.c_str(), O_RDWR);
+    }
+    if (fd_ < 0) throw std::runtime_error("url filter: could not open " + path + ": " + errnoText());
+
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        const std::string err = errnoText();
+        release();
+        throw std::runtime_error("url filter: could not stat " + path + ": " + err);
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    if (map_size_ < sizeof(Header)) {
+        release();
+        throw std::runtime_error("url filter: " + path + " is not a URL filter file");
+    }
+    map_ = ::mmap(nullptr, map_size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+    if (map_ == MAP_FAILED) {
+        const std::string err = errnoText();
+        map_ = nullptr;
+        release();
+        throw std::runtime_error("url filter: could not map " + path + ": " + err);
+    }
+
+    const Header* header = static_cast<const Header*>(map_);
+    if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->blocks == 0 || header->k == 0 ||
+        map_size_ != sizeof(Header) + header->blocks * 64) {
+        release();
+        throw std::runtime_error("url filter: " + path + " is not a URL filter file");
+    }
+    blocks_ = header->blocks;
+    k_ = header->k;
+    bits_ = reinterpret_cast<uint64_t*>(static_cast<char*>(map_) + sizeof(Header));
+    ::madvise(map_, map_size_, MADV_RANDOM);
+}
+
+UrlBloomFilter::~UrlBloomFilter() { release(); }
+
+void UrlBloomFilter::release() {
+    if (map_) ::munmap(map_, map_size_);
+    if (fd_ >= 0) ::close(fd_);
+    map_ = nullptr;
+    fd_ = -1;
+}
+
+// Written under a temporary name and linked into place, so a concurrent
+// process never maps a file whose header is not written yet (and the first
+// creator wins if two race).
+void UrlBloomFilter::create(const std::string& path, uint64_t capacity) {
+    const uint64_t bits = static_cast<uint64_t>(std::ceil(static_cast<double>(std::max<uint64_t>(capacity, 1)) * kBitsPerUrl));
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.blocks = (bits + 511) / 512;
+    header.k = kBitsSet;
+
+    const std::string tmp = path + ".tmp." + std::to_string(::getpid());
+    const int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("url filter: could not create " + tmp + ": " + errnoText());
+    const bool ok = ::ftruncate(fd, static_cast<off_t>(sizeof(Header) + header.blocks * 64)) == 0 &&
+                    ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+    ::close(fd);
+    if (!ok) {
+        ::unlink(tmp.c_str());
+        throw std::runtime_error("url filter: could not write " + tmp + ": " + errnoText());
+    }
+    const bool linked = ::link(tmp.c_str(), path.c_str()) == 0 || errno == EEXIST;
+    ::unlink(tmp.c_str());
+    if (!linked) throw std::runtime_error("url filter: could not create " + path + ": " + errnoText());
+}
+
+namespace {
+
+// Block index and the k bit positions (0..511) within the block.
+struct Probe {
+    uint64_t block;
+    uint32_t a;
+    uint32_t b;
+
+    uint32_t bit(uint32_t i) const { return (a + i * b) >> 23; }
+};
+
+Probe probe(std::string_view key, uint64_t blocks) {
+    const Hash128 h = hash128(key);
+    return {static_cast<uint64_t>((static_cast<unsigned __int128>(h.lo) * blocks) >> 64),
+            static_cast<uint32_t>(h.hi), static_cast<uint32_t>(h.hi >> 32) | 1};
+}
+
+} // namespace
+
+bool UrlBloomFilter::contains(std::string_view key) const {
+    const Probe p = probe(key, blocks_);
+    const uint64_t* block = bits_ + p.block * kBlockWords;
+    for (uint32_t i = 0; i < k_; ++i) {
+        const uint32_t bit = p.bit(i);
+        if ((__atomic_load_n(&block[bit >> 6], __ATOMIC_RELAXED) & (uint64_t{1} << (bit & 63))) == 0) return false;
+    }
+    return true;
+}
+
+bool UrlBloomFilter::insert(std::string_view key) {
+    if (!writable_) throw std::runtime_error("url filter: insert into a read-only filter");
+    const Probe p = probe(key, blocks_);
+    uint64_t* block = bits_ + p.block * kBlockWords;
+    bool all_set = true;
+    for (uint32_t i = 0; i < k_; ++i) {
+        const uint32_t bit = p.bit(i);
+        const uint64_t mask = uint64_t{1} << (bit & 63);
+        all_set &= (__atomic_fetch_or(&block[bit >> 6], mask, __ATOMIC_RELAXED) & mask) != 0;
+    }
+    return all_set;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// URL key for cross-crawl dedup: surrounding '<>' and whitespace removed,
+// scheme and host lower-cased, default port (:80 for http, :443 for https)
+// and fragment dropped, empty path written as "/".
+std::string normalizeUrl(std::string_view url);
+
+// Blocked Bloom filter in a memory-mapped file, so it persists across runs
+// and can be shared by concurrent processes. Each URL maps to one 64-byte
+// block (one cache line) and sets k bits inside it; bits are set with
+// atomic fetch-or, so several writers may update the file in place.
+//
+// File: a 64-byte header (the magic "WSURLBF1", uint64 block count, uint32
+// k), then the blocks. Errors throw std::runtime_error.
+class UrlBloomFilter {
+public:
+    static constexpr uint64_t kDefaultCapacity = 100000000;
+    static constexpr double kBitsPerUrl = 12.0; // about 0.5% false positives at capacity
+
+    // Maps an existing filter (read-only unless writable). A missing file is
+    // an error when read-only; when writable it is created, sized for
+    // `capacity` URLs.
+    UrlBloomFilter(const std::string& path, bool writable, uint64_t capacity = kDefaultCapacity);
+    ~UrlBloomFilter();
+    UrlBloomFilter(const UrlBloomFilter&) = delete;
+    UrlBloomFilter& operator=(const UrlBloomFilter&) = delete;
+
+    // Keys are normalized URLs.
+    bool contains(std::string_view key) const;
+    // Set the key's bits; true if all of them were already set.
+    bool insert(std::string_view key);
+
+    uint64_t blocks() const { return blocks_; }
+
+private:
+    struct Header {
+        char magic[8];
+        uint64_t blocks;
+        uint32_t k;
+        char reserved[44];
+    };
+    static_assert(sizeof(Header) == 64, "header is one block");
+
+    int fd_ = -1;
+    void* map_ = nullptr;
+    size_t map_size_ = 0;
+    uint64_t* bits_ = nullptr;
+    uint64_t blocks_ = 0;
+    uint32_t k_ = 0;
+    bool writable_;
+
+    void create(const std::string& path, uint64_t capacity);
+    void release();
+};
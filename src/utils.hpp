@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 #include <sstream>
@@ -17,15 +18,18 @@ namespace Utils {
         return result;
     }
 
-    // Simple HTML stripper (removes <...>)
-    inline std::string extractText(const std::string& html) {
+    // Simple HTML stripper (removes <...>). Writes into `text`, replacing its
+    // contents; a buffer reused across documents stops allocating once it is
+    // large enough.
+    inline void extractText(std::string_view html, std::string& text) {
+        text.clear();
         // Fast path: no tags detected.
         size_t first_tag = html.find('<');
-        if (first_tag == std::string::npos) {
-            return html;
+        if (first_tag == std::string_view::npos) {
+            text.assign(html.data(), html.size());
+            return;
         }
 
-        std::string text;
         text.reserve(html.size());
 
         const char* data = html.data();
@@ -33,7 +37,7 @@ namespace Utils {
         size_t i = 0;
         while (i < n) {
             size_t lt = html.find('<', i);
-            if (lt == std::string::npos) {
+            if (lt == std::string_view::npos) {
                 text.append(data + i, n - i);
                 break;
             }
@@ -41,29 +45,39 @@ namespace Utils {
                 text.append(data + i, lt - i);
             }
             size_t gt = html.find('>', lt + 1);
-            if (gt == std::string::npos) {
+            if (gt == std::string_view::npos) {
                 // Unterminated tag; stop emitting further text to mirror prior behavior.
                 break;
             }
             text.push_back(' '); // keep spacing where a tag was removed
             i = gt + 1;
         }
+    }
+
+    inline std::string extractText(const std::string& html) {
+        std::string text;
+        extractText(std::string_view(html), text);
         return text;
     }
 
-    // Extract body from HTTP response (skip headers)
-    inline std::string extractHttpBody(const std::string& response) {
+    // Body of an HTTP response (headers skipped), as a view into it.
+    inline std::string_view httpBody(std::string_view response) {
         size_t pos = response.find("\r\n\r\n");
-        if (pos != std::string::npos) {
+        if (pos != std::string_view::npos) {
             return response.substr(pos + 4);
         }
         pos = response.find("\n\n");
-        if (pos != std::string::npos) {
+        if (pos != std::string_view::npos) {
             return response.substr(pos + 2);
         }
         return response; // Fallback
     }
 
+    // Extract body from HTTP response (skip headers)
+    inline std::string extractHttpBody(const std::string& response) {
+        return std::string(httpBody(response));
+    }
+
     inline std::vector<std::string> splitLines(const std::string& text) {
         std::vector<std::string> lines;
         std::stringstream ss(text);
@@ -112,6 +126,12 @@ namespace Utils {
             }
         }
 
+        // Record time measured elsewhere (e.g. summed over threads).
+        void add(const std::string& name, double total_ms, size_t count) {
+            stats[name].total_ms += total_ms;
+            stats[name].count += count;
+        }
+
         void printStats() {
             std::cout << "\n--- Profiling Stats ---" << std::endl;
             std::cout << std::left << std::setw(25) << "Name" 
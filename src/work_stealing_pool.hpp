@@ -0,0 +1,241 @@
+#pragma once
+
+#include "bounded_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Thread pool for jobs made of independent items (the documents of a
+// block). New jobs wait in a bounded queue; a worker runs ranges of items
+// from its own deque, newest first, takes a new job when the deque is
+// empty, and otherwise steals the oldest range of a random other worker.
+//
+// Ranges are split lazily: a worker runs `grain` items at a time, and while
+// another worker is idle it first hands the upper half of what is left to
+// its deque. A block that happens to hold a few huge documents is therefore
+// spread over the idle workers instead of finishing on one while the rest
+// wait, and nothing is split when everyone is busy.
+//
+// setActive(n) parks the workers numbered n and up once they finish their
+// current range (what they split off stays stealable), so a tuner can
+// change the worker count while jobs run.
+template <typename Job>
+class WorkStealingPool {
+public:
+    // run(worker, job, begin, end) processes items [begin, end) of the job;
+    // ranges of one job run concurrently. done(worker, job) is called once
+    // per job, after all its items, by the worker that ran the last range.
+    using RunFn = std::function<void(unsigned, Job&, size_t, size_t)>;
+    using DoneFn = std::function<void(unsigned, Job&)>;
+    // start(worker) runs first on each worker thread (to pin it, say).
+    using StartFn = std::function<void(unsigned)>;
+
+    WorkStealingPool(unsigned threads, size_t grain, size_t max_waiting, RunFn run, DoneFn done, StartFn start = {})
+        : grain_(grain ? grain : 1), run_(std::move(run)), done_(std::move(done)), start_(std::move(start)),
+          injected_(max_waiting), workers_(threads ? threads : 1), active_limit_(static_cast<unsigned>(workers_.size())) {
+        threads_.reserve(workers_.size());
+        for (unsigned w = 0; w < workers_.size(); ++w) threads_.emplace_back([this, w] { work(w); });
+    }
+
+    ~WorkStealingPool() { close(); }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+    // Number of workers allowed to take work, between 1 and size().
+    void setActive(unsigned n) {
+        active_limit_.store(std::max(1u, std::min(n, size())), std::memory_order_seq_cst);
+        // Idle workers past the new limit must move to resume_ rather than
+        // swallow a wake-up meant for an active one.
+        idle_wake_.notify(true);
+        resume_.notify(true);
+    }
+    unsigned active() const { return active_limit_.load(std::memory_order_relaxed); }
+
+    // Seconds active workers have spent waiting for work, summed over
+    // workers since the pool started (waits in progress included).
+    double idleSeconds() const { return idle_clock_.seconds(); }
+
+    // Queues a job of `items` items (0 is fine: it only gets done()).
+    // Blocks while max_waiting jobs are waiting to start.
+    bool submit(Job&& job, size_t items) {
+        auto* entry = new Entry{std::move(job), {items}};
+        active_.fetch_add(1, std::memory_order_relaxed);
+        if (!injected_.push(Range{entry, 0, items})) {
+            active_.fetch_sub(1, std::memory_order_relaxed);
+            delete entry;
+            return false;
+        }
+        idle_wake_.notify();
+        return true;
+    }
+
+    // Runs every submitted job to completion, then stops the workers.
+    void close() {
+        if (closed_.exchange(true)) return;
+        injected_.close();
+        idle_wake_.notify(true);
+        resume_.notify(true);
+        for (std::thread& t : threads_) t.join();
+    }
+
+private:
+    struct Entry {
+        Job job;
+        std::atomic<size_t> remaining;
+    };
+
+    struct Range {
+        Entry* entry = nullptr;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    struct alignas(64) Worker {
+        std::mutex mu;
+        std::deque<Range> ranges;
+    };
+
+    void pushLocal(unsigned w, const Range& r) {
+        {
+            std::lock_guard<std::mutex> lk(workers_[w].mu);
+            workers_[w].ranges.push_back(r);
+            local_.fetch_add(1, std::memory_order_relaxed);
+        }
+        idle_wake_.notify();
+    }
+
+    bool popLocal(unsigned w, Range& r) {
+        std::lock_guard<std::mutex> lk(workers_[w].mu);
+        if (workers_[w].ranges.empty()) return false;
+        r = workers_[w].ranges.back();
+        workers_[w].ranges.pop_back();
+        local_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool steal(unsigned w, std::minstd_rand& rng, Range& r) {
+        const unsigned n = size();
+        if (n < 2 || local_.load(std::memory_order_relaxed) == 0) return false;
+        const unsigned start = static_cast<unsigned>(rng() % n);
+        for (unsigned i = 0; i < n; ++i) {
+            const unsigned victim = (start + i) % n;
+            if (victim == w) continue;
+            std::lock_guard<std::mutex> lk(workers_[victim].mu);
+            if (workers_[victim].ranges.empty()) continue;
+            r = workers_[victim].ranges.front();
+            workers_[victim].ranges.pop_front();
+            local_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    bool next(unsigned w, std::minstd_rand& rng, Range& r) {
+        return popLocal(w, r) || injected_.tryPop(r) || steal(w, rng, r);
+    }
+
+    void work(unsigned w) {
+        if (start_) start_(w);
+        std::minstd_rand rng(w * 7919u + 1);
+        Range r;
+        while (true) {
+            if (w >= active_limit_.load(std::memory_order_seq_cst)) {
+                // Parked workers wait apart from idle ones, so a wake-up
+                // meant for an idle worker is never spent on a parked one.
+                // Worker 0 is never parked and drains the pool on close.
+                const uint32_t epoch = resume_.prepare();
+                if (closed_.load(std::memory_order_acquire)) {
+                    resume_.cancel();
+                    return;
+                }
+                if (w < active_limit_.load(std::memory_order_seq_cst)) {
+                    resume_.cancel();
+                } else {
+                    resume_.wait(epoch);
+                }
+                continue;
+            }
+            if (next(w, rng, r)) {
+                runRange(w, r);
+                continue;
+            }
+            idle_.fetch_add(1, std::memory_order_seq_cst);
+            const uint32_t epoch = idle_wake_.prepare();
+            if (w >= active_limit_.load(std::memory_order_seq_cst)) {
+                idle_wake_.cancel();
+                idle_.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (next(w, rng, r)) {
+                idle_wake_.cancel();
+                idle_.fetch_sub(1, std::memory_order_relaxed);
+                runRange(w, r);
+                continue;
+            }
+            if (closed_.load(std::memory_order_acquire) && active_.load(std::memory_order_acquire) == 0) {
+                idle_wake_.cancel();
+                idle_.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            const auto waitStart = idle_clock_.begin();
+            idle_wake_.wait(epoch);
+            idle_clock_.end(waitStart);
+            idle_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void runRange(unsigned w, Range r) {
+        Entry* entry = r.entry;
+        // Items handed back to the deque by a split are counted where they
+        // run; whoever brings remaining to zero finishes the job.
+        size_t ran = 0;
+        size_t begin = r.begin;
+        size_t end = r.end;
+        while (begin < end) {
+            if (end - begin > 2 * grain_ && idle_.load(std::memory_order_relaxed) > 0) {
+                const size_t mid = begin + (end - begin) / 2;
+                pushLocal(w, Range{entry, mid, end});
+                end = mid;
+                continue;
+            }
+            const size_t stop = std::min(end, begin + grain_);
+            run_(w, entry->job, begin, stop);
+            ran += stop - begin;
+            begin = stop;
+        }
+        if (entry->remaining.fetch_sub(ran, std::memory_order_acq_rel) != ran) return;
+        done_(w, entry->job);
+        delete entry;
+        if (active_.fetch_sub(1, std::memory_order_acq_rel) == 1 && closed_.load(std::memory_order_acquire)) {
+            idle_wake_.notify(true);
+        }
+    }
+
+    const size_t grain_;
+    RunFn run_;
+    DoneFn done_;
+    StartFn start_;
+    BoundedQueue<Range> injected_;
+    std::vector<Worker> workers_;
+    std::vector<std::thread> threads_;
+    alignas(64) std::atomic<size_t> local_{0};  // ranges sitting in worker deques
+    alignas(64) std::atomic<unsigned> idle_{0}; // workers looking for work
+    std::atomic<size_t> active_{0};             // submitted jobs not yet done
+    std::atomic<bool> closed_{false};
+    std::atomic<unsigned> active_limit_;         // workers allowed to take work
+    WaitClock idle_clock_;
+    Parker idle_wake_;
+    Parker resume_; // parked workers
+};
@@ -0,0 +1,137 @@
+import argparse
+import random
+import struct
+import tempfile
+from pathlib import Path
+
+from test_stats_eval import make_warc, run, summary
+
+MASK = (1 << 64) - 1
+
+
+def rotl(x: int, r: int) -> int:
+    return ((x << r) | (x >> (64 - r))) & MASK
+
+
+def fmix(k: int) -> int:
+    k ^= k >> 33
+    k = (k * 0xFF51AFD7ED558CCD) & MASK
+    k ^= k >> 33
+    k = (k * 0xC4CEB9FE1A85EC53) & MASK
+    k ^= k >> 33
+    return k
+
+
+def murmur3_128(data: bytes, seed: int = 0):
+    """MurmurHash3 x64/128 reference; returns (lo, hi) as stored in the set file."""
+    c1, c2 = 0x87C37B91114253D5, 0x4CF5AD432745937F
+    h1 = h2 = seed
+    n = len(data)
+    padded = data + b"\0" * (-n % 16)
+    full = n // 16 * 16
+    for i in range(0, len(padded), 16):
+        k1, k2 = struct.unpack_from("<QQ", padded, i)
+        if i < full:
+            h1 ^= (rotl((k1 * c1) & MASK, 31) * c2) & MASK
+            h1 = (rotl(h1, 27) + h2) & MASK
+            h1 = (h1 * 5 + 0x52DCE729) & MASK
+            h2 ^= (rotl((k2 * c2) & MASK, 33) * c1) & MASK
+            h2 = (rotl(h2, 31) + h1) & MASK
+            h2 = (h2 * 5 + 0x38495AB5) & MASK
+        else:
+            if n - i > 8:
+                h2 ^= (rotl((k2 * c2) & MASK, 33) * c1) & MASK
+            h1 ^= (rotl((k1 * c1) & MASK, 31) * c2) & MASK
+    h1 ^= n
+    h2 ^= n
+    h1 = (h1 + h2) & MASK
+    h2 = (h2 + h1) & MASK
+    h1, h2 = fmix(h1), fmix(h2)
+    h1 = (h1 + h2) & MASK
+    h2 = (h2 + h1) & MASK
+    if (h1, h2) == (0, 0):
+        h1 = 1
+    return h1, h2
+
+
+def normalize(text: str) -> str:
+    return " ".join(text.lower().split())
+
+
+def make_documents(count: int):
+    """Unique texts plus exact copies and copies differing only in case or spacing."""
+    rng = random.Random(11)
+    vocab = ["the", "and", "of", "Quick", "brown", "fox", "jumps", "over", "lazy", "dog", "data", "Filter"]
+    base = []
+    for _ in range(count):
+        lines = [" ".join(rng.choice(vocab) for _ in range(rng.randint(1, 10))) for _ in range(rng.randint(1, 6))]
+        base.append("\n".join(lines))
+    docs = list(base)
+    for text in rng.sample(base, count // 3):
+        docs.append(text)
+    for text in rng.sample(base, count // 3):
+        docs.append(text.upper().replace(" ", "  \t", 1))
+    rng.shuffle(docs)
+    return docs
+
+
+def read_set(path: Path):
+    data = path.read_bytes()
+    assert data[:8] == b"WSDEDUP1", "bad magic"
+    (count,) = struct.unpack_from("<Q", data, 8)
+    hashes = {struct.unpack_from("<QQ", data, 16 + 16 * i) for i in range(count)}
+    assert len(hashes) == count and len(data) == 16 + 16 * count, "bad set file"
+    return hashes
+
+
+def duplicates(output: str) -> int:
+    return summary(output)[1].get("duplicate", 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the exact_dedup stage against a Python reference.")
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    args = parser.parse_args()
+
+    docs = make_documents(300)
+    expect_norm = len(docs) - len({normalize(d) for d in docs})
+    expect_raw = len(docs) - len(set(docs))
+    failures = []
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        tmp = Path(tmpdir)
+        warc = tmp / "all.warc.gz"
+        make_warc(warc, docs)
+        for threads in ("1", "3"):
+            got = duplicates(run([str(args.websift), str(warc), "--threads", threads, "--pipeline", "exact_dedup"]))
+            if got != expect_norm:
+                failures.append(f"threads={threads}: {got} duplicates, expected {expect_norm}")
+        got = duplicates(run([str(args.websift), str(warc), "--pipeline", "exact_dedup(normalize=false)"]))
+        if got != expect_raw:
+            failures.append(f"normalize=false: {got} duplicates, expected {expect_raw}")
+
+        # Two shards sharing one persisted set find every cross-shard duplicate.
+        seen = tmp / "seen.bin"
+        half = len(docs) // 2
+        total = 0
+        for i, shard in enumerate((docs[:half], docs[half:])):
+            shard_warc = tmp / f"shard{i}.warc.gz"
+            make_warc(shard_warc, shard)
+            total += duplicates(run([str(args.websift), str(shard_warc), "--threads", "2",
+                                     "--pipeline", f"exact_dedup(path={seen})"]))
+        if total != expect_norm:
+            failures.append(f"sharded: {total} duplicates, expected {expect_norm}")
+        expected_hashes = {murmur3_128(normalize(d).encode("utf-8")) for d in docs}
+        if read_set(seen) != expected_hashes:
+            failures.append("persisted set does not match the reference hashes")
+
+    if failures:
+        print("exact_dedup mismatches:")
+        for f in failures:
+            print("  " + f)
+        raise SystemExit(1)
+    print(f"ok: exact_dedup found {expect_norm} duplicates of {len(docs)} docs (serial, threaded, sharded)")
+
+
+if __name__ == "__main__":
+    main()
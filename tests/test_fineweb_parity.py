@@ -0,0 +1,158 @@
+import argparse
+import random
+import subprocess
+import sys
+from collections import Counter
+from typing import Dict, List, Tuple
+
+# Must match the C++ default stop_chars in FineWebQualityFilter.
+TERMINAL_PUNCTUATION = (
+    ".", "!", "?", "…", "‼", "‽", "⁇", "⁈", "⁉",
+    "。", "！", "．", "？", "｡", "؟", "۔", "।", "॥",
+)
+
+
+def find_duplicates(x: List[str]) -> Tuple[int, int]:
+    unique_x = set()
+    duplicate_chars = 0
+    duplicate_elements = 0
+    for element in x:
+        if element in unique_x:
+            duplicate_chars += len(element)
+            duplicate_elements += 1
+        else:
+            unique_x.add(element)
+    return duplicate_elements, duplicate_chars
+
+
+def fineweb_quality_py(
+    text: str,
+    line_punct_thr: float = 0.12,
+    line_punct_exclude_zero: bool = False,
+    stop_chars=TERMINAL_PUNCTUATION,
+    short_line_thr: float = 0.67,
+    short_line_length: int = 30,
+    char_duplicates_ratio: float = 0.01,
+    new_line_ratio: float = 0.3,
+) -> Tuple[bool, str]:
+    lines = text.split("\n")
+    lines = [line for line in lines if line.strip() != ""]
+    if len(lines) == 0:
+        return False, "empty"
+    ratio = sum(1 for line in lines if line.endswith(stop_chars)) / len(lines)
+    if ratio < line_punct_thr and not (ratio == 0 and line_punct_exclude_zero):
+        return False, "line_punct_ratio"
+
+    ratio = sum(1 for line in lines if len(line) <= short_line_length) / len(lines)
+    if ratio > short_line_thr:
+        return False, "short_line_ratio"
+
+    ratio = find_duplicates(lines)[1] / len(text.replace("\n", ""))
+    if ratio > char_duplicates_ratio:
+        return False, "char_dup_ratio"
+
+    words = text.split()
+    new_line = text.count("\n")
+    if new_line / len(words) > new_line_ratio:
+        return False, "list_ratio"
+
+    return True, ""
+
+
+def run_cpp(binary: str, text: str) -> Tuple[bool, str]:
+    proc = subprocess.run(
+        [binary, "--pipeline", "fineweb_quality"],
+        input=text.encode("utf-8"),
+        capture_output=True,
+    )
+    if proc.returncode != 0:
+        sys.stderr.write(proc.stderr.decode("utf-8", "replace"))
+        raise RuntimeError(f"Binary {binary} failed with code {proc.returncode}")
+
+    output = proc.stdout.decode("utf-8").rstrip("\n")
+    if not output:
+        raise RuntimeError("No output from binary")
+    parts = output.split("\t", 1)
+    keep = parts[0].strip().lower() == "keep"
+    reason = parts[1] if len(parts) > 1 else ""
+    return keep, reason
+
+
+def sentence(i: int, words: int = 8, end: str = ".") -> str:
+    return " ".join(f"s{i}w{j}" for j in range(words)) + end
+
+
+def build_test_cases() -> Dict[str, str]:
+    prose = "\n".join(sentence(i) for i in range(12))
+
+    cases = {
+        "passes": prose,
+        "empty": "",
+        "blank_lines_only": " \n\t\n\n",
+        "line_punct_ratio": "\n".join(sentence(i, end="") for i in range(12)),
+        "short_line_ratio": "\n".join(f"s{i}." for i in range(10)) + "\n" + sentence(99),
+        "char_dup_ratio": prose + "\n" + sentence(3),
+        "list_ratio": "\n".join(f"item_number_{i}_in_the_list description_{i}." for i in range(10)),
+        "trailing_newline": prose + "\n\n",
+        "crlf_lines": "\r\n".join(sentence(i) for i in range(12)),
+        "blank_lines_between": "\n   \n".join(sentence(i) for i in range(8)),
+        "cjk_full_stop": "\n".join(" ".join(f"c{i}w{j}" for j in range(8)) + "。" for i in range(10)),
+        "ellipsis": "\n".join(sentence(i, end="…") for i in range(10)),
+        "question_and_bang": "\n".join(sentence(i, end="?!"[i % 2]) for i in range(10)),
+        "exact_short_boundary": "\n".join(("x" * 29) + "." for _ in range(1)) + "\n" + prose,
+    }
+
+    # Seeded random documents around the thresholds.
+    rng = random.Random(4321)
+    vocab = ["the", "cat", "sat", "on", "a", "mat", "dog", "ran", "far", "away", "x", "yz"]
+    ends = ["", "", ".", "!", "?", ":", "。"]
+    for case in range(80):
+        lines = []
+        for _ in range(rng.randint(1, 14)):
+            r = rng.random()
+            if r < 0.1:
+                lines.append(rng.choice(["", " ", "\t"]))
+            elif r < 0.2 and lines:
+                lines.append(rng.choice(lines))
+            else:
+                n = rng.randint(1, 14)
+                lines.append(" ".join(rng.choice(vocab) for _ in range(n)) + rng.choice(ends))
+        cases[f"random_{case}"] = "\n".join(lines) + ("\n" if rng.random() < 0.3 else "")
+
+    return cases
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check C++ FineWebQualityFilter parity with Python reference.")
+    parser.add_argument("--binary", default="./build/gopher_filter_cli", help="Path to gopher_filter_cli binary")
+    args = parser.parse_args()
+
+    cases = build_test_cases()
+    failures = []
+    reasons = Counter()
+
+    for name, text in cases.items():
+        py_keep, py_reason = fineweb_quality_py(text)
+        cpp_keep, cpp_reason = run_cpp(args.binary, text)
+        reasons[py_reason or "keep"] += 1
+        if (py_keep, py_reason) != (cpp_keep, cpp_reason):
+            failures.append(
+                {
+                    "case": name,
+                    "python": {"keep": py_keep, "reason": py_reason},
+                    "cpp": {"keep": cpp_keep, "reason": cpp_reason},
+                }
+            )
+
+    if failures:
+        print("Parity test failures detected:")
+        for f in failures:
+            print(f)
+        sys.exit(1)
+
+    print(f"Parity test passed: C++ FineWeb quality filter matches Python reference on all {len(cases)} cases.")
+    print("Outcomes: " + ", ".join(f"{k}={v}" for k, v in sorted(reasons.items())))
+
+
+if __name__ == "__main__":
+    main()
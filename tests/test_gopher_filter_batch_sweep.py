@@ -0,0 +1,93 @@
+import argparse
+import gzip
+import json
+import subprocess
+import tempfile
+from pathlib import Path
+
+from test_stats_eval import make_documents, make_warc, run, summary
+
+# Every line may change thresholds but must share stop words, unicode and the
+# C4 line rules with the first.
+SPECS = [
+    "gopher_quality",
+    "c4_quality",
+    "gopher_quality(min_doc_words=20, max_symbol_word_ratio=0.05), c4_quality(min_num_sentences=2)",
+    "gopher_quality(min_avg_word_length=4, max_non_alpha_words_ratio=0.9, min_stop_words=4)",
+    "c4_quality(min_num_sentences=1)",
+    "gopher_quality(min_doc_words=0, min_avg_word_length=0, max_avg_word_length=5, max_symbol_word_ratio=0, "
+    "min_stop_words=0), c4_quality(min_num_sentences=-1)",
+]
+
+BAD_SWEEPS = [
+    ["gopher_quality", "gopher_quality(stop_words=the)"],
+    ["gopher_quality", "gopher_quality(unicode=true)"],
+]
+
+
+# Raw UTF-8, as extract_texts writes it.
+def make_jsonl(path: Path, docs):
+    with gzip.open(path, "wt") as f:
+        for idx, text in enumerate(docs):
+            f.write(json.dumps({"id": f"id{idx}", "text": text}, ensure_ascii=False, separators=(",", ":")))
+            f.write("\n")
+
+
+def sweep(binary: Path, texts: Path, configs: Path, specs, threads=None):
+    configs.write_text("# sweep\n" + "\n".join(specs) + "\n")
+    cmd = [str(binary), str(texts), "--sweep", str(configs), "--batch-size", "7"]
+    if threads is not None:
+        cmd += ["--threads", str(threads)]
+    out = json.loads(run(cmd))
+    return out["docs"], [(c["spec"], c["kept"], c["drop_reasons"]) for c in out["configs"]]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check gopher_filter_batch --sweep against one websift run per spec.")
+    parser.add_argument("--binary", default="./build/gopher_filter_batch", type=Path)
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    args = parser.parse_args()
+
+    docs = make_documents(300)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        texts = Path(tmpdir) / "texts.jsonl.gz"
+        warc = Path(tmpdir) / "sample.warc.gz"
+        configs = Path(tmpdir) / "configs.txt"
+        make_jsonl(texts, docs)
+        make_warc(warc, docs)
+
+        failures = []
+        count, serial = sweep(args.binary, texts, configs, SPECS)
+        # gopher_filter_batch skips empty texts; websift drops them as empty_text.
+        nonempty = sum(1 for d in docs if d)
+        if count != nonempty or [spec for spec, _, _ in serial] != SPECS:
+            failures.append(("sweep", f"{nonempty} docs, {len(SPECS)} configs", f"{count} docs, {serial}"))
+        for spec, kept, reasons in serial:
+            counts, filtered = summary(run([str(args.websift), str(warc), "--pipeline", spec]))
+            expected = (counts.get("Kept Docs"), {k: v for k, v in filtered.items() if v and k != "empty_text"})
+            if (kept, reasons) != expected:
+                failures.append((spec, expected, (kept, reasons)))
+
+        _, threaded = sweep(args.binary, texts, configs, SPECS, threads=4)
+        if threaded != serial:
+            failures.append(("--threads 4", serial, threaded))
+
+        # Settings that shape the stats cannot differ between lines.
+        for specs in BAD_SWEEPS:
+            configs.write_text("\n".join(specs) + "\n")
+            proc = subprocess.run([str(args.binary), str(texts), "--sweep", str(configs)],
+                                  capture_output=True, text=True)
+            if proc.returncode == 0 or specs[1] not in proc.stderr:
+                failures.append((" / ".join(specs), "an error", proc.stdout + proc.stderr))
+
+        if failures:
+            print("sweep mismatches:")
+            for spec, expected, got in failures:
+                print(f"  {spec}\n    expected: {expected}\n    sweep:    {got}")
+            raise SystemExit(1)
+
+    print(f"ok: --sweep matches websift on {len(SPECS)} threshold sets")
+
+
+if __name__ == "__main__":
+    main()
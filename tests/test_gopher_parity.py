@@ -77,18 +77,18 @@ def gopher_quality_py(
     return True, ""
 
 
-def run_cpp(binary: str, text: str) -> Tuple[bool, str]:
+def run_cpp(binary: str, text: str, pipeline: str = "") -> Tuple[bool, str]:
+    cmd = [binary] + (["--pipeline", pipeline] if pipeline else [])
     proc = subprocess.run(
-        [binary],
-        input=text,
-        text=True,
+        cmd,
+        input=text.encode("utf-8"),
         capture_output=True,
     )
     if proc.returncode != 0:
-        sys.stderr.write(proc.stderr)
+        sys.stderr.write(proc.stderr.decode("utf-8", "replace"))
         raise RuntimeError(f"Binary {binary} failed with code {proc.returncode}")
 
-    output = proc.stdout.strip()
+    output = proc.stdout.decode("utf-8").strip()
     if not output:
         raise RuntimeError("No output from binary")
     parts = output.split("\t", 1)
@@ -138,6 +138,50 @@ def build_test_cases() -> Dict[str, str]:
     }
 
 
+def build_unicode_test_cases() -> Dict[str, str]:
+    """Multilingual documents, checked with gopher_quality(unicode=true)."""
+    stop = "the and of to"
+    russian = " ".join(["быстрая коричневая лиса прыгает через ленивую собаку"] * 9 + [stop])
+    greek = " ".join(["η γρήγορη καφέ αλεπού πηδάει πάνω από τον τεμπέλη σκύλο"] * 7 + [stop])
+    accented = " ".join(["café naïve résumé façade jalapeño über straße"] * 9 + [stop])
+    chinese = " ".join(["敏捷的棕色狐狸 跳过了 那只懒狗"] * 20 + [stop])
+    emoji = " ".join(["😀😀😀 🎉🎉🎉"] * 30 + ["word"] * 10 + [stop])
+    mixed_digits = " ".join(["١٢٣"] * 20 + ["كلمة عربية طويلة"] * 15 + [stop])
+    long_cyrillic = " ".join(["электрификация достопримечательность"] * 30 + [stop])
+    # Unicode whitespace between words: str.split() splits on it.
+    nbsp = "\u00a0".join("the quick brown fox jumps over the lazy dog".split() * 7)
+    ideographic = "\u3000".join(["東京都庁", "大阪城跡", "京都御所", "札幌時計台"] * 15) + " " + stop
+    # Lines are stripped of, and split on, Unicode whitespace and breaks too.
+    sentence = "the quick brown fox jumps over the lazy dog and runs"
+    end_nbsp = "\n".join([sentence + "...\u00a0"] * 10)
+    end_ideographic = "\n".join([sentence + "\u2026\u3000 "] * 10)
+    bullets_ideographic = "\n".join(["\u3000\u00a0- " + sentence] * 10)
+    # 4 of 10 lines end in "...", but not the last: one line unless split.
+    breaks = ["\u2028", "\u2029", "\x85", "\r", "\x0b", "\x0c", "\x1c", "\x1d", "\x1e"]
+    split_lines = "".join(sentence + ("..." if i % 2 else "") + brk for i, brk in enumerate(breaks)) + sentence
+    crlf_lines = "\r\n".join(sentence + ("..." if i % 2 else "") for i in range(10))
+    mixed_spaces = "\u2009".join(["and the"] + ["\u202f".join(["слово", "ещё", "одно"])] * 25 + ["\u1680of\u205fto\x1d"])
+    return {
+        "unicode_ascii_passes": " ".join(["the quick brown fox jumps over the lazy dog"] * 7),
+        "unicode_russian": russian,
+        "unicode_greek": greek,
+        "unicode_accented_latin": accented,
+        "unicode_chinese_long_words": chinese,
+        "unicode_emoji_not_letters": emoji,
+        "unicode_arabic_digits": mixed_digits,
+        "unicode_avg_length_code_points": long_cyrillic,
+        "unicode_bullets": "\n".join(["\u2022 " + russian[:80]] * 12),
+        "unicode_nbsp_separated": nbsp,
+        "unicode_ideographic_space": ideographic,
+        "unicode_mixed_spaces": mixed_spaces,
+        "unicode_end_ellipsis_nbsp": end_nbsp,
+        "unicode_end_ellipsis_ideographic_space": end_ideographic,
+        "unicode_bullets_after_unicode_spaces": bullets_ideographic,
+        "unicode_line_separators": split_lines,
+        "unicode_crlf_is_one_break": crlf_lines,
+    }
+
+
 def main():
     parser = argparse.ArgumentParser(description="Check C++ GopherQualityFilter parity with Python reference.")
     parser.add_argument("--binary", default="./build/gopher_filter_cli", help="Path to gopher_filter_cli binary")
@@ -146,9 +190,23 @@ def main():
     cases = build_test_cases()
     failures = []
 
-    for name, text in cases.items():
-        py_keep, py_reason = gopher_quality_py(text)
-        cpp_keep, cpp_reason = run_cpp(args.binary, text)
+    runs = [(name, text, "", {}) for name, text in cases.items()]
+    runs += [(name, text, "gopher_quality(unicode=true)", {}) for name, text in build_unicode_test_cases().items()]
+
+    # A larger custom stop-word list (perfect-hash lookup on the C++ side).
+    custom = sorted({f"sw{i}" for i in range(150)} | {"der", "die", "das", "und", "ist"})
+    custom_spec = "gopher_quality(stop_words=" + "|".join(custom) + ")"
+    filler = " ".join(f"word{i}" for i in range(60))
+    runs += [
+        ("custom_stop_words_pass", filler + " der und sw7", custom_spec, {"stop_words": set(custom)}),
+        ("custom_stop_words_one", filler + " der the and sw", custom_spec, {"stop_words": set(custom)}),
+        ("custom_stop_words_default_absent", " ".join(["the quick brown fox"] * 20),
+         custom_spec, {"stop_words": set(custom)}),
+    ]
+
+    for name, text, pipeline, py_kwargs in runs:
+        py_keep, py_reason = gopher_quality_py(text, **py_kwargs)
+        cpp_keep, cpp_reason = run_cpp(args.binary, text, pipeline)
         if (py_keep, py_reason) != (cpp_keep, cpp_reason):
             failures.append(
                 {
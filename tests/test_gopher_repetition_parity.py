@@ -0,0 +1,208 @@
+import argparse
+import random
+import re
+import subprocess
+import sys
+from collections import Counter
+from typing import Dict, List, Tuple
+
+PARAGRAPH_EXP = re.compile(r"\n{2,}")
+LINE_SPLITTER = re.compile("\n+")
+
+
+def find_duplicates(x: List[str]) -> Tuple[int, int]:
+    unique_x = set()
+    duplicate_chars = 0
+    duplicate_elements = 0
+    for element in x:
+        if element in unique_x:
+            duplicate_chars += len(element)
+            duplicate_elements += 1
+        else:
+            unique_x.add(element)
+    return duplicate_elements, duplicate_chars
+
+
+def find_top_duplicate(x: List[str]) -> int:
+    counter = Counter()
+    for element in x:
+        counter[element] += 1
+    top_n_gram = counter.most_common(1)[0]
+    return len(top_n_gram[0]) * top_n_gram[1]
+
+
+def find_all_duplicate(words: List[str], n: int) -> int:
+    n_words = len(words)
+    unique = set()
+    repeated_chars, idx = 0, 0
+    while idx < n_words - n + 1:
+        n_gram = "".join(words[idx : idx + n])
+        if n_gram in unique:
+            repeated_chars += len(n_gram)
+            idx += n
+        else:
+            unique.add(n_gram)
+            idx += 1
+    assert repeated_chars <= len("".join(words))
+    return repeated_chars
+
+
+def get_n_grams(words: List[str], n: int) -> List[str]:
+    return [" ".join(words[i : i + n]) for i in range(len(words) - n + 1)]
+
+
+def gopher_repetition_py(
+    text: str,
+    dup_line_frac: float = 0.3,
+    dup_para_frac: float = 0.3,
+    dup_line_char_frac: float = 0.2,
+    dup_para_char_frac: float = 0.2,
+    top_n_grams=((2, 0.2), (3, 0.18), (4, 0.16)),
+    dup_n_grams=((5, 0.15), (6, 0.14), (7, 0.13), (8, 0.12), (9, 0.11), (10, 0.10)),
+) -> Tuple[bool, str]:
+    paragraphs = PARAGRAPH_EXP.split(text.strip())
+    paragraphs_duplicates, char_duplicates = find_duplicates(paragraphs)
+    if dup_para_frac and paragraphs_duplicates / len(paragraphs) > dup_para_frac:
+        return False, "dup_para_frac"
+    if dup_para_char_frac and char_duplicates / len(text) > dup_para_char_frac:
+        return False, "dup_para_char_frac"
+
+    lines = LINE_SPLITTER.split(text)
+    line_duplicates, char_duplicates = find_duplicates(lines)
+    if dup_line_frac and line_duplicates / len(lines) > dup_line_frac:
+        return False, "dup_line_frac"
+    if dup_line_char_frac and char_duplicates / len(text) > dup_line_char_frac:
+        return False, "dup_line_char_frac"
+
+    words = text.split()
+
+    for n, n_frac in top_n_grams:
+        n_grams = get_n_grams(words, n)
+        if not n_grams:
+            continue
+        top_char_length = find_top_duplicate(n_grams)
+        if top_char_length / len(text) > n_frac:
+            return False, f"top_{n}_gram"
+
+    for n, n_frac in dup_n_grams:
+        n_duplicates_char = find_all_duplicate(words, n)
+        if n_duplicates_char / len(text) > n_frac:
+            return False, f"duplicated_{n}_n_grams"
+
+    return True, ""
+
+
+def run_cpp(binary: str, text: str, pipeline: str = "gopher_repetition") -> Tuple[bool, str]:
+    proc = subprocess.run(
+        [binary, "--pipeline", pipeline],
+        input=text,
+        text=True,
+        capture_output=True,
+    )
+    if proc.returncode != 0:
+        sys.stderr.write(proc.stderr)
+        raise RuntimeError(f"Binary {binary} failed with code {proc.returncode}")
+
+    output = proc.stdout.rstrip("\n")
+    if not output:
+        raise RuntimeError("No output from binary")
+    parts = output.split("\t", 1)
+    keep = parts[0].strip().lower() == "keep"
+    reason = parts[1] if len(parts) > 1 else ""
+    return keep, reason
+
+
+def unique_words(count: int, prefix: str = "w") -> List[str]:
+    return [f"{prefix}{i}x" for i in range(count)]
+
+
+def build_test_cases() -> Dict[str, str]:
+    varied = " ".join(unique_words(120))
+    lines = [" ".join(unique_words(8, f"l{i}_")) for i in range(20)]
+
+    cases = {
+        "passes": varied,
+        "passes_multiline": "\n".join(lines),
+        "dup_para_frac": "\n\n".join(["same paragraph here"] * 4 + [" ".join(unique_words(200))]),
+        "dup_para_char_frac": "\n\n".join(
+            [" ".join(unique_words(30, "p"))] * 2 + [" ".join(unique_words(10, f"q{i}_")) for i in range(6)]
+        ),
+        "dup_line_frac": "\n".join(["repeated line"] * 5 + lines[:5]),
+        "dup_line_char_frac": "\n".join([" ".join(unique_words(30, "r"))] * 2 + lines[:8]),
+        "top_2_gram": " ".join(["alpha beta"] * 20 + unique_words(40)),
+        "top_3_gram": " ".join(
+            [f"gamma delta epsilon{i}" for i in range(12)] + unique_words(10)
+        ),
+        "duplicated_5_n_grams": " ".join(
+            unique_words(20, "a") + unique_words(9, "z") + unique_words(40, "b") + unique_words(9, "z")
+        ),
+        # "".join makes "ab c" and "a bc" the same n-gram for dup_n_grams
+        "concat_collision": " ".join(
+            unique_words(30, "c") + ["xyzzy", "ab", "c"] + unique_words(3, "k") + unique_words(40, "d")
+            + ["xyzzy", "a", "bc"] + unique_words(3, "k")
+        ),
+        "leading_trailing_newlines": "\n\n" + "\n".join(lines[:6]) + "\n\n\n",
+        "crlf_lines": "\r\n".join(lines[:10] + lines[:3]),
+        "blank_line_runs": "\n\n\n".join(lines[:6]) + "\n \n" + lines[0],
+    }
+
+    # Seeded random documents mixing repeated words, lines and paragraphs.
+    rng = random.Random(1234)
+    vocab = ["the", "cat", "sat", "on", "a", "mat", "ab", "c", "a", "bc", "dog", "x", "yz", "xy", "z"]
+    for case in range(60):
+        paras = []
+        for _ in range(rng.randint(1, 6)):
+            plines = []
+            for _ in range(rng.randint(1, 5)):
+                n = rng.randint(1, 25)
+                plines.append(" ".join(rng.choice(vocab) for _ in range(n)))
+                if rng.random() < 0.2 and plines:
+                    plines.append(plines[-1])
+            paras.append("\n".join(plines))
+            if rng.random() < 0.2:
+                paras.append(paras[-1])
+        cases[f"random_{case}"] = "\n\n".join(paras)
+
+    return cases
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check C++ GopherRepetitionFilter parity with Python reference.")
+    parser.add_argument("--binary", default="./build/gopher_filter_cli", help="Path to gopher_filter_cli binary")
+    args = parser.parse_args()
+
+    cases = build_test_cases()
+    failures = []
+    reasons = Counter()
+
+    runs = [(name, text, "gopher_repetition", {}) for name, text in cases.items()]
+    # N-gram sizes are not capped (the C++ rolling hash used to stop at 63).
+    long_phrase = " ".join(unique_words(70, "n"))
+    runs.append(("top_70_gram", " ".join([long_phrase] * 3 + unique_words(20)),
+                 "gopher_repetition(top_n_grams=2:0.2|70:0.2)", {"top_n_grams": ((2, 0.2), (70, 0.2))}))
+
+    for name, text, pipeline, py_kwargs in runs:
+        py_keep, py_reason = gopher_repetition_py(text, **py_kwargs)
+        cpp_keep, cpp_reason = run_cpp(args.binary, text, pipeline)
+        reasons[py_reason or "keep"] += 1
+        if (py_keep, py_reason) != (cpp_keep, cpp_reason):
+            failures.append(
+                {
+                    "case": name,
+                    "python": {"keep": py_keep, "reason": py_reason},
+                    "cpp": {"keep": cpp_keep, "reason": cpp_reason},
+                }
+            )
+
+    if failures:
+        print("Parity test failures detected:")
+        for f in failures:
+            print(f)
+        sys.exit(1)
+
+    print(f"Parity test passed: C++ repetition filter matches Python reference on all {len(runs)} cases.")
+    print("Outcomes: " + ", ".join(f"{k}={v}" for k, v in sorted(reasons.items())))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,95 @@
+import argparse
+import random
+import tempfile
+from pathlib import Path
+
+from test_stats_eval import make_warc, run, summary
+
+BOILERPLATE = [
+    "All rights reserved {year} Example Media Group and its partners worldwide",
+    "Home | News | Sports | Weather | Contact us | Privacy policy | Terms of use",
+    "Sign up for our newsletter to get the latest stories delivered to your inbox",
+]
+
+
+def boilerplate(rng: random.Random):
+    """Frequent lines, varied the ways normalization should undo."""
+    lines = []
+    for line in BOILERPLATE:
+        line = line.format(year=rng.randint(2000, 2025))
+        if rng.random() < 0.3:
+            line = line.upper()
+        if rng.random() < 0.3:
+            line = line.replace(" ", "  ") + "."
+        lines.append(line)
+    return lines
+
+
+def content(rng: random.Random, vocab, words: int) -> str:
+    body = [rng.choice(vocab) for _ in range(words - 4)]
+    return " ".join(["the", "and", "of", "with"] + body)
+
+
+def make_documents():
+    """Returns (docs, expected reason counts) for line_freq_strip(max_count=10), gopher_quality(min_doc_words=30)."""
+    rng = random.Random(9)
+    vocab = ["".join(rng.choice("abcdefghijklmnoprstu") for _ in range(rng.randint(3, 8))) for _ in range(5000)]
+    docs, expected = [], {"kept": 0, "boilerplate": 0, "gopher_short_doc": 0}
+    for _ in range(40):  # frequent lines only
+        docs.append("\n".join(boilerplate(rng)))
+        expected["boilerplate"] += 1
+    for _ in range(60):  # frequent lines around real content
+        docs.append("\n".join(boilerplate(rng) + [content(rng, vocab, 40)]))
+        expected["kept"] += 1
+    at_limit = content(rng, vocab, 10)  # in exactly max_count docs: kept
+    over_limit = content(rng, vocab, 10)  # in max_count + 1 docs: stripped
+    for _ in range(10):
+        docs.append(at_limit + "\n" + content(rng, vocab, 25))
+        expected["kept"] += 1
+    for _ in range(11):
+        docs.append(over_limit + "\n" + content(rng, vocab, 25))
+        expected["gopher_short_doc"] += 1
+    rng.shuffle(docs)
+    return docs, expected
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the two-pass line frequency strip.")
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    args = parser.parse_args()
+
+    docs, expected = make_documents()
+    failures = []
+    with tempfile.TemporaryDirectory() as tmpdir:
+        tmp = Path(tmpdir)
+        half = len(docs) // 2
+        shards = [tmp / "a.warc.gz", tmp / "b.warc.gz"]
+        make_warc(shards[0], docs[:half])
+        make_warc(shards[1], docs[half:])
+        counts = tmp / "lines.cm"
+
+        # Pass one over both shards.
+        out = run([str(args.websift)] + [str(s) for s in shards] +
+                  ["--threads", "3", "--line-counts-output", str(counts), "--line-counts-width", "16"])
+        if summary(out)[0].get("Total Docs") != len(docs):
+            failures.append(f"pass one counted {summary(out)[0].get('Total Docs')} docs, expected {len(docs)}")
+
+        # Pass two, serial and threaded.
+        spec = f"line_freq_strip(path={counts}, max_count=10), gopher_quality(min_doc_words=30)"
+        for threads in ("1", "3"):
+            out = run([str(args.websift)] + [str(s) for s in shards] + ["--threads", threads, "--pipeline", spec])
+            totals, reasons = summary(out)
+            got = dict(reasons, kept=totals["Kept Docs"])
+            if got != expected:
+                failures.append(f"threads={threads}: {got}, expected {expected}")
+
+    if failures:
+        print("line frequency mismatches:")
+        for f in failures:
+            print("  " + f)
+        raise SystemExit(1)
+    print(f"ok: line_freq_strip matches on {len(docs)} docs across 2 shards")
+
+
+if __name__ == "__main__":
+    main()
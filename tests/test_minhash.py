@@ -0,0 +1,123 @@
+import argparse
+import random
+import struct
+import tempfile
+from pathlib import Path
+
+from test_exact_dedup import MASK, murmur3_128, rotl
+from test_stats_eval import make_warc, run, summary
+
+GOLDEN = 0x9E3779B97F4A7C15
+
+
+def splitmix64(state: int):
+    state = (state + GOLDEN) & MASK
+    z = state
+    z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9) & MASK
+    z = ((z ^ (z >> 27)) * 0x94D049BB133111EB) & MASK
+    return state, z ^ (z >> 31)
+
+
+def fmix32(h: int) -> int:
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+    h ^= h >> 16
+    return h
+
+
+def signature(text: str, num_perm: int = 128, ngram: int = 5, seed: int = 1):
+    """Reference for MinHasher::signature: word shingles, fmix32(x ^ seed_i) minima."""
+    seeds = []
+    state = seed
+    for _ in range(num_perm):
+        state, z = splitmix64(state)
+        seeds.append(z & 0xFFFFFFFF)
+    words = [murmur3_128(w.encode("utf-8"))[0] for w in text.lower().split()]
+    n = min(len(words), ngram)
+    shingles = set()
+    for i in range(len(words) - n + 1) if words else []:
+        s = 0
+        for w in words[i:i + n]:
+            s = ((rotl(s, 23) ^ w) * GOLDEN) & MASK
+        shingles.add(s >> 32)
+    return [min((fmix32(x ^ sd) for x in shingles), default=0xFFFFFFFF) for sd in seeds]
+
+
+def read_signatures(path: Path):
+    data = path.read_bytes()
+    assert data[:8] == b"WSMHSIG1", "bad magic"
+    num_perm, ngram, seed = struct.unpack_from("<IIQ", data, 8)
+    pos, out = 24, {}
+    while pos < len(data):
+        (id_len,) = struct.unpack_from("<H", data, pos)
+        doc_id = data[pos + 2:pos + 2 + id_len].decode("utf-8")
+        pos += 2 + id_len
+        out[doc_id] = list(struct.unpack_from(f"<{num_perm}I", data, pos))
+        pos += 4 * num_perm
+    return (num_perm, ngram, seed), out
+
+
+def make_documents(count: int):
+    """Unrelated long documents, and copies of some with a couple of words changed."""
+    rng = random.Random(5)
+    vocab = ["".join(rng.choice("abcdefghijklmnop") for _ in range(rng.randint(3, 8))) for _ in range(3000)]
+    base = [" ".join(rng.choice(vocab) for _ in range(300)) for _ in range(count)]
+    near = []
+    for text in rng.sample(base, count // 4):
+        words = text.split()
+        for _ in range(2):
+            words[rng.randrange(len(words))] = rng.choice(vocab)
+        near.append(" ".join(words))
+    return base, near
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the minhash_dedup stage and signature output.")
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    args = parser.parse_args()
+
+    base, near = make_documents(120)
+    docs = base + near
+    failures = []
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        tmp = Path(tmpdir)
+        warc = tmp / "docs.warc.gz"
+        sigs = tmp / "sigs.bin"
+        make_warc(warc, docs)
+
+        for threads in ("1", "3"):
+            out = run([str(args.websift), str(warc), "--threads", threads, "--pipeline", "minhash_dedup",
+                       "--signatures-output", str(sigs)])
+            got = summary(out)[1].get("near_duplicate", 0)
+            if got != len(near):
+                failures.append(f"threads={threads}: {got} near duplicates, expected {len(near)}")
+
+        # Unrelated documents stay apart even with a loose threshold.
+        out = run([str(args.websift), str(warc), "--pipeline", "minhash_dedup(threshold=0.3)"])
+        if summary(out)[1].get("near_duplicate", 0) != len(near):
+            failures.append("threshold=0.3 merged unrelated documents")
+
+        # Signatures of kept documents match the reference.
+        header, records = read_signatures(sigs)
+        if header != (128, 5, 1) or len(records) != len(base):
+            failures.append(f"signature file: header {header}, {len(records)} records")
+        # With threads, which copy of a near-duplicate pair is kept depends on
+        # scheduling, so check whichever documents were written.
+        for doc_id in sorted(records)[:10]:
+            idx = int(doc_id[len("<urn:uuid:"):-1])
+            if records[doc_id] != signature(docs[idx - 1]):
+                failures.append(f"signature of {doc_id} differs from the reference")
+
+    if failures:
+        print("minhash mismatches:")
+        for f in failures:
+            print("  " + f)
+        raise SystemExit(1)
+    print(f"ok: minhash_dedup found {len(near)} near duplicates of {len(docs)} docs; signatures match")
+
+
+if __name__ == "__main__":
+    main()
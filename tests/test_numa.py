@@ -0,0 +1,68 @@
+import argparse
+import os
+import subprocess
+import tempfile
+from pathlib import Path
+
+from test_stats_eval import make_documents, make_warc, run
+
+
+def summary(output):
+    return [line for line in output.splitlines() if line.startswith(("Total Docs", "Kept", "Dropped"))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check that websift --numa gives the same results as a plain run.")
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    args = parser.parse_args()
+
+    failures = []
+    with tempfile.TemporaryDirectory() as tmpdir:
+        tmp = Path(tmpdir)
+        # A fake two-node machine whose nodes both list every CPU this
+        # process may use, so pinning succeeds on any runner.
+        cpus = ",".join(str(c) for c in sorted(os.sched_getaffinity(0)))
+        sysfs = tmp / "sys"
+        for node in (0, 1):
+            (sysfs / "devices/system/node" / f"node{node}").mkdir(parents=True)
+            (sysfs / "devices/system/node" / f"node{node}" / "cpulist").write_text(cpus + "\n")
+        (sysfs / "devices/system/node/online").write_text("0-1\n")
+        env = dict(os.environ, WEBSIFT_SYSFS=str(sysfs))
+
+        shards = []
+        for i in range(3):
+            shard = tmp / f"shard{i}.warc.gz"
+            make_warc(shard, make_documents(200 + 50 * i), [f"http://example.com/{i}/{j}" for j in range(200 + 50 * i)])
+            shards.append(str(shard))
+
+        common = ["--pipeline", "gopher_quality, c4_quality", "--batch-size", "9"]
+        for name, inputs in (("one input", shards[:1]), ("three inputs", shards)):
+            plain_csv = tmp / "plain.csv"
+            numa_csv = tmp / "numa.csv"
+            plain = run([str(args.websift)] + inputs + common + ["--threads", "4", "--csv-output", str(plain_csv)])
+            numa = subprocess.run([str(args.websift)] + inputs + common +
+                                  ["--threads", "4", "--numa", "--csv-output", str(numa_csv)],
+                                  capture_output=True, text=True, check=True, env=env).stdout
+            if "NUMA Nodes: 2" not in numa:
+                failures.append(f"{name}: --numa did not use the two fake nodes")
+            if summary(numa) != summary(plain):
+                failures.append(f"{name}: --numa summary differs: {summary(numa)} vs {summary(plain)}")
+            if len(inputs) == 1:
+                # One reader deals blocks to the nodes; the CSV keeps input order.
+                if numa_csv.read_bytes() != plain_csv.read_bytes():
+                    failures.append(f"{name}: --numa CSV differs")
+            else:
+                # Readers on both nodes interleave the inputs.
+                if sorted(numa_csv.read_text().splitlines()) != sorted(plain_csv.read_text().splitlines()):
+                    failures.append(f"{name}: --numa CSV rows differ")
+
+    if failures:
+        print("numa mismatches:")
+        for f in failures:
+            print("  " + f)
+        raise SystemExit(1)
+    print("ok: --numa on two fake nodes matches the plain run")
+
+
+if __name__ == "__main__":
+    main()
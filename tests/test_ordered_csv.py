@@ -0,0 +1,106 @@
+import argparse
+import random
+from collections import Counter
+import tempfile
+from pathlib import Path
+
+from test_stats_eval import make_documents, make_warc, run
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check that websift's CSV does not depend on the thread count.")
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    args = parser.parse_args()
+
+    docs = make_documents(600)
+    urls = [f"http://example.com/{i}" for i in range(len(docs))]
+    rng = random.Random(5)
+    seen = rng.sample(urls, 150)
+    failures = []
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        tmp = Path(tmpdir)
+        warc = tmp / "sample.warc.gz"
+        make_warc(warc, docs, urls)
+        # Some records are skipped by the reader (seen URLs), so their rows
+        # are interleaved with the workers' rows.
+        bloom = tmp / "urls.bf"
+        make_warc(tmp / "seen.warc.gz", ["x"] * len(seen), seen)
+        run([str(args.websift), str(tmp / "seen.warc.gz"), "--url-filter", str(bloom), "--url-filter-update",
+             "--url-filter-capacity", "10000", "--pipeline", "gopher_quality"])
+
+        common = ["--url-filter", str(bloom), "--pipeline", "gopher_quality, c4_quality"]
+        outputs = {}
+        for threads in ("1", "2", "3", "8", "auto"):
+            csv = tmp / f"out{threads}.csv"
+            # The auto run gets a budget of a few blocks, so the reader
+            # waits on the in-flight limit.
+            extra = ["--max-threads", "4", "--memory-budget", "20000"] if threads == "auto" else []
+            out = run([str(args.websift), str(warc), "--threads", threads, "--batch-size", "7", "--csv-output", str(csv)] +
+                      extra + common)
+            if threads == "auto" and "Auto Tuning:" not in out:
+                failures.append("--threads auto did not report its tuning")
+            # Every thread count is the same read -> filter -> csv graph;
+            # only the filter stage's workers change (0: inline).
+            stages = {line.split(":")[0].strip(): line for line in out.splitlines() if "busy_s=" in line}
+            if list(stages) != ["read", "filter", "csv"]:
+                failures.append(f"threads={threads}: unexpected stages {list(stages)}")
+            elif threads in ("1", "3") and f"threads={0 if threads == '1' else 3} " not in stages["filter"]:
+                failures.append(f"threads={threads}: filter stage reports {stages['filter']}")
+            elif "busy_s=0 " in stages["read"]:
+                failures.append(f"threads={threads}: reader busy time not measured: {stages['read']}")
+            outputs[threads] = csv.read_bytes()
+
+        serial = outputs["1"]
+        rows = serial.decode().splitlines()[1:]
+        if [r.split(",", 1)[0] for r in rows] != [f"<urn:uuid:{i}>" for i in range(1, len(docs) + 1)]:
+            failures.append("serial CSV is not in input order")
+        if sum(",seen_url" in r for r in rows) != len(seen):
+            failures.append("serial CSV does not have one seen_url row per seen URL")
+        for threads, out in outputs.items():
+            if out != serial:
+                failures.append(f"threads={threads} CSV differs from the serial CSV")
+
+        # With a dedup stage the workers share the set, so which copy of a
+        # duplicate survives depends on timing (see README). What holds:
+        # rows in input order, and per group of identical documents the
+        # same multiset of outcomes (exact_dedup keeps one per group).
+        groups = [rng.randrange(80) for _ in range(400)]
+        dup_warc = tmp / "dups.warc.gz"
+        make_warc(dup_warc, [docs[g] for g in groups])
+        dup_outputs = {}
+        for threads in ("1", "3", "8"):
+            csv = tmp / f"dup{threads}.csv"
+            run([str(args.websift), str(dup_warc), "--threads", threads, "--batch-size", "7", "--csv-output", str(csv),
+                 "--pipeline", "gopher_quality, exact_dedup"])
+            dup_outputs[threads] = [r.split(",") for r in csv.read_text().splitlines()[1:]]
+        if not any(r[2] == "duplicate" for r in dup_outputs["1"]):
+            failures.append("dedup run found no duplicates")
+        for threads, rows in dup_outputs.items():
+            if [r[0] for r in rows] != [f"<urn:uuid:{i}>" for i in range(1, len(groups) + 1)]:
+                failures.append(f"dedup threads={threads}: CSV is not in input order")
+                continue
+            outcomes = {}
+            for g, r in zip(groups, rows):
+                outcomes.setdefault(g, Counter())[(r[1], r[2])] += 1
+            kept = [g for g, c in outcomes.items() if c[("kept", "")] > 1]
+            if kept:
+                failures.append(f"dedup threads={threads}: groups {kept[:5]} kept more than one copy")
+            if threads != "1":
+                serial_outcomes = {}
+                for g, r in zip(groups, dup_outputs["1"]):
+                    serial_outcomes.setdefault(g, Counter())[(r[1], r[2])] += 1
+                if outcomes != serial_outcomes:
+                    failures.append(f"dedup threads={threads}: per-group outcomes differ from the serial run")
+
+    if failures:
+        print("ordered CSV mismatches:")
+        for f in failures:
+            print("  " + f)
+        raise SystemExit(1)
+    print(f"ok: CSV of {len(docs)} docs is identical at 1, 2, 3, 8 and auto threads; "
+          "with exact_dedup, the same outcomes per duplicate group")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,68 @@
+import argparse
+import subprocess
+import tempfile
+from pathlib import Path
+
+from test_stats_eval import make_warc
+
+# (spec, text the error message must contain)
+BAD_SPECS = [
+    ("gopher_quality, no_such_filter", "unknown filter 'no_such_filter'"),
+    ("gopher_quality(min_doc_words=fifty)", "gopher_quality.min_doc_words=fifty is not an integer"),
+    ("gopher_quality(max_symbol_word_ratio=high)", "is not a number"),
+    ("gopher_quality(stop_words_unicode=maybe)", "unknown parameter 'stop_words_unicode'"),
+    ("c4_quality(split_paragraph=false)", "unknown parameter 'split_paragraph'"),
+    ("c4_quality(min_words_per_line=3", "missing ')'"),
+    ("c4_quality(min_words_per_line=3))", "unexpected ')'"),
+    ("c4_quality(min_words_per_line=(3)", "unbalanced '('"),
+    ("c4_quality), gopher_quality", "unexpected ')'"),
+    ("gopher_quality(min_doc_words=50, min_doc_words=60)", "duplicate parameter 'min_doc_words'"),
+    ("gopher_quality(min_doc_words)", "expected key=value"),
+    ("(min_doc_words=50)", "expected a filter name"),
+    ("# only a comment", "no filters given"),
+]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check that websift rejects malformed --pipeline specs.")
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    args = parser.parse_args()
+    failures = []
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        tmp = Path(tmpdir)
+        warc = tmp / "sample.warc.gz"
+        make_warc(warc, ["A short page of text.\nAnother line of text here."] * 3)
+
+        def check(label, extra, expected):
+            proc = subprocess.run([str(args.websift), str(warc)] + extra, capture_output=True, text=True)
+            if proc.returncode == 0:
+                failures.append(f"{label}: accepted")
+            elif expected not in proc.stderr + proc.stdout:
+                failures.append(f"{label}: error does not mention {expected!r}: {proc.stderr.strip()!r}")
+
+        for spec, expected in BAD_SPECS:
+            check(repr(spec), ["--pipeline", spec], expected)
+
+        # The same rules apply to a pipeline file (one stage per line).
+        spec_file = tmp / "pipeline.txt"
+        spec_file.write_text("gopher_quality(min_doc_words=50,\n  min_doc_words=60)\nc4_quality\n")
+        check("--pipeline-file", ["--pipeline-file", str(spec_file)], "duplicate parameter 'min_doc_words'")
+
+        # A well-formed spec with the same stages still runs.
+        good = subprocess.run([str(args.websift), str(warc), "--pipeline",
+                               "gopher_quality(min_doc_words=50, stop_words=the|and) ; c4_quality(min_words_per_line=3)"],
+                              capture_output=True, text=True)
+        if good.returncode != 0:
+            failures.append(f"valid spec rejected: {good.stderr.strip()!r}")
+
+    if failures:
+        print("pipeline spec mismatches:")
+        for f in failures:
+            print("  " + f)
+        raise SystemExit(1)
+    print(f"ok: {len(BAD_SPECS) + 1} malformed pipeline specs rejected with a reason")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,143 @@
+import argparse
+import json
+import os
+import signal
+import subprocess
+import tempfile
+import time
+from pathlib import Path
+
+from test_stats_eval import make_documents, make_warc, run
+
+
+def summary_value(output, label):
+    for line in output.splitlines():
+        if line.startswith(label + ":"):
+            return int(line.split(":")[1].split()[0])
+    raise ValueError(f"no {label} line in output")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check websift's lease-file shard coordinator with several processes.")
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    parser.add_argument("--workers", default=3, type=int)
+    args = parser.parse_args()
+
+    failures = []
+    with tempfile.TemporaryDirectory() as tmpdir:
+        tmp = Path(tmpdir)
+        shards = []
+        for i in range(8):
+            shard = tmp / f"input{i}.warc.gz"
+            count = 60 + 20 * i
+            make_warc(shard, make_documents(count), [f"http://example.com/{i}/{j}" for j in range(count)])
+            shards.append(str(shard))
+        manifest = tmp / "manifest.txt"
+        manifest.write_text("# inputs\n" + "\n".join(shards) + "\n\n")
+
+        common = ["--pipeline", "gopher_quality, c4_quality", "--threads", "2"]
+        plain = run([str(args.websift)] + shards + common + ["--csv-output", str(tmp / "plain.csv")])
+        plain_docs = summary_value(plain, "Total Docs")
+        plain_kept = summary_value(plain, "Kept Docs")
+
+        # Several processes share one work directory.
+        work = tmp / "work"
+        procs = [subprocess.Popen([str(args.websift), "--manifest", str(manifest), "--work-dir", str(work),
+                                   "--worker-id", f"w{n}"] + common,
+                                  stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+                 for n in range(args.workers)]
+        claims = {}
+        for n, proc in enumerate(procs):
+            out, err = proc.communicate(timeout=300)
+            if proc.returncode != 0:
+                failures.append(f"worker w{n} exited {proc.returncode}: {err.strip()}")
+            for line in out.splitlines():
+                if line.startswith("Shard ") and ": claimed by" in line:
+                    claims.setdefault(line.split()[1].rstrip(":"), []).append(f"w{n}")
+
+        docs = kept = 0
+        csv_rows = []
+        for i in range(len(shards)):
+            name = f"shard-{i:05d}"
+            if claims.get(name, []) != [claims.get(name, ["?"])[0]]:
+                failures.append(f"{name} claimed {len(claims.get(name, []))} times: {claims.get(name)}")
+            if not (work / "done" / f"{name}.done").exists():
+                failures.append(f"{name} has no done marker")
+                continue
+            stats = json.loads((work / "out" / f"{name}.json").read_text())
+            if stats["input"] != shards[i]:
+                failures.append(f"{name} stats name input {stats['input']}")
+            docs += stats["docs"]
+            kept += stats["kept"]
+            csv_rows += (work / "out" / f"{name}.csv").read_text().splitlines()[1:]
+        if (docs, kept) != (plain_docs, plain_kept):
+            failures.append(f"shards total {docs} docs / {kept} kept, plain run {plain_docs} / {plain_kept}")
+        plain_rows = (tmp / "plain.csv").read_text().splitlines()[1:]
+        if sorted(csv_rows) != sorted(plain_rows):
+            failures.append("per-shard CSV rows differ from the plain run")
+        leftovers = [p.name for p in (work / "leases").iterdir()] + \
+                    [p.name for p in (work / "out").iterdir() if ".tmp." in p.name]
+        if leftovers:
+            failures.append(f"leftover files: {leftovers}")
+
+        # A lease left behind by a dead worker is taken over once stale.
+        work = tmp / "stale"
+        (work / "leases").mkdir(parents=True)
+        lease = work / "leases" / "shard-00000.lease"
+        lease.write_text("dead-worker\n")
+        old = time.time() - 30
+        os.utime(lease, (old, old))
+        out = run([str(args.websift), "--manifest", str(manifest), "--work-dir", str(work),
+                   "--lease-timeout", "2", "--worker-id", "rescuer"] + common)
+        done = sorted(p.name for p in (work / "done").iterdir())
+        if len(done) != len(shards) or "Shard shard-00000: claimed by rescuer" not in out:
+            failures.append(f"stale lease not taken over: done {done}")
+        # Each shard's profiling table covers that shard alone.
+        extraction = [int(line.split()[2]) for line in out.splitlines() if line.startswith("Extraction")]
+        if extraction != [60 + 20 * i for i in range(len(shards))]:
+            failures.append(f"per-shard profiling counts {extraction}")
+
+        # A worker that stalls past the timeout loses its shard to another
+        # and publishes nothing when it resumes.
+        work = tmp / "stalled"
+        big = tmp / "big.warc.gz"
+        make_warc(big, make_documents(40000), [f"http://example.com/big/{j}" for j in range(40000)])
+        big_manifest = tmp / "big.txt"
+        big_manifest.write_text(f"{big}\n")
+        stalled = subprocess.Popen([str(args.websift), "--manifest", str(big_manifest), "--work-dir", str(work),
+                                    "--lease-timeout", "1", "--worker-id", "stalled"] + common,
+                                   stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+        claim = stalled.stdout.readline()
+        while claim and not claim.startswith("Shard "):
+            claim = stalled.stdout.readline()
+        stalled.send_signal(signal.SIGSTOP)
+        run([str(args.websift), "--manifest", str(big_manifest), "--work-dir", str(work),
+             "--lease-timeout", "1", "--worker-id", "successor"] + common)
+        stalled.send_signal(signal.SIGCONT)
+        out, err = stalled.communicate(timeout=300)
+        stats = json.loads((work / "out" / "shard-00000.json").read_text())
+        if "claimed by stalled" not in claim or stalled.returncode != 0:
+            failures.append(f"stalled worker: {claim.strip()} exit {stalled.returncode}")
+        elif stats["worker"] != "successor" or "lost the lease" not in err:
+            failures.append(f"stalled worker published after losing its lease (stats by {stats['worker']})")
+        if [p.name for p in (work / "out").iterdir() if ".tmp." in p.name]:
+            failures.append("stalled worker left temporary outputs")
+
+        # Persistent state a failed or lost shard would leave behind is refused.
+        for extra in (["--url-filter", str(tmp / "urls.bf"), "--url-filter-update"],
+                      ["--pipeline", f"exact_dedup(path={tmp / 'seen.bin'})"]):
+            proc = subprocess.run([str(args.websift), "--manifest", str(manifest), "--work-dir", str(tmp / "refused")] +
+                                  extra, capture_output=True, text=True)
+            if proc.returncode == 0 or "--manifest" not in proc.stderr:
+                failures.append(f"{extra[-1]} accepted with --manifest")
+
+    if failures:
+        print("shard coordinator mismatches:")
+        for f in failures:
+            print("  " + f)
+        raise SystemExit(1)
+    print(f"ok: {args.workers} coordinator processes split {len(shards)} shards once each, matching the plain run")
+
+
+if __name__ == "__main__":
+    main()
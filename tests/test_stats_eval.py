@@ -0,0 +1,121 @@
+import argparse
+import gzip
+import random
+import subprocess
+import tempfile
+from pathlib import Path
+
+SPECS = [
+    "gopher_quality",
+    "c4_quality",
+    "gopher_quality(min_doc_words=20, max_symbol_word_ratio=0.05), c4_quality(min_num_sentences=2)",
+    "c4_quality(min_num_sentences=1, min_words_per_line=3)",
+    "gopher_quality(min_avg_word_length=4, max_non_alpha_words_ratio=0.9, min_stop_words=4)",
+    "gopher_quality(min_doc_words=0, min_avg_word_length=0, max_avg_word_length=5, max_symbol_word_ratio=0, "
+    "min_stop_words=0), c4_quality(min_num_sentences=-1)",
+]
+
+
+def make_documents(count: int):
+    rng = random.Random(7)
+    vocab = ["the", "and", "of", "to", "that", "with", "quick", "brown", "fox", "jumps", "over",
+             "lazy", "dog", "lorem", "ipsum", "#tag", "...", "123", "data", "filter", "{", "be"]
+    docs = []
+    for _ in range(count):
+        lines = []
+        for _ in range(rng.randint(0, 12)):
+            words = [rng.choice(vocab) for _ in range(rng.randint(1, 14))]
+            prefix = rng.choice(["", "", "- ", "• "])
+            suffix = rng.choice([".", ".", "!", "", "...", "?"])
+            lines.append(prefix + " ".join(words) + suffix)
+        docs.append("\n".join(lines))
+    return docs
+
+
+def make_warc(path: Path, docs, urls=None):
+    records = []
+    for idx, text in enumerate(docs, start=1):
+        url = urls[idx - 1] if urls else f"http://example.com/{idx}"
+        payload = "HTTP/1.1 200 OK\r\n\r\n" + text
+        body = payload.encode("utf-8")
+        header = (
+            "WARC/1.0\r\n"
+            "WARC-Type: response\r\n"
+            f"WARC-Target-URI: {url}\r\n"
+            f"WARC-Record-ID: <urn:uuid:{idx}>\r\n"
+            f"Content-Length: {len(body)}\r\n"
+            "\r\n"
+        ).encode("utf-8")
+        records.append(header + body + b"\r\n\r\n")
+    with gzip.open(path, "wb") as f:
+        f.write(b"".join(records))
+
+
+def summary(output: str):
+    counts = {}
+    reasons = {}
+    in_reasons = False
+    for line in output.splitlines():
+        if line.startswith("Drop Reasons:"):
+            in_reasons = True
+            continue
+        if in_reasons:
+            if not line.startswith("  "):
+                in_reasons = False
+                continue
+            key, val = line.strip().rsplit(":", 1)
+            reasons[key] = int(val)
+            continue
+        if ":" in line:
+            key, val = line.split(":", 1)
+            if key in {"Total Docs", "Kept Docs", "Dropped Docs"}:
+                counts[key] = int(val)
+    return counts, reasons
+
+
+def run(cmd):
+    return subprocess.run(cmd, capture_output=True, text=True, check=True).stdout
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check stats_eval against websift filtering the same WARC.")
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    parser.add_argument("--stats-eval", default="./build/stats_eval", type=Path)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        warc = Path(tmpdir) / "sample.warc.gz"
+        stats = Path(tmpdir) / "stats.bin"
+        make_warc(warc, make_documents(400))
+
+        # Stats are taken with the pipeline's stop words and C4 line rules.
+        run([str(args.websift), str(warc), "--stats-output", str(stats),
+             "--pipeline", "gopher_quality, c4_quality(min_words_per_line=3)"])
+        stats_default = Path(tmpdir) / "stats_default.bin"
+        run([str(args.websift), str(warc), "--threads", "3", "--stats-output", str(stats_default)])
+
+        failures = []
+        for spec in SPECS:
+            stats_file = stats if "min_words_per_line=3" in spec else stats_default
+            filtered = summary(run([str(args.websift), str(warc), "--pipeline", spec]))
+            evaluated = summary(run([str(args.stats_eval), str(stats_file), "--pipeline", spec]))
+            if filtered != evaluated:
+                failures.append((spec, filtered, evaluated))
+
+        # A setting that shapes the stats cannot be changed after collection.
+        proc = subprocess.run([str(args.stats_eval), str(stats_default), "--pipeline", "c4_quality(min_words_per_line=1)"],
+                              capture_output=True, text=True)
+        if proc.returncode == 0 or "min_words_per_line" not in proc.stderr:
+            failures.append(("c4_quality(min_words_per_line=1) on default stats", "an error", proc.stdout + proc.stderr))
+
+        if failures:
+            print("stats_eval mismatches:")
+            for spec, filtered, evaluated in failures:
+                print(f"  {spec}\n    websift:    {filtered}\n    stats_eval: {evaluated}")
+            raise SystemExit(1)
+
+    print(f"ok: stats_eval matches websift on {len(SPECS)} threshold sets")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,89 @@
+import argparse
+import csv
+import random
+import subprocess
+import tempfile
+from pathlib import Path
+
+from test_stats_eval import make_warc, run, summary
+
+
+def variant(url: str, rng: random.Random) -> str:
+    """The same URL as a crawler may write it: case, default port, fragment."""
+    scheme, rest = url.split("://", 1)
+    host, path = rest.split("/", 1)
+    choice = rng.randrange(4)
+    if choice == 0:
+        return f"{scheme.upper()}://{host.upper()}/{path}"
+    if choice == 1:
+        return f"{scheme}://{host}:{443 if scheme == 'https' else 80}/{path}"
+    if choice == 2:
+        return f"{url}#section-{rng.randrange(9)}"
+    return f"<{url}>"
+
+
+def run_status(cmd):
+    return subprocess.run(cmd, capture_output=True).returncode
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check websift --url-filter across runs.")
+    parser.add_argument("--websift", default="./build/websift", type=Path)
+    args = parser.parse_args()
+
+    rng = random.Random(3)
+    first = [f"{rng.choice(['http', 'https'])}://site{i % 17}.example.org/page/{i}?q={i * 7}" for i in range(300)]
+    fresh = [f"https://other{i}.example.net/" for i in range(150)]
+    repeats = [variant(u, rng) for u in rng.sample(first, 120)]
+    second = fresh + repeats
+    rng.shuffle(second)
+    text = "A short page of text that the filters will look at.\nAnother line here."
+    failures = []
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        tmp = Path(tmpdir)
+        bloom = tmp / "urls.bf"
+        warc1, warc2 = tmp / "crawl1.warc.gz", tmp / "crawl2.warc.gz"
+        make_warc(warc1, [text] * len(first), first)
+        make_warc(warc2, [text] * len(second), second)
+        pipeline = ["--pipeline", "gopher_quality"]
+
+        # A read-only filter must exist.
+        missing = run_status([str(args.websift), str(warc1), "--url-filter", str(bloom)] + pipeline)
+        if missing == 0:
+            failures.append("read-only filter on a missing file did not fail")
+
+        out = run([str(args.websift), str(warc1), "--url-filter", str(bloom), "--url-filter-update",
+                   "--url-filter-capacity", "10000"] + pipeline)
+        if summary(out)[1].get("seen_url", 0) != 0:
+            failures.append("first crawl reported seen URLs")
+
+        for threads in ("1", "3"):
+            csv_path = tmp / f"out{threads}.csv"
+            out = run([str(args.websift), str(warc2), "--threads", threads, "--url-filter", str(bloom),
+                       "--csv-output", str(csv_path)] + pipeline)
+            counts, reasons = summary(out)
+            if reasons.get("seen_url", 0) != len(repeats) or counts["Total Docs"] != len(second):
+                failures.append(f"threads={threads}: {reasons.get('seen_url', 0)} seen URLs, expected {len(repeats)}")
+            with open(csv_path, newline="") as f:
+                seen_ids = {row["record_id"] for row in csv.DictReader(f) if row["reason"] == "seen_url"}
+            expected = {f"<urn:uuid:{i}>" for i, u in enumerate(second, start=1) if u in repeats}
+            if seen_ids != expected:
+                failures.append(f"threads={threads}: CSV marks the wrong records as seen_url")
+
+        # Updating in place also catches repeats within one crawl.
+        run([str(args.websift), str(warc2), "--url-filter", str(bloom), "--url-filter-update"] + pipeline)
+        out = run([str(args.websift), str(warc2), "--url-filter", str(bloom)] + pipeline)
+        if summary(out)[1].get("seen_url", 0) != len(second):
+            failures.append("second crawl's URLs were not added by --url-filter-update")
+
+    if failures:
+        print("url filter mismatches:")
+        for f in failures:
+            print("  " + f)
+        raise SystemExit(1)
+    print(f"ok: url filter skipped {len(repeats)} of {len(second)} re-crawled URLs (serial, threaded)")
+
+
+if __name__ == "__main__":
+    main()
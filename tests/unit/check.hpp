@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+
+// Minimal assertions for the C++ unit tests: a failed CHECK prints the
+// expression and location and the test exits 1 at the end of main().
+// CHECK may be used from any thread.
+inline std::atomic<int>& checkFailures() {
+    static std::atomic<int> failures{0};
+    return failures;
+}
+
+#define CHECK(cond)                                                                          \
+    do {                                                                                     \
+        if (!(cond)) {                                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond << std::endl; \
+            ++checkFailures();                                                               \
+        }                                                                                    \
+    } while (0)
+
+inline int checkReport(const char* name) {
+    if (checkFailures() > 0) {
+        std::cerr << name << ": " << checkFailures().load() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "ok: " << name << std::endl;
+    return 0;
+}
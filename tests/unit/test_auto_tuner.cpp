@@ -0,0 +1,128 @@
+// AutoTuner decisions on scripted samples, and the wait accounting it is
+// fed from: InflightLimit's stall and WorkStealingPool's idle time must
+// include waits still in progress when they are sampled.
+#include "../../src/auto_tuner.hpp"
+#include "../../src/work_stealing_pool.hpp"
+#include "check.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+constexpr size_t kMiB = 1 << 20;
+
+TunerSample sample(double docs, double stall, double idle_per_worker, unsigned workers, double occupancy = 0.5) {
+    TunerSample s;
+    s.seconds = 1.0;
+    s.docs = static_cast<uint64_t>(docs);
+    s.reader_stall = stall;
+    s.worker_idle = idle_per_worker * workers;
+    s.occupancy = occupancy;
+    return s;
+}
+
+// Workers waiting on a reader that never waits: shed workers down to one.
+void readerBound() {
+    AutoTuner t(8, 4, kMiB, 64 * kMiB, 8 * kMiB);
+    for (unsigned expect : {3u, 2u, 1u, 1u}) {
+        t.update(sample(1000, 0.0, 0.5, t.workers()));
+        CHECK(t.workers() == expect);
+    }
+    CHECK(t.inflightBytes() == 8 * kMiB);
+}
+
+// Reader waiting for room while workers still go idle: double the limit,
+// up to the budget; at the budget idle workers are shed instead.
+void queueTooShort() {
+    AutoTuner t(8, 4, kMiB, 64 * kMiB, 8 * kMiB);
+    for (size_t expect : {16 * kMiB, 32 * kMiB, 64 * kMiB, 64 * kMiB}) {
+        t.update(sample(1000, 0.5, 0.15, t.workers()));
+        CHECK(t.inflightBytes() == expect);
+        CHECK(t.workers() == 4);
+    }
+    t.update(sample(1000, 0.5, 0.5, t.workers()));
+    CHECK(t.workers() == 3);
+}
+
+// Reader waiting with every worker busy: try one more worker, keep it only
+// if docs/s rose by kGain, and after a step that did not pay hold kHold
+// intervals before trying again.
+void trialWorkers() {
+    AutoTuner t(8, 2, kMiB, 64 * kMiB, 8 * kMiB);
+    t.update(sample(1000, 0.5, 0.0, t.workers()));
+    CHECK(t.workers() == 3);
+    t.update(sample(1000 * AutoTuner::kGain + 10, 0.5, 0.0, t.workers()));
+    CHECK(t.workers() == 3); // paid off: kept
+    t.update(sample(1100, 0.5, 0.0, t.workers()));
+    CHECK(t.workers() == 4);
+    t.update(sample(1110, 0.5, 0.0, t.workers()));
+    CHECK(t.workers() == 3); // +1%: reverted
+    for (int i = 1; i < AutoTuner::kHold; ++i) {
+        t.update(sample(1110, 0.5, 0.0, t.workers()));
+        CHECK(t.workers() == 3);
+    }
+    t.update(sample(1110, 0.5, 0.0, t.workers()));
+    CHECK(t.workers() == 4);
+}
+
+// All workers busy at the cap with a full queue: trim the limit towards
+// the floor, never below it.
+void trimFullQueue() {
+    AutoTuner t(2, 2, kMiB, 64 * kMiB, 8 * kMiB);
+    size_t last = t.inflightBytes();
+    for (int i = 0; i < 20; ++i) {
+        t.update(sample(1000, 0.5, 0.0, t.workers(), 0.95));
+        CHECK(t.inflightBytes() <= last);
+        last = t.inflightBytes();
+    }
+    CHECK(t.inflightBytes() == kMiB);
+    CHECK(t.workers() == 2);
+
+    // An empty interval changes nothing.
+    TunerSample empty;
+    t.update(empty);
+    CHECK(t.inflightBytes() == kMiB);
+}
+
+// A reader blocked at the sampling moment reads as stalled.
+void stallInProgress() {
+    InflightLimit limit(100);
+    CHECK(limit.acquire(80) == 0.0);
+    std::atomic<bool> acquired{false};
+    double waited = 0;
+    std::thread reader([&]() {
+        waited = limit.acquire(50);
+        acquired = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    const double during = limit.stallSeconds();
+    CHECK(!acquired.load());
+    CHECK(during >= 0.04);
+    limit.release(80);
+    reader.join();
+    CHECK(acquired.load());
+    CHECK(waited >= during - 1e-6);
+    CHECK(limit.stallSeconds() >= waited - 1e-6);
+}
+
+// Workers with nothing to do read as idle before any of them wakes up.
+void idleInProgress() {
+    WorkStealingPool<int> pool(2, 1, 4, [](unsigned, int&, size_t, size_t) {}, [](unsigned, int&) {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    CHECK(pool.idleSeconds() >= 0.06);
+    pool.close();
+}
+
+} // namespace
+
+int main() {
+    readerBound();
+    queueTooShort();
+    trialWorkers();
+    trimFullQueue();
+    stallInProgress();
+    idleInProgress();
+    return checkReport("auto tuner: scripted decisions, waits in progress");
+}
@@ -0,0 +1,119 @@
+// BoundedQueue under contention: every pushed item is popped exactly once,
+// close() wakes blocked producers and consumers, and items pushed before
+// close() are still drained. Small capacities force the full and empty
+// paths onto the futex. Run it under TSan as well (see README).
+#include "../../src/bounded_queue.hpp"
+#include "check.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void mpmc(unsigned producers, unsigned consumers, size_t capacity, uint64_t per_producer) {
+    BoundedQueue<uint64_t> q(capacity);
+    std::vector<std::vector<uint64_t>> popped(consumers);
+    std::vector<std::thread> threads;
+    for (unsigned c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c]() {
+            uint64_t v;
+            while (q.pop(v)) popped[c].push_back(v);
+        });
+    }
+    std::vector<std::thread> pushers;
+    for (unsigned p = 0; p < producers; ++p) {
+        pushers.emplace_back([&, p]() {
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                uint64_t v = p * per_producer + i;
+                // Mix the blocking and non-blocking forms.
+                if (i % 3 == 0 && q.tryPush(std::move(v))) continue;
+                CHECK(q.push(std::move(v)));
+            }
+        });
+    }
+    for (std::thread& t : pushers) t.join();
+    q.close();
+    for (std::thread& t : threads) t.join();
+
+    std::vector<uint32_t> seen(producers * per_producer, 0);
+    for (const auto& list : popped) {
+        // One producer's items reach one consumer in push order.
+        std::vector<uint64_t> last(producers, UINT64_MAX);
+        for (uint64_t v : list) {
+            CHECK(v < seen.size());
+            if (v >= seen.size()) continue;
+            seen[v]++;
+            const uint64_t p = v / per_producer;
+            CHECK(last[p] == UINT64_MAX || last[p] < v);
+            last[p] = v;
+        }
+    }
+    size_t lost = 0;
+    size_t duplicated = 0;
+    for (uint32_t n : seen) {
+        lost += n == 0;
+        duplicated += n > 1;
+    }
+    CHECK(lost == 0);
+    CHECK(duplicated == 0);
+}
+
+void drainAfterClose() {
+    BoundedQueue<std::unique_ptr<int>> q(8);
+    for (int i = 0; i < 5; ++i) CHECK(q.tryPush(std::make_unique<int>(i)));
+    q.close();
+    CHECK(!q.push(std::make_unique<int>(99)));
+    CHECK(!q.tryPush(std::make_unique<int>(99)));
+    std::unique_ptr<int> v;
+    for (int i = 0; i < 5; ++i) {
+        CHECK(q.pop(v));
+        CHECK(v && *v == i);
+    }
+    CHECK(!q.pop(v));
+    CHECK(!q.tryPop(v));
+}
+
+void closeWakesWaiters() {
+    // Consumers parked on an empty queue.
+    BoundedQueue<int> empty(4);
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < 4; ++c) {
+        consumers.emplace_back([&]() {
+            int v;
+            CHECK(!empty.pop(v));
+        });
+    }
+    // Producers parked on a full queue.
+    BoundedQueue<int> full(2);
+    CHECK(full.tryPush(1));
+    CHECK(full.tryPush(2));
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 3; ++p) {
+        producers.emplace_back([&]() { CHECK(!full.push(3)); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    empty.close();
+    full.close();
+    for (std::thread& t : consumers) t.join();
+    for (std::thread& t : producers) t.join();
+    int v;
+    CHECK(full.pop(v) && v == 1);
+    CHECK(full.pop(v) && v == 2);
+    CHECK(!full.pop(v));
+}
+
+} // namespace
+
+int main() {
+    mpmc(1, 1, 2, 200000);
+    mpmc(4, 4, 4, 50000);
+    mpmc(6, 2, 8, 30000);
+    mpmc(2, 6, 2, 60000);
+    mpmc(8, 8, 1024, 20000);
+    drainAfterClose();
+    closeWakesWaiters();
+    return checkReport("bounded queue: MPMC, close and drain");
+}
@@ -0,0 +1,102 @@
+// FilterChain adaptive ordering: barrier stages keep their position, and
+// reordering changes neither which documents are kept nor the reported
+// drop reasons (per document and per-reason counts) versus the fixed order.
+#include "../../src/filter_chain.hpp"
+#include "check.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Drops documents whose length is a multiple of `mod`; `spin` makes the
+// check expensive so adaptive ordering moves it behind the cheap ones.
+struct ModCheck {
+    size_t mod;
+    DropReason reason;
+    unsigned spin = 0;
+
+    FilterResult filter(DocumentAnalysis& doc) const {
+        volatile unsigned sink = 0;
+        for (unsigned i = 0; i < spin; ++i) sink += i;
+        if (doc.size() % mod != 0) return {true};
+        FilterResult r{false, reason};
+        r.detail = static_cast<uint32_t>(mod);
+        return r;
+    }
+};
+
+// Barrier: every check added before it must already have passed the
+// document, which holds only if nothing moved across it.
+struct Barrier {
+    std::vector<size_t>* seen;
+    FilterResult filter(DocumentAnalysis& doc) const {
+        seen->push_back(doc.size());
+        return {true};
+    }
+};
+
+struct Outcome {
+    std::vector<FilterResult> results;
+    std::map<std::string, size_t> reasons;
+    std::vector<size_t> at_barrier;
+    std::vector<std::string> order;
+};
+
+Outcome runAll(FilterChain::Order mode, const std::vector<std::string>& docs) {
+    Outcome out;
+    FilterChain chain;
+    // Expensive, rarely dropping checks first in the fixed order; the cheap,
+    // frequently dropping ones after them in each segment.
+    chain.add("slow3", ModCheck{3, DropReason::LoremIpsum, 20000});
+    chain.add("slow5", ModCheck{5, DropReason::CurlyBracket, 20000});
+    chain.add("fast2", ModCheck{2, DropReason::TooFewSentences});
+    chain.add("barrier", Barrier{&out.at_barrier}, true);
+    chain.add("slow7", ModCheck{7, DropReason::FewParagraphs, 20000});
+    chain.add("fast11", ModCheck{11, DropReason::ShortParagraphs});
+    chain.setOrder(mode);
+    chain.setWindow(64);
+
+    DropCounters counters;
+    DocumentAnalysis doc;
+    for (const std::string& text : docs) {
+        doc.assign(text);
+        FilterResult r = chain.run(doc);
+        if (!r.keep) counters.add(r);
+        out.results.push_back(r);
+    }
+    out.reasons = counters.report(chain);
+    out.order = chain.currentOrder();
+    return out;
+}
+
+} // namespace
+
+int main() {
+    std::vector<std::string> docs;
+    for (size_t i = 0; i < 4000; ++i) docs.push_back(std::string(1 + (i * 7919) % 1000, 'x'));
+
+    const Outcome fixed = runAll(FilterChain::Order::Fixed, docs);
+    const Outcome adaptive = runAll(FilterChain::Order::Adaptive, docs);
+
+    // The test only means something if the order actually changed.
+    const std::vector<std::string> expected = {"fast2", "slow3", "slow5", "barrier", "fast11", "slow7"};
+    CHECK(adaptive.order == expected);
+    CHECK(adaptive.order[3] == "barrier");
+
+    CHECK(fixed.results.size() == adaptive.results.size());
+    size_t differing = 0;
+    for (size_t i = 0; i < fixed.results.size() && i < adaptive.results.size(); ++i) {
+        const FilterResult& a = fixed.results[i];
+        const FilterResult& b = adaptive.results[i];
+        differing += a.keep != b.keep || a.reason != b.reason || a.detail != b.detail || a.stage != b.stage;
+    }
+    CHECK(differing == 0);
+    CHECK(fixed.reasons == adaptive.reasons);
+    CHECK(fixed.reasons.size() == 5);
+    CHECK(fixed.at_barrier == adaptive.at_barrier);
+    for (size_t len : adaptive.at_barrier) CHECK(len % 2 != 0 && len % 3 != 0 && len % 5 != 0);
+
+    return checkReport("filter chain: adaptive order keeps barriers and drop reasons");
+}
@@ -0,0 +1,36 @@
+// The AVX2 and scalar MinHash kernels must give identical minima, so
+// signatures do not depend on the machine that computed them.
+#include "../../src/minhash.hpp"
+#include "check.hpp"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+int main() {
+    std::mt19937 rng(7);
+    if (!minHashHasAvx2()) {
+        std::cout << "skip: CPU has no AVX2" << std::endl;
+        return 0;
+    }
+    for (size_t n : {0u, 1u, 2u, 7u, 8u, 9u, 100u, 5000u}) {
+        std::vector<uint32_t> shingles(n);
+        for (uint32_t& x : shingles) x = rng();
+        // Edge values the unsigned minimum must order correctly.
+        if (n >= 8) {
+            shingles[0] = 0;
+            shingles[1] = 0xFFFFFFFFu;
+            shingles[2] = 0x80000000u;
+        }
+        for (int round = 0; round < 16; ++round) {
+            uint32_t seeds[8];
+            for (uint32_t& s : seeds) s = rng();
+            uint32_t scalar[8];
+            uint32_t simd[8];
+            minHash8Scalar(seeds, shingles, scalar);
+            CHECK(minHash8Avx2(seeds, shingles, simd));
+            for (int l = 0; l < 8; ++l) CHECK(scalar[l] == simd[l]);
+        }
+    }
+    return checkReport("minhash kernels: AVX2 matches scalar");
+}
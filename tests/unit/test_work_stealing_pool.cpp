@@ -0,0 +1,124 @@
+// WorkStealingPool: every item of every job runs exactly once and done()
+// follows the last of them, at several thread counts and grains, with
+// skewed job sizes (so ranges are split and stolen) and with setActive()
+// moving the worker count while jobs run.
+#include "../../src/work_stealing_pool.hpp"
+#include "check.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Job {
+    size_t items = 0;
+    std::unique_ptr<std::atomic<uint8_t>[]> ran;
+    std::atomic<int> done{0};
+    std::atomic<uint32_t> workers{0}; // bit per worker that ran a range
+};
+
+using Pool = WorkStealingPool<Job*>;
+
+std::vector<std::unique_ptr<Job>> makeJobs(size_t count, std::mt19937& rng) {
+    std::vector<std::unique_ptr<Job>> jobs;
+    for (size_t j = 0; j < count; ++j) {
+        auto job = std::make_unique<Job>();
+        // Mostly small jobs, some empty, a few large ones to split.
+        const unsigned kind = rng() % 10;
+        job->items = kind == 0 ? 0 : kind < 8 ? rng() % 32 : 500 + rng() % 3000;
+        job->ran.reset(new std::atomic<uint8_t>[job->items]);
+        for (size_t i = 0; i < job->items; ++i) job->ran[i].store(0, std::memory_order_relaxed);
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+std::unique_ptr<Pool> makePool(unsigned threads, size_t grain) {
+    return std::make_unique<Pool>(
+        threads, grain, 16,
+        [](unsigned w, Job*& job, size_t begin, size_t end) {
+            CHECK(begin < end && end <= job->items);
+            job->workers.fetch_or(1u << (w % 32), std::memory_order_relaxed);
+            for (size_t i = begin; i < end && i < job->items; ++i) job->ran[i].fetch_add(1, std::memory_order_relaxed);
+            // Some work, so other workers go idle and ask for splits.
+            volatile unsigned sink = 0;
+            for (size_t i = 0; i < (end - begin) * 200; ++i) sink += static_cast<unsigned>(i);
+        },
+        [](unsigned, Job*& job) {
+            for (size_t i = 0; i < job->items; ++i) CHECK(job->ran[i].load(std::memory_order_relaxed) == 1);
+            job->done.fetch_add(1, std::memory_order_release);
+        });
+}
+
+void checkJobs(const std::vector<std::unique_ptr<Job>>& jobs) {
+    size_t bad_items = 0;
+    size_t bad_done = 0;
+    for (const auto& job : jobs) {
+        for (size_t i = 0; i < job->items; ++i) bad_items += job->ran[i].load() != 1;
+        bad_done += job->done.load(std::memory_order_acquire) != 1;
+    }
+    CHECK(bad_items == 0);
+    CHECK(bad_done == 0);
+}
+
+void everyItemOnce(unsigned threads, size_t grain) {
+    std::mt19937 rng(threads * 31 + static_cast<unsigned>(grain));
+    auto jobs = makeJobs(400, rng);
+    auto pool = makePool(threads, grain);
+    for (auto& job : jobs) {
+        Job* p = job.get();
+        CHECK(pool->submit(std::move(p), job->items));
+    }
+    pool->close();
+    checkJobs(jobs);
+    CHECK(pool->idleSeconds() >= 0);
+}
+
+void activeChangesWhileRunning(unsigned threads) {
+    std::mt19937 rng(threads);
+    auto jobs = makeJobs(600, rng);
+    auto pool = makePool(threads, 4);
+    std::atomic<bool> stop{false};
+    std::thread tuner([&]() {
+        std::mt19937 r(threads + 100);
+        while (!stop.load()) {
+            pool->setActive(1 + r() % threads);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+    for (auto& job : jobs) {
+        Job* p = job.get();
+        CHECK(pool->submit(std::move(p), job->items));
+    }
+    stop = true;
+    tuner.join();
+
+    // Once the workers past the limit have parked, only worker 0 runs.
+    pool->setActive(1);
+    CHECK(pool->active() == 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto solo = makeJobs(50, rng);
+    for (auto& job : solo) {
+        Job* p = job.get();
+        CHECK(pool->submit(std::move(p), job->items));
+    }
+    // Deactivated workers do not hold up close(): worker 0 drains the rest.
+    pool->close();
+    checkJobs(jobs);
+    checkJobs(solo);
+    for (const auto& job : solo) CHECK((job->workers.load() & ~1u) == 0);
+}
+
+} // namespace
+
+int main() {
+    for (unsigned threads : {1u, 2u, 3u, 4u, 8u}) {
+        for (size_t grain : {1u, 4u, 16u}) everyItemOnce(threads, grain);
+        if (threads > 1) activeChangesWhileRunning(threads);
+    }
+    return checkReport("work-stealing pool: every item once, setActive");
+}